@@ -10,9 +10,9 @@
 #include <Windows.h>
 #include <algorithm>
 #include <chrono>
+#include <filesystem>
 #include <fstream>
 #include <sstream>
-#include <unordered_set>
 
 // Include Merlin's shared header for action buffer communication (pure C, no Merlin internals)
 #include "../Merlin/Src/Lib/Interface/C/ForeignActionCommandBuffer.h"
@@ -20,7 +20,8 @@
 // Forward declaration for action dispatch handler
 static void HandleWalkTo(wi::scene::Scene &scene, wi::scene::CharacterComponent &character,
                          ForeignActionCommand &cmd,
-                         std::unordered_map<uint64_t, GrymMerlinEntityEntry> &entityTable);
+                         std::unordered_map<uint64_t, GrymMerlinEntityEntry> &entityTable,
+                         MerlinLua &merlinLua);
 
 void GameStartup::Initialize(Noesis::Grid *menu, Noesis::TextBox *seed, Noesis::Button *play,
                              Noesis::Button *fullscreen) {
@@ -98,7 +99,28 @@ void GameStartup::SaveConfig() {
         configFile << "theme_music = " << themeMusic << "\n";
         configFile << "level = " << levelPath << "\n";
         configFile << "player_model = " << playerModel << "\n";
-        configFile << "npc_model = " << npcModel << "\n";
+        configFile << "npc_model = " << npcModel << "\n\n";
+
+        // Merlin simulation settings
+        configFile << "[merlin]\n";
+        configFile << "async_simulation = " << (merlinAsyncSimulation ? "true" : "false") << "\n";
+        configFile << "frame_budget_ms = " << merlinFrameBudgetMs << "\n";
+        configFile << "lua_gc_budget_ms = " << merlinLuaGcBudgetMs << "\n";
+        configFile << "sim_tick_rate = " << merlinSimTickRate << "\n";
+        configFile << "max_catch_up_ticks = " << merlinMaxCatchUpTicks << "\n";
+        configFile << "boot_checkpoint = " << merlinBootCheckpoint << "\n";
+        configFile << "sim_lod = " << (merlinSimLod ? "true" : "false") << "\n";
+        configFile << "lod_ring_range = " << merlinLodRingRange << "\n";
+        configFile << "lod_ring_interval = " << merlinLodRingInterval << "\n";
+        configFile << "lod_background_interval = " << merlinLodBackgroundInterval << "\n";
+        configFile << "benchmark_sync = " << (merlinBenchmarkSync ? "true" : "false") << "\n";
+        configFile << "sync_capacity = " << merlinSyncCapacity << "\n";
+        configFile << "bridge_recording = " << merlinBridgeRecording << "\n";
+        configFile << "ai_profile_interval_ms = " << merlinAiProfileMs << "\n";
+        configFile << "pool_telemetry = " << merlinPoolTelemetry << "\n";
+        configFile << "warm_start_dir = " << merlinWarmStartDir << "\n";
+        configFile << "data_cache_dir = " << merlinDataCacheDir << "\n";
+        configFile << "terrain_heightfield = " << merlinHeightfield << "\n";
         configFile.close();
 
         char buffer[512];
@@ -135,6 +157,65 @@ void GameStartup::LoadConfig() {
         npcModel = game.GetText("npc_model");
     }
 
+    // Merlin simulation settings
+    if (config.HasSection("merlin")) {
+        auto &merlin = config.GetSection("merlin");
+        if (merlin.Has("async_simulation")) {
+            merlinAsyncSimulation = merlin.GetBool("async_simulation");
+        }
+        if (merlin.Has("frame_budget_ms")) {
+            merlinFrameBudgetMs = merlin.GetFloat("frame_budget_ms");
+        }
+        if (merlin.Has("lua_gc_budget_ms")) {
+            merlinLuaGcBudgetMs = merlin.GetFloat("lua_gc_budget_ms");
+        }
+        if (merlin.Has("sim_tick_rate")) {
+            merlinSimTickRate = merlin.GetFloat("sim_tick_rate");
+        }
+        if (merlin.Has("max_catch_up_ticks")) {
+            merlinMaxCatchUpTicks = merlin.GetInt("max_catch_up_ticks");
+        }
+        if (merlin.Has("boot_checkpoint")) {
+            merlinBootCheckpoint = merlin.GetText("boot_checkpoint");
+        }
+        if (merlin.Has("sim_lod")) {
+            merlinSimLod = merlin.GetBool("sim_lod");
+        }
+        if (merlin.Has("lod_ring_range")) {
+            merlinLodRingRange = merlin.GetFloat("lod_ring_range");
+        }
+        if (merlin.Has("lod_ring_interval")) {
+            merlinLodRingInterval = merlin.GetInt("lod_ring_interval");
+        }
+        if (merlin.Has("lod_background_interval")) {
+            merlinLodBackgroundInterval = merlin.GetInt("lod_background_interval");
+        }
+        if (merlin.Has("benchmark_sync")) {
+            merlinBenchmarkSync = merlin.GetBool("benchmark_sync");
+        }
+        if (merlin.Has("sync_capacity")) {
+            merlinSyncCapacity = merlin.GetInt("sync_capacity");
+        }
+        if (merlin.Has("bridge_recording")) {
+            merlinBridgeRecording = merlin.GetText("bridge_recording");
+        }
+        if (merlin.Has("ai_profile_interval_ms")) {
+            merlinAiProfileMs = merlin.GetFloat("ai_profile_interval_ms");
+        }
+        if (merlin.Has("pool_telemetry")) {
+            merlinPoolTelemetry = merlin.GetText("pool_telemetry");
+        }
+        if (merlin.Has("warm_start_dir")) {
+            merlinWarmStartDir = merlin.GetText("warm_start_dir");
+        }
+        if (merlin.Has("data_cache_dir")) {
+            merlinDataCacheDir = merlin.GetText("data_cache_dir");
+        }
+        if (merlin.Has("terrain_heightfield")) {
+            merlinHeightfield = merlin.GetText("terrain_heightfield");
+        }
+    }
+
     char buffer[512];
     sprintf_s(buffer,
               "Loaded LOJ-game config:\n  project_path = %s\n  theme_music = %s\n  level = %s\n",
@@ -666,7 +747,43 @@ void GameStartup::LoadGameScene(wi::scene::Scene &scene) {
         std::string exePath = wi::helper::GetExecutablePath();
         std::string exeDir = wi::helper::GetDirectoryFromPath(exePath);
         std::string merlin_path = exeDir + "Merlin";
-        merlinLua.Initialize(merlin_path);
+        if (!merlinWarmStartDir.empty() && merlinBridgeRecording.empty()) {
+            // A warm start skips the setup calls a recording needs, so recording sessions start
+            // cold. The snapshot is only valid for this level and these NPC models.
+            std::string warmStartDir = merlinWarmStartDir;
+            if (std::filesystem::path(warmStartDir).is_relative())
+                warmStartDir = exeDir + warmStartDir;
+            merlinLua.SetWarmStart(warmStartDir, {scenePath}, npcModel);
+        }
+        if (!merlinDataCacheDir.empty()) {
+            std::string dataCacheDir = merlinDataCacheDir;
+            if (std::filesystem::path(dataCacheDir).is_relative())
+                dataCacheDir = exeDir + dataCacheDir;
+            merlinLua.SetDataCache(dataCacheDir);
+        }
+        if (!merlinHeightfield.empty()) {
+            std::string heightfieldPath = merlinHeightfield;
+            if (std::filesystem::path(heightfieldPath).is_relative())
+                heightfieldPath = exeDir + heightfieldPath;
+            merlinLua.SetHeightfield(heightfieldPath);
+        }
+        merlinLua.Initialize(merlin_path, merlinBootCheckpoint, merlinSyncCapacity);
+        if (!merlinBridgeRecording.empty()) {
+            // Relative recording paths are next to the executable, like the Merlin directory
+            std::string recordingPath = merlinBridgeRecording;
+            if (std::filesystem::path(recordingPath).is_relative())
+                recordingPath = exeDir + recordingPath;
+            merlinLua.StartRecording(recordingPath);
+        }
+        if (!merlinPoolTelemetry.empty()) {
+            std::string telemetryDir = merlinPoolTelemetry;
+            if (std::filesystem::path(telemetryDir).is_relative())
+                telemetryDir = exeDir + telemetryDir;
+            merlinLua.SetPoolTelemetryDir(telemetryDir);
+        }
+        merlinLua.SetFrameBudget(merlinFrameBudgetMs);
+        merlinLua.SetSimTickRate(merlinSimTickRate, merlinMaxCatchUpTicks);
+        merlinLua.SetSimLodIntervals(merlinLodRingInterval, merlinLodBackgroundInterval);
 
         // Spawn player character from metadata
         SpawnCharactersFromMetadata(scene);
@@ -726,6 +843,10 @@ void GameStartup::LoadGameScene(wi::scene::Scene &scene) {
                 npcModelPaths.push_back(modelPath);
             }
             
+            // Spawn points and waypoints below Merlin's ground are raised onto it, so NPCs don't
+            // start inside the terrain it walks them on (one batched query for all of them)
+            merlinLua.SnapToTerrain(npcSpawnPoints);
+            merlinLua.SnapToTerrain(waypointPositions);
             merlinLua.CreateNpcs(npcSpawnPoints, npcModelPaths, waypointPositions);
 
             // Register waypoint GRYM entities in grym_merlin_entity_table
@@ -745,6 +866,17 @@ void GameStartup::LoadGameScene(wi::scene::Scene &scene) {
 
             // Initialize action dispatch table
             actionDispatchTable[merlinLua.QueryHstr("WALK_TO")] = &HandleWalkTo;
+
+            if (merlinBenchmarkSync) {
+                merlinLua.BenchmarkSyncPaths(100);
+            }
+
+            // Population is in place: pace the Lua collector from here on (this starts it from a
+            // heap without the loading garbage), then hand Merlin to its worker thread
+            merlinLua.SetGcBudget(merlinLuaGcBudgetMs);
+            if (merlinAsyncSimulation) {
+                merlinLua.StartAsyncSimulation();
+            }
         }
 
     } else {
@@ -780,18 +912,16 @@ void GameStartup::FeedbackGrymPositions(wi::scene::Scene &scene) {
 
 void GameStartup::UpdateProximitySpawning(wi::scene::Scene &scene, const XMFLOAT3 &playerPos,
                                           float dt) {
-    // Query all Merlin NPC states
-    std::vector<NpcState> npcStates = merlinLua.GetNpcStates();
+    // Query all Merlin NPC states (persistent mirror, updated from Merlin's deltas)
+    std::span<const NpcState> npcStates = merlinLua.GetNpcStates();
 
-    // Track which Merlin NPCs we've seen this frame
-    std::unordered_set<uint64_t> activeNpcs;
+    // Simulation LOD tiers are recomputed from the same distances every frame
+    merlinLua.BeginSimTiers();
 
     const float spawnRange = 100.0f;  // meters
     const float despawnDelay = 10.0f; // seconds
 
     for (const auto &npcState : npcStates) {
-        activeNpcs.insert(npcState.merlinId);
-
         // Compute distance to player (use Merlin position for proximity check)
         XMFLOAT3 npcPos(npcState.x, npcState.y, npcState.z);
         XMVECTOR playerVec = XMLoadFloat3(&playerPos);
@@ -803,14 +933,26 @@ void GameStartup::UpdateProximitySpawning(wi::scene::Scene &scene, const XMFLOAT
         auto it = grym_merlin_entity_table.find(npcState.merlinId);
         bool isSpawned = (it != grym_merlin_entity_table.end());
 
+        // Full rate within spawn range, reduced in the surrounding ring, background beyond.
+        // NPCs with a GRYM entity stay at full rate regardless of distance, so commands and
+        // outcomes in their action buffer are never left waiting on a throttled mind.
+        if (merlinSimLod) {
+            int tier = SIM_TIER_FULL;
+            if (!isSpawned && distance > spawnRange) {
+                tier = distance <= merlinLodRingRange ? SIM_TIER_RING : SIM_TIER_BACKGROUND;
+            }
+            merlinLua.AddSimTier(npcState.merlinId, tier);
+        }
+
         if (distance <= spawnRange) {
             // Within spawn range
             if (!isSpawned) {
                 // Spawn new GRYM entity at Merlin's position (initial placement only)
-                if (!npcState.modelPath.empty()) {
+                const char *modelPath = merlinLua.GetModelPath(npcState.modelIndex);
+                if (modelPath && modelPath[0]) {
                     XMFLOAT3 forward(0, 0, 1); // Default forward direction
                     wi::ecs::Entity grymEntity =
-                        SpawnCharacter(scene, npcState.modelPath, npcPos, forward, false);
+                        SpawnCharacter(scene, modelPath, npcPos, forward, false);
 
                     if (grymEntity != wi::ecs::INVALID_ENTITY) {
                         GrymMerlinEntityEntry entry;
@@ -824,8 +966,7 @@ void GameStartup::UpdateProximitySpawning(wi::scene::Scene &scene, const XMFLOAT
                         grym_merlin_entity_table[npcState.merlinId] = entry;
 
                         // Register buffer with Merlin so action rules can write to it
-                        MerlinLua::registerForeignActionCommandBuffer(npcState.merlinId,
-                                                                      entry.actionBuffer);
+                        merlinLua.RegisterActionBuffer(npcState.merlinId, entry.actionBuffer);
 
                         // Add to npcEntities tracking vector
                         npcEntities.push_back(grymEntity);
@@ -881,7 +1022,7 @@ void GameStartup::UpdateProximitySpawning(wi::scene::Scene &scene, const XMFLOAT
 
                     // Unregister and delete action buffer
                     if (it->second.actionBuffer) {
-                        MerlinLua::unregisterForeignActionCommandBuffer(npcState.merlinId);
+                        merlinLua.UnregisterActionBuffer(npcState.merlinId);
                         delete it->second.actionBuffer;
                     }
 
@@ -909,22 +1050,17 @@ void GameStartup::UpdateProximitySpawning(wi::scene::Scene &scene, const XMFLOAT
         }
     }
 
-    // Clean up stale entries for Merlin NPCs that no longer exist
-    std::vector<uint64_t> toRemove;
-    for (const auto &entry : grym_merlin_entity_table) {
-        if (activeNpcs.find(entry.first) == activeNpcs.end()) {
-            toRemove.push_back(entry.first);
-        }
-    }
+    merlinLua.CommitSimTiers();
 
-    for (uint64_t merlinId : toRemove) {
+    // Clean up entries for Merlin NPCs that no longer exist
+    for (uint64_t merlinId : merlinLua.GetRemovedNpcs()) {
         auto it = grym_merlin_entity_table.find(merlinId);
         if (it != grym_merlin_entity_table.end()) {
             wi::ecs::Entity grymEntity = it->second.grymEntity;
 
             // Unregister and delete action buffer
             if (it->second.actionBuffer) {
-                MerlinLua::unregisterForeignActionCommandBuffer(merlinId);
+                merlinLua.UnregisterActionBuffer(merlinId);
                 delete it->second.actionBuffer;
             }
 
@@ -1009,7 +1145,8 @@ void GameStartup::ShowMenu(bool visible) {
 
 static void HandleWalkTo(wi::scene::Scene &scene, wi::scene::CharacterComponent &character,
                          ForeignActionCommand &cmd,
-                         std::unordered_map<uint64_t, GrymMerlinEntityEntry> &entityTable) {
+                         std::unordered_map<uint64_t, GrymMerlinEntityEntry> &entityTable,
+                         MerlinLua &merlinLua) {
     // Resolve target position — depends on Merlin symbol type
     XMFLOAT3 targetPos;
     bool useEntityWalkTo = false;
@@ -1028,9 +1165,9 @@ static void HandleWalkTo(wi::scene::Scene &scene, wi::scene::CharacterComponent
 
     if (!useEntityWalkTo) {
         // Target is likely an OBB (spatial bounds) or other non-entity symbol.
-        // Use Merlin's worldPos() CInterface to extract the position.
-        auto mpos = MerlinLua::worldPos(cmd.target);
-        targetPos = XMFLOAT3(mpos.floats[0], mpos.floats[1], mpos.floats[2]);
+        // Use Merlin's worldPos() CInterface to extract the position (via MerlinLua, which
+        // serves it from the last sync point when the sim runs on its worker thread).
+        targetPos = merlinLua.ResolveWorldPos(cmd.target);
     }
 
     // DEBUG: Check which path we're taking and animation setup
@@ -1102,7 +1239,7 @@ void GameStartup::ProcessActionCommands(wi::scene::Scene &scene) {
 
             auto it = actionDispatchTable.find(cmd.actionLabelHstr);
             if (it != actionDispatchTable.end()) {
-                it->second(scene, *character, cmd, grym_merlin_entity_table);
+                it->second(scene, *character, cmd, grym_merlin_entity_table, merlinLua);
             }
         }
     }
@@ -105,6 +105,9 @@ class GameStartup {
     // Merlin Lua subsystem
     MerlinLua merlinLua;
 
+    // Time between AI profile samples while the profiler window is open ([merlin] section)
+    float GetMerlinAiProfileInterval() const { return merlinAiProfileMs; }
+
   private:
     // UI elements
     Noesis::Ptr<Noesis::Grid> menuContainer;
@@ -118,6 +121,26 @@ class GameStartup {
     std::string playerModel;
     std::string npcModel;
 
+    // Merlin settings ([merlin] section)
+    bool merlinAsyncSimulation = false;   // run Merlin ticks on a worker thread
+    float merlinFrameBudgetMs = 0.0f;     // per-frame Merlin time budget (0 = unbounded)
+    float merlinLuaGcBudgetMs = 0.5f;     // per-frame Lua GC budget (0 = automatic collector)
+    float merlinSimTickRate = 10.0f;      // fixed sim ticks per second (0 = one tick per frame)
+    int merlinMaxCatchUpTicks = 3;        // most sim ticks run in a single frame
+    std::string merlinBootCheckpoint;     // history checkpoint to boot from (empty = start in 1720)
+    bool merlinSimLod = true;             // distance-based simulation LOD tiers
+    float merlinLodRingRange = 300.0f;    // meters; NPCs beyond this use the background tier
+    int merlinLodRingInterval = 4;        // ticks between deliberations in the ring tier
+    int merlinLodBackgroundInterval = 20; // ticks between deliberations in the background tier
+    bool merlinBenchmarkSync = false;     // time Lua vs. native NPC sync once after loading
+    int merlinSyncCapacity = 256;         // initial entries per Merlin sync buffer (they grow)
+    std::string merlinBridgeRecording;    // file to record bridge inputs to (empty = off)
+    float merlinAiProfileMs = 1000.0f;    // AI profiler sampling interval (0 = off)
+    std::string merlinPoolTelemetry;      // directory for per-session pool telemetry (empty = off)
+    std::string merlinWarmStartDir;       // directory for warm-start snapshots (empty = off)
+    std::string merlinDataCacheDir;       // directory for the compiled data cache (empty = off)
+    std::string merlinHeightfield;        // Merlin terrain heightfield file (empty = off)
+
     // Music playback
     wi::audio::Sound menuMusic;
     wi::audio::SoundInstance menuMusicInstance;
@@ -138,7 +161,8 @@ class GameStartup {
     // Action dispatch: maps Merlin action label symbol → GRYM handler function
     using ActionHandler = void (*)(wi::scene::Scene &, wi::scene::CharacterComponent &,
                                    ForeignActionCommand &,
-                                   std::unordered_map<uint64_t, GrymMerlinEntityEntry> &);
+                                   std::unordered_map<uint64_t, GrymMerlinEntityEntry> &,
+                                   MerlinLua &);
     std::unordered_map<uint64_t, ActionHandler> actionDispatchTable;
 
     // Fullscreen state
@@ -0,0 +1,46 @@
+-- Scene layout compiler: compiles a layout.dat exported from the editor into the sector-indexed
+-- binary scenelayout.lua streams (a .mlb file), and reports what is in it. The game compiles the
+-- layout itself into the data cache; this is for checking a large layout, or for shipping one
+-- precompiled (sceneLayoutPath in scene.lua can name a .mlb file). Doesn't need Merlin.
+--
+-- Usage:
+--   luajit Merlin/Game/Scripts/compilelayout.lua <layout.dat> [out.mlb]
+
+ffi = require("ffi")
+
+if arg[1] == nil or arg[3] ~= nil then
+    io.stderr:write("usage: compilelayout.lua <layout.dat> [out.mlb]\n")
+    os.exit(1)
+end
+
+local scriptDir = string.match(arg[0], "^(.*)[/\\]") or "."
+dofile(scriptDir .. "/scenelayout.lua")
+
+local file = io.open(arg[1], "r")
+if file == nil then
+    io.stderr:write("compilelayout: can't read ", arg[1], "\n")
+    os.exit(1)
+end
+local text = file:read("*a")
+file:close()
+
+local startClock = os.clock()
+local binary, counts = compileSceneLayout(text)
+local compileMs = (os.clock() - startClock) * 1000
+
+print(string.format("%s: %d objects (%d roots) in %d of %d sectors of %dm, %d bytes, "
+                    .. "compiled in %.1f ms", arg[1], counts.objects, counts.roots,
+                    counts.usedSectors, counts.sectors, counts.sectorSize, #binary, compileMs))
+if counts.dropped > 0 then
+    print(string.format("%d objects dropped: their parent isn't in the layout", counts.dropped))
+end
+
+if arg[2] then
+    local out = io.open(arg[2], "wb")
+    if out == nil then
+        io.stderr:write("compilelayout: can't write ", arg[2], "\n")
+        os.exit(1)
+    end
+    out:write(binary)
+    out:close()
+end
@@ -0,0 +1,147 @@
+-- Headless history fast-forward: ages the Merlin world from firstSimYear (1720) to the year the
+-- game is set in, so the town has families, marriages and deaths before the player arrives.
+-- Runs Merlin without GRYM at full speed, with teleporting NPCs and coarse time steps, and
+-- writes checkpoints the game can boot from ([merlin] boot_checkpoint in config.ini).
+--
+-- Usage (e.g. as a batch job on a Linux box, with libmerlin.so built for it):
+--   luajit Merlin/Game/Scripts/fastforward.lua [options]
+--
+--   --merlin <dir>          Merlin data directory (default: derived from this script's path)
+--   --lib <path>            Merlin shared library (default: ./libmerlin.so, merlin.dll on Windows)
+--   --to <year>             Stop at the start of this year (default 1897)
+--   --npcs <n>              Root NPCs to start the population with (default 40)
+--   --steps-per-year <n>    Coarse time steps per sim year: 1, 2, 3, 4, 6 or 12 (default 4)
+--   --cycles-per-step <n>   Merlin cycles run per time step (default 1)
+--   --checkpoint-every <n>  Write a checkpoint every n sim years (default 25, 0 = final only)
+--   --out <dir>             Directory for checkpoints (default .)
+--   --resume <manifest>     Continue from an earlier checkpoint instead of 1720
+--   --seed <n>              Random seed (default 42)
+
+local ffi = require("ffi")
+
+local opts = {
+    merlin = nil,
+    lib = nil,
+    to = 1897,
+    npcs = 40,
+    ["steps-per-year"] = 4,
+    ["cycles-per-step"] = 1,
+    ["checkpoint-every"] = 25,
+    out = ".",
+    resume = nil,
+    seed = 42,
+}
+
+local knownOpts = {}
+for _, key in ipairs({"merlin", "lib", "to", "npcs", "steps-per-year", "cycles-per-step",
+                      "checkpoint-every", "out", "resume", "seed"}) do
+    knownOpts[key] = true
+end
+
+local i = 1
+while i <= #arg do
+    local key = string.match(arg[i], "^%-%-(.+)$")
+    if not knownOpts[key] or arg[i + 1] == nil then
+        io.stderr:write("fastforward: bad argument '", arg[i], "'\n")
+        os.exit(1)
+    end
+    opts[key] = tonumber(arg[i + 1]) or arg[i + 1]
+    i = i + 2
+end
+
+local stepsPerYear = opts["steps-per-year"]
+assert(12 % stepsPerYear == 0, "--steps-per-year must divide 12")
+local monthsPerStep = 12 / stepsPerYear
+
+-- Globals main.lua expects from the C++ host (MerlinLua::Initialize)
+local scriptDir = string.match(arg[0], "^(.*)[/\\]") or "."
+merlin_path = opts.merlin or (scriptDir .. "/../..")
+cwd = "."
+if opts.lib then
+    merlinLibPath = opts.lib
+elseif ffi.os ~= "Windows" then
+    merlinLibPath = "./libmerlin.so"
+end
+bootCheckpoint = opts.resume
+
+if ffi.os == "Windows" then
+    function bridgeNowMs() return os.clock() * 1000 end
+else
+    ffi.cdef[[
+        typedef struct { long tv_sec; long tv_nsec; } FastForwardTimespec;
+        int clock_gettime(int clockId, FastForwardTimespec *tp);
+    ]]
+    local ts = ffi.new("FastForwardTimespec")
+    function bridgeNowMs()
+        ffi.C.clock_gettime(1, ts) -- CLOCK_MONOTONIC
+        return tonumber(ts.tv_sec) * 1000 + tonumber(ts.tv_nsec) / 1e6
+    end
+end
+
+dofile(merlin_path .. "/Game/Scripts/main.lua")
+
+-- No GRYM host: the shared sync buffers are plain Lua-owned allocations
+waypointBuf = ffi.new("EntitySyncBuffer")
+
+local function scatteredSpawnPoints(count)
+    -- Random ground-level points inside the world's sectors
+    local points = {}
+    for n = 1, count do
+        local s = math.random(sectors.size) - 1
+        local minC, maxC = sectors.minCoords[s], sectors.maxCoords[s]
+        points[n] = {
+            x = minC.floats[0] + math.random() * (maxC.floats[0] - minC.floats[0]),
+            y = minC.floats[1],
+            z = minC.floats[2] + math.random() * (maxC.floats[2] - minC.floats[2]),
+        }
+    end
+    return points
+end
+
+local function checkpoint()
+    local manifestPath = string.format("%s/history_%d_%02d.lua", opts.out, simYear, simMonth + 1)
+    saveCheckpoint(manifestPath)
+    print("Checkpoint written: " .. manifestPath)
+end
+
+merlinInit()
+if bootCheckpoint ~= nil and not checkpointBooted then
+    os.exit(1)
+end
+mxu.setRandomSeed(opts.seed)
+mx.setNpcLocomotionMode("teleport")
+if not checkpointBooted then
+    createRootNpcs(scatteredSpawnPoints(opts.npcs), {}, {})
+    mx.setDateAndTime(simYear, simMonth, 0, simHour, 0, 0)
+end
+
+local startYears = simYear + simMonth / 12
+local startMs = bridgeNowMs()
+local lastYear = simYear
+print(string.format("Fast-forwarding from %d to %d: %d NPCs, %d steps/year, %d cycles/step",
+                    simYear, opts.to, mxu.rosterSize(), stepsPerYear, opts["cycles-per-step"]))
+
+while simYear < opts.to do
+    advanceHistorySim(monthsPerStep, opts["cycles-per-step"])
+
+    if simYear ~= lastYear then
+        lastYear = simYear
+        local simYears = simYear + simMonth / 12 - startYears
+        local wallMin = (bridgeNowMs() - startMs) / 60000
+        print(string.format("%d Q%d | %d NPCs | cycle %d | %.2f sim-years/min",
+                            simYear, simQuarter, mxu.rosterSize(), mx.cycle(),
+                            simYears / math.max(wallMin, 1e-6)))
+        local every = opts["checkpoint-every"]
+        if every > 0 and (simYear - firstSimYear) % every == 0 and simYear < opts.to then
+            checkpoint()
+        end
+    end
+end
+
+checkpoint()
+
+local simYears = simYear + simMonth / 12 - startYears
+local wallMin = (bridgeNowMs() - startMs) / 60000
+print(string.format("Done: %.1f sim-years in %.2f min (%.2f sim-years/min), %d NPCs",
+                    simYears, wallMin, simYears / math.max(wallMin, 1e-6), mxu.rosterSize()))
+endSim()
@@ -0,0 +1,143 @@
+-- Merlin pool limits tuner: merges the pool telemetry of many play sessions ([merlin]
+-- pool_telemetry in config.ini, one pools_<date>_<time>.txt per session) and writes a
+-- MerlinLimits.txt with every observed pool's init-reserved size set just above the highest
+-- occupancy any single instance reached. Pools then don't grow during play. Per-mind pools (npc.*)
+-- are reserved once per mind, so they are sized from the busiest mind's peak, not from totals.
+-- Plain Lua; doesn't need Merlin.
+--
+-- Usage:
+--   luajit Merlin/Game/Scripts/limitstuner.lua [options] <telemetry file> ...
+--
+--   --limits <file>     MerlinLimits.txt to start from (default: the one next to this script's
+--                       Game directory); its layout, comments and other settings are kept
+--   --out <file>        Where to write the recommendation (default: stdout)
+--   --headroom <frac>   Reserve this fraction above the highest peak seen (default 0.1)
+--   --round <n>         Round reservations up to a multiple of n items (default 4)
+--
+-- Pools with no telemetry keep their limits. A pool whose peak reached its max gets its max
+-- doubled, since Merlin can't have held everything it needed. A summary of the changes goes to
+-- stderr.
+
+local opts = {
+    limits = nil,
+    out = nil,
+    headroom = 0.1,
+    round = 4,
+}
+
+local knownOpts = { limits = true, out = true, headroom = true, round = true }
+
+local telemetryPaths = {}
+local i = 1
+while i <= #arg do
+    local key = string.match(arg[i], "^%-%-(.+)$")
+    if key == nil then
+        telemetryPaths[#telemetryPaths + 1] = arg[i]
+        i = i + 1
+    else
+        if not knownOpts[key] or arg[i + 1] == nil then
+            io.stderr:write("limitstuner: bad argument '", arg[i], "'\n")
+            os.exit(1)
+        end
+        opts[key] = tonumber(arg[i + 1]) or arg[i + 1]
+        i = i + 2
+    end
+end
+if #telemetryPaths == 0 then
+    io.stderr:write("usage: limitstuner.lua [--limits file] [--out file] [--headroom frac] ",
+                    "[--round n] <telemetry file> ...\n")
+    os.exit(1)
+end
+
+local scriptDir = string.match(arg[0], "^(.*)[/\\]") or "."
+local limitsPath = opts.limits or (scriptDir .. "/../MerlinLimits.txt")
+
+-- Merge the sessions: per pool, the highest per-instance peak, whether it ever reached its max,
+-- and the growth events summed over all sessions
+local pools = {}
+local sessions = 0
+for _, path in ipairs(telemetryPaths) do
+    local file = io.open(path, "r")
+    if file == nil then
+        io.stderr:write("limitstuner: cannot read ", path, "\n")
+        os.exit(1)
+    end
+    sessions = sessions + 1
+    for line in file:lines() do
+        local name, max, reserved, stride, instances, current, peak, growths = string.match(line,
+            "^(%S+%.pool)%s+(%d+)%s+(%d+)%s+(%d+)%s+(%d+)%s+(%d+)%s+(%d+)%s+(%d+)")
+        if name ~= nil then
+            local pool = pools[name]
+            if pool == nil then
+                pool = { peak = 0, instances = 0, growths = 0, sessions = 0, hitMax = false }
+                pools[name] = pool
+            end
+            peak = tonumber(peak)
+            pool.peak = math.max(pool.peak, peak)
+            pool.instances = math.max(pool.instances, tonumber(instances))
+            pool.growths = pool.growths + tonumber(growths)
+            pool.sessions = pool.sessions + 1
+            pool.hitMax = pool.hitMax or peak >= tonumber(max)
+        end
+    end
+    file:close()
+end
+
+local function roundUp(n, multiple)
+    return math.ceil(n / multiple) * multiple
+end
+
+-- Rewrite the pool lines of MerlinLimits.txt in its own column layout; everything else is copied
+local limitsFile = io.open(limitsPath, "r")
+if limitsFile == nil then
+    io.stderr:write("limitstuner: cannot read ", limitsPath, "\n")
+    os.exit(1)
+end
+local lines, seen, report = {}, {}, {}
+for line in limitsFile:lines() do
+    local name, max, reserved, stride = string.match(line,
+        "^(%S+%.pool)%s*=%s*(%d+)%s+(%d+)%s+(%d+)")
+    local pool = name and pools[name]
+    if pool then
+        seen[name] = true
+        max, reserved, stride = tonumber(max), tonumber(reserved), tonumber(stride)
+        local newReserved = roundUp(math.max(math.ceil(pool.peak * (1 + opts.headroom)), 1),
+                                    opts.round)
+        local newMax = pool.hitMax and max * 2 or max
+        newMax = math.max(newMax, newReserved)
+        line = string.format("%-36s=   %-8d%-8d%d", name, newMax, newReserved, stride)
+        if newMax ~= max or newReserved ~= reserved then
+            -- Per-instance items reserved more (+) or less (-), over the largest population seen
+            local items = (newReserved - reserved) * pool.instances
+            report[#report + 1] = string.format(
+                "  %-36s reserved %6d -> %-6d max %6d -> %-6d peak %6d, %d growths, %+d items%s",
+                name, reserved, newReserved, max, newMax, pool.peak, pool.growths, items,
+                pool.hitMax and " (hit max)" or "")
+        end
+    end
+    lines[#lines + 1] = line
+end
+limitsFile:close()
+
+local out = io.stdout
+if opts.out then
+    out = io.open(opts.out, "w")
+    if out == nil then
+        io.stderr:write("limitstuner: cannot write ", opts.out, "\n")
+        os.exit(1)
+    end
+end
+out:write(table.concat(lines, "\n"), "\n")
+if out ~= io.stdout then
+    out:close()
+end
+
+io.stderr:write(string.format("limitstuner: %d sessions, %d pools changed\n", sessions, #report))
+for _, entry in ipairs(report) do
+    io.stderr:write(entry, "\n")
+end
+for name in pairs(pools) do
+    if not seen[name] then
+        io.stderr:write("  ", name, " has telemetry but isn't in ", limitsPath, "; skipped\n")
+    end
+end
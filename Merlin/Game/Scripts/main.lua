@@ -13,37 +13,107 @@ dofile(merlin_path .. "/Game/Scripts/mx.lua")
 dofile(merlin_path .. "/Game/Scripts/mxu.lua")
 dofile(merlin_path .. "/Game/Scripts/npc.lua")
 dofile(merlin_path .. "/Game/Scripts/doc.lua")
+dofile(merlin_path .. "/Game/Scripts/scenelayout.lua")
 dofile(merlin_path .. "/Game/Scripts/scene.lua")
+dofile(merlin_path .. "/Game/Scripts/timerwheel.lua")
 dofile(merlin_path .. "/Game/Scripts/sim.lua")
 
 -- ---------------------------------------------------------------------------
 -- Shared C buffers for Merlin <-> GRYM entity sync.
--- Layout matches EntitySyncEntry / EntitySyncBuffer in MerlinLua.h exactly.
+-- The layout is defined once, in sync_layout.h, which MerlinLua.h also includes; the
+-- preprocessor lines are dropped here since ffi.cdef only takes declarations.
 -- uint64 entity symbols stay as raw uint64 — no double/string conversion.
 -- ---------------------------------------------------------------------------
-ffi.cdef[[
-    typedef struct {
-        uint64_t merlinId;
-        float x, y, z;
-        char modelPath[260];
-    } EntitySyncEntry;
-
-    typedef struct {
-        EntitySyncEntry entries[256];
-        int count;
-    } EntitySyncBuffer;
-]]
+do
+    local layoutFile = assert(io.open(merlin_path .. "/Game/Scripts/sync_layout.h", "r"))
+    local layout = layoutFile:read("*a")
+    layoutFile:close()
+    ffi.cdef((("\n" .. layout):gsub("\n#[^\n]*", "\n")))
+end
 
 -- Cast lightuserdata pointers (set by C++ in MerlinLua::Initialize) to FFI struct pointers
 local npcStateBuf    = ffi.cast("EntitySyncBuffer*", g_npcStateBufferPtr)
 local posFeedbackBuf = ffi.cast("EntitySyncBuffer*", g_posFeedbackBufferPtr)
 waypointBuf          = ffi.cast("EntitySyncBuffer*", g_waypointBufferPtr)
+simTierBuf           = ffi.cast("SimTierBuffer*", g_simTierBufferPtr)
+aiProfileBuf         = ffi.cast("AiProfileBuffer*", g_aiProfilePtr)
+local modelPathTable = ffi.cast("ModelPathTable*", g_modelPathTablePtr)
+
+-- Constants from sync_layout.h
+local SYNC_SPAWNED        = ffi.C.SYNC_SPAWNED
+local SYNC_MOVED          = ffi.C.SYNC_MOVED
+local SYNC_REMOVED        = ffi.C.SYNC_REMOVED
+local SYNC_FULL           = ffi.C.SYNC_FULL
+local NO_MODEL            = ffi.C.NO_MODEL
+local MODEL_PATH_CAPACITY = ffi.C.MODEL_PATH_CAPACITY
+local MODEL_PATH_MAX      = ffi.C.MODEL_PATH_MAX
+
+local SYNC_MOVE_EPSILON_SQ = 0.001 * 0.001 -- 1 mm
+
+-- Scene layout sectors made per player update at most, so walking into a dense part of town
+-- spreads the entity creation over a few frames
+local LAYOUT_SECTORS_PER_UPDATE = 2
+
+-- ModelPathTable index for each modelPath symbol seen, keyed by tostring(symbol)
+local modelIndexBySymbol = {}
+
+local function internModelPath(modelPathAttr)
+    -- Index of the model path in the table shared with C++, appending it if it isn't there yet.
+    -- C++ interns the configured models up front, so this is usually a table scan once per path.
+    local key = tostring(modelPathAttr)
+    local index = modelIndexBySymbol[key]
+    if index ~= nil then
+        return index
+    end
+    local mp = mxu.toLuaString(modelPathAttr)
+    index = NO_MODEL
+    for i = 0, modelPathTable.count - 1 do
+        if ffi.string(modelPathTable.paths[i]) == mp then
+            index = i
+            break
+        end
+    end
+    if index == NO_MODEL and modelPathTable.count < MODEL_PATH_CAPACITY and #mp < MODEL_PATH_MAX then
+        index = modelPathTable.count
+        ffi.copy(modelPathTable.paths[index], mp)
+        modelPathTable.count = index + 1
+    end
+    modelIndexBySymbol[key] = index
+    return index
+end
+
+-- What merlinGetNpcStates last sent for each NPC, keyed by tostring(npc):
+-- { id = npc, x, y, z, version, seen }
+local npcSent = {}
+local npcSentStamp = 0
 
 -- Global player entity
 playerEntity = nil
 
 
 
+function startSession()
+    -- Lua-side setup for a freshly started Merlin, whether cold (merlinInit) or warm
+    -- (merlinWarmStart): nothing here is kept in Merlin's snapshots
+    mx.toggleChannel("info", "off")
+    mx.toggleChannel("warning", "off")
+
+    -- Callbacks. The handlers run inside mx.sim(), so they stay interpreted (see "JIT
+    -- partitioning" in mxu.lua); the trampolines registered here are marked by mxu itself.
+    mxu.interpreted("giveBirth", giveBirth)
+    mxu.interpreted("siblingRel", siblingRel)
+    mxu.safeRegisterCallback("giveBirth", function(arg1, arg2, arg3, arg4) return giveBirth(arg1) end)
+    mxu.safeRegisterCallback("siblingRel", function(arg1, arg2, arg3, arg4) return siblingRel(arg1) end)
+    --mxu.safeRegisterCallback("acquireBuilding", function(arg1, arg2, arg3, arg4) return acquireBuilding(arg1) end)
+    --mxu.safeRegisterCallback("turnTo", function(arg1, arg2, arg3, arg4) return turnTo(arg1, arg2) end)
+
+    -- For realtime simulation, use traversal (not teleporting)
+    mx.setNpcLocomotionMode("traverse")
+
+    -- Frame-budgeted cycles need Merlin's resumable cycle entry points
+    simCanSlice = mxu.has("beginCycle") and mxu.has("simMinds") and mxu.has("endCycle")
+end
+
 function merlinInit()
     -- Control the console output I want to see
     --mx.toggleChannel("mc", "on")
@@ -65,42 +135,166 @@ function merlinInit()
     --mx.toggleChannel("nl", "on")
     --mx.toggleChannel("wme", "on")
 
-    -- Initialize Merlin
+    -- Initialize Merlin. dataParseMs (parsing the data tree and the trait tables) is reported by
+    -- MerlinLua's data cache.
+    local parseStartMs = bridgeNowMs()
     mx.start(projectPath, commonPath)
-    mx.toggleChannel("info", "off")
-    mx.toggleChannel("warning", "off")
-
-    -- Callbacks
-    mxu.safeRegisterCallback("giveBirth", function(arg1, arg2, arg3, arg4) return giveBirth(arg1) end)
-    mxu.safeRegisterCallback("siblingRel", function(arg1, arg2, arg3, arg4) return siblingRel(arg1) end)
-    --mxu.safeRegisterCallback("acquireBuilding", function(arg1, arg2, arg3, arg4) return acquireBuilding(arg1) end)
-    --mxu.safeRegisterCallback("turnTo", function(arg1, arg2, arg3, arg4) return turnTo(arg1, arg2) end)
+    dataParseMs = bridgeNowMs() - parseStartMs
+    startSession()
 
     -- Sync random seed across Lua/Merlin
     mxu.setRandomSeed(42)
 
     -- NPC traits
     mxu.initMerlinSymbols()
+    parseStartMs = bridgeNowMs()
     npcTraitTable = loadAttrTable("NpcTraitTables")
     npcNonTraitTable = loadAttrTable("NpcNonTraitTables")
+    dataParseMs = dataParseMs + bridgeNowMs() - parseStartMs
 
     -- Start off the sim during the FIRST QUARTER of 1720 (matching NPC birth year)
     firstSimYear = 1720
     simYear = firstSimYear
     simQuarter = 1
+    simMonth = 3 -- April (0-based), matching root NPC birth
     simHour = 6
     simMin = 0.0
     simSec = 0 -- only used by realtime sim
-
-    -- For realtime simulation, use traversal (not teleporting)
-    mx.setNpcLocomotionMode("traverse")
+    setSimClock(simHour, simMin, simSec)
 
     -- Load the game world
     loadScene()
+
+    -- Replace the freshly started world with an aged one written by fastforward.lua
+    checkpointBooted = false
+    if bootCheckpoint ~= nil and bootCheckpoint ~= "" then
+        checkpointBooted = loadCheckpoint(bootCheckpoint)
+        mx.setNpcLocomotionMode("traverse")
+    end
+end
+
+-- ---------------------------------------------------------------------------
+-- Warm start: MerlinLua saves the world right after the population is created, as Merlin's
+-- snapshot plus the Lua state from merlinWarmState, and later launches resume from it with
+-- merlinWarmStart instead of merlinInit/merlinCreatePlayer/merlinCreateNpcs.
+-- ---------------------------------------------------------------------------
+
+warmStarted = false
+local warmWaypoints = nil -- waypoint symbols restored by merlinWarmStart, for merlinCreateNpcs
+
+local function canWarmStart()
+    return mxu.has("saveSnapshot") and mxu.has("startFromSnapshot")
+end
+
+function merlinWarmState(snapshotPath)
+    -- Save Merlin's snapshot to snapshotPath and return Lua source for the Lua globals a warm
+    -- start can't get from it (nil if Merlin can't save or resume from snapshots)
+    if not canWarmStart() or not mx.saveSnapshot(snapshotPath) then
+        return nil
+    end
+    local waypoints = {}
+    for i = 0, waypointBuf.count - 1 do
+        waypoints[i + 1] = waypointBuf.entries[i].merlinId
+    end
+    return "return " .. mxu.serialize({
+        msym = msym,
+        npcTraitTable = attrTableState(npcTraitTable),
+        npcNonTraitTable = attrTableState(npcNonTraitTable),
+        firstSimYear = firstSimYear,
+        simYear = simYear,
+        simQuarter = simQuarter,
+        simMonth = simMonth,
+        simHour = simHour,
+        simMin = simMin,
+        simSec = simSec,
+        checkpointBooted = checkpointBooted,
+        playerEntity = playerEntity,
+        waypoints = waypoints,
+        layoutSectors = loadedSceneSectors(),
+    })
+end
+
+-- True if state has every field merlinWarmState saves, of the right type
+local function isWarmState(state)
+    if type(state) ~= "table" then
+        return false
+    end
+    for _, key in ipairs({ "msym", "npcTraitTable", "npcNonTraitTable", "waypoints" }) do
+        if type(state[key]) ~= "table" then
+            return false
+        end
+    end
+    for _, key in ipairs({ "firstSimYear", "simYear", "simQuarter", "simMonth", "simHour",
+                           "simMin", "simSec" }) do
+        if type(state[key]) ~= "number" then
+            return false
+        end
+    end
+    return state.layoutSectors == nil or type(state.layoutSectors) == "table"
+end
+
+function merlinWarmStart(snapshot, snapshotSize, savedState)
+    -- Start Merlin from a snapshot C++ has mapped into memory and restore the Lua globals saved
+    -- with it. Returns false, leaving Merlin unstarted, if Merlin can't use the snapshot: C++
+    -- then starts cold, so everything that can fail is checked before Merlin starts, and Merlin
+    -- is stopped again if the rest of the restore fails.
+    if not canWarmStart() then
+        return false
+    end
+    local ok, state, traitTable, nonTraitTable = pcall(function()
+        local state = assert(loadstring(savedState))()
+        assert(isWarmState(state), "missing or mistyped fields")
+        return state, restoreAttrTable(state.npcTraitTable),
+               restoreAttrTable(state.npcNonTraitTable)
+    end)
+    if not ok then
+        print("ERROR: Bad warm-start state: " .. tostring(state))
+        return false
+    end
+    if not mx.startFromSnapshot(projectPath, commonPath, snapshot, snapshotSize) then
+        print("ERROR: Merlin can't start from the warm-start snapshot")
+        return false
+    end
+
+    local err
+    ok, err = pcall(function()
+        startSession()
+        math.randomseed(42) -- Merlin's random stream comes back with the snapshot
+
+        msym = state.msym
+        npcTraitTable = traitTable
+        npcNonTraitTable = nonTraitTable
+        firstSimYear = state.firstSimYear
+        simYear = state.simYear
+        simQuarter = state.simQuarter
+        simMonth = state.simMonth
+        simHour = state.simHour
+        simMin = state.simMin
+        simSec = state.simSec
+        setSimClock(simHour, simMin, simSec)
+        checkpointBooted = state.checkpointBooted
+        playerEntity = state.playerEntity
+        warmWaypoints = state.waypoints
+        -- The layout's made sectors came with the world; the rest still stream in
+        openSceneLayout(sceneLayoutPath, kindToSystemTable, state.layoutSectors)
+        gatherSceneEntities()
+    end)
+    if not ok then
+        print("ERROR: Warm start failed after Merlin started: " .. tostring(err))
+        endSim()
+        playerEntity = nil
+        warmWaypoints = nil
+        return false
+    end
+    warmStarted = true
+    return true
 end
 
 function merlinCreatePlayer(x, y, z)
     -- Create player entity in Merlin environment at given position (in meters)
+    if warmStarted then
+        return -- restored with the world
+    end
     local playerPos = mxu.float3(x, y, z)
     local playerScale = mxu.float3(0.3, 1.0, 1.75)  -- width, height, depth in meters
     local playerQuat = mxu.quat(0, 0, 0, 1)  -- identity quaternion
@@ -118,6 +312,9 @@ function merlinCreatePlayer(x, y, z)
     mx.setSymbolAttr(playerEntity, "gender", mx.hstrSymbol("male"))
     
     print("Player entity created in Merlin environment")
+
+    -- Everything in range of the player is there from the start (y is up: x and z are ground)
+    streamSceneLayout(x, z)
 end
 
 function merlinUpdatePlayerPos(x, y, z)
@@ -127,13 +324,17 @@ function merlinUpdatePlayerPos(x, y, z)
     end
     
     -- Get current OBB and update position
+    -- (scratch values: this runs every frame and shouldn't feed the GC)
     local playerObb = mx.worldBounds(playerEntity)
-    local playerSize = mxu.float3(playerObb.floats[3], playerObb.floats[4], playerObb.floats[5])
-    local playerQuat = mxu.quat(playerObb.floats[6], playerObb.floats[7], playerObb.floats[8], playerObb.floats[9])
-    local newPos = mxu.float3(x, y, z)
+    local playerSize = mxu.tmpFloat3(1, playerObb.floats[3], playerObb.floats[4], playerObb.floats[5])
+    local playerQuat = mxu.tmpQuat(1, playerObb.floats[6], playerObb.floats[7], playerObb.floats[8], playerObb.floats[9])
+    local newPos = mxu.tmpFloat3(2, x, y, z)
     local newObb = mx.composeBounds(newPos, playerSize, playerQuat)
     
     mx.setLocalBoundsAttr(playerEntity, "obb", newObb)
+
+    -- Make the scene layout's sectors as the player nears them
+    streamSceneLayout(x, z, LAYOUT_SECTORS_PER_UPDATE)
 end
 
 function merlinCreateNpcs(spawnPoints, npcModelPath, waypointPositions)
@@ -150,62 +351,240 @@ function merlinCreateNpcs(spawnPoints, npcModelPath, waypointPositions)
     if waypointPositions == nil then
         waypointPositions = {}
     end
-    createRootNpcs(spawnPoints, npcModelPath, waypointPositions)
+    if warmStarted then
+        -- The population came with the world; C++ only needs the waypoint symbols back
+        waypointBuf.count = 0
+        for i = 1, math.min(#warmWaypoints, waypointBuf.capacity) do
+            waypointBuf.entries[i - 1].merlinId = warmWaypoints[i]
+            waypointBuf.count = i
+        end
+    elseif checkpointBooted then
+        -- The population comes from the checkpoint; it only needs models and waypoints
+        adoptCheckpointNpcs(npcModelPath, waypointPositions)
+    else
+        createRootNpcs(spawnPoints, npcModelPath, waypointPositions)
+    end
 end
 
-function merlinGetNpcStates()
-    -- Fill the shared npcStateBuffer with current NPC states.
+function merlinGetNpcStates(bufPtr, fullSync)
+    -- Fill an NPC state buffer with the NPCs that spawned, moved or were removed since the
+    -- previous fill. fullSync (optional) forgets what was sent and lists every NPC again.
+    -- bufPtr (optional lightuserdata) selects the buffer to fill; the async simulation passes
+    -- its back snapshot here. Defaults to the shared npcStateBuffer.
     -- uint64 merlinId stays as raw uint64 in the buffer — no conversion.
+    local buf = npcStateBuf
+    if bufPtr ~= nil then
+        buf = ffi.cast("EntitySyncBuffer*", bufPtr)
+    end
+    if fullSync then
+        npcSent = {}
+    end
+    npcSentStamp = npcSentStamp + 1
+    local stamp = npcSentStamp
+
+    local capacity = buf.capacity
     local idx = 0
-    for _, npc in mxu.iter(mx.npcs()) do
-        if idx >= 256 then break end
-        
+    local unsent = 0
+    for _, npc in mxu.rosterIter() do
+        local key = tostring(npc)
+        local sent = npcSent[key]
         local pos = mx.worldPos(npc)
-        npcStateBuf.entries[idx].merlinId = npc  -- raw uint64 symbol, no conversion
-        npcStateBuf.entries[idx].x = pos.floats[0]
-        npcStateBuf.entries[idx].y = pos.floats[1]
-        npcStateBuf.entries[idx].z = pos.floats[2]
-        
-        -- Get modelPath attribute
-        local modelPathAttr = mx.attrSymbol(npc, "modelPath")
-        if modelPathAttr ~= nil and modelPathAttr ~= 0 then
-            local mp = mxu.toLuaString(modelPathAttr)
-            if #mp < 260 then
-                ffi.copy(npcStateBuf.entries[idx].modelPath, mp)
-            else
-                ffi.copy(npcStateBuf.entries[idx].modelPath, mp, 259)
-                npcStateBuf.entries[idx].modelPath[259] = 0
-            end
+        local x, y, z = pos.floats[0], pos.floats[1], pos.floats[2]
+        local flags = 0
+        if sent == nil then
+            flags = SYNC_SPAWNED
         else
-            npcStateBuf.entries[idx].modelPath[0] = 0
+            sent.seen = stamp
+            local dx, dy, dz = x - sent.x, y - sent.y, z - sent.z
+            if dx * dx + dy * dy + dz * dz > SYNC_MOVE_EPSILON_SQ then
+                flags = SYNC_MOVED
+            end
+        end
+
+        -- A full buffer leaves the rest unsent; they are reported by the next fill (and counted,
+        -- so C++ can grow the buffer before then)
+        if flags ~= 0 and idx >= capacity then
+            unsent = unsent + 1
+        elseif flags ~= 0 then
+            if sent == nil then
+                sent = { id = npc, version = 0, seen = stamp }
+                npcSent[key] = sent
+            end
+            sent.x, sent.y, sent.z = x, y, z
+            sent.version = (sent.version + 1) % 65536
+
+            local entry = buf.entries[idx]
+            entry.merlinId = npc  -- raw uint64 symbol, no conversion
+            entry.x = x
+            entry.y = y
+            entry.z = z
+            entry.version = sent.version
+            entry.flags = flags
+            entry.modelIndex = NO_MODEL
+
+            -- The model only has to be sent once
+            if flags == SYNC_SPAWNED then
+                local modelPathAttr = mx.attrSymbol(npc, "modelPath")
+                if modelPathAttr ~= nil and modelPathAttr ~= 0 then
+                    entry.modelIndex = internModelPath(modelPathAttr)
+                end
+            end
+
+            idx = idx + 1
+        end
+    end
+
+    -- Tombstones for NPCs that have left the roster since the last fill
+    for key, sent in pairs(npcSent) do
+        if sent.seen ~= stamp and idx >= capacity then
+            unsent = unsent + 1
+        elseif sent.seen ~= stamp then
+            local entry = buf.entries[idx]
+            entry.merlinId = sent.id
+            entry.version = (sent.version + 1) % 65536
+            entry.flags = SYNC_REMOVED
+            entry.modelIndex = NO_MODEL
+            npcSent[key] = nil
+            idx = idx + 1
         end
-        
-        idx = idx + 1
     end
-    npcStateBuf.count = idx
+
+    buf.count = idx
+    buf.unsent = unsent
+    buf.flags = fullSync and SYNC_FULL or 0
+    -- Stamp the snapshot with the sim tick it reflects, for interpolation on the GRYM side
+    buf.tick = simClock.tick
+    buf.tickAlpha = simClock.alpha
 end
 
 function merlinApplyPosFeedback()
     -- Read GRYM physics-resolved positions from the shared posFeedbackBuffer
     -- and apply them to the corresponding Merlin entities.
     -- uint64 merlinId is read as raw uint64 cdata — directly usable as Merlin symbol.
+    -- Runs per NPC per frame, so the composeBounds arguments are scratch values.
     for i = 0, posFeedbackBuf.count - 1 do
         local entry = posFeedbackBuf.entries[i]
         local entity = entry.merlinId  -- uint64 cdata, directly usable with mx.* FFI calls
         
         local obb = mx.worldBounds(entity)
-        local size = mxu.float3(obb.floats[3], obb.floats[4], obb.floats[5])
-        local quat = mxu.quat(obb.floats[6], obb.floats[7], obb.floats[8], obb.floats[9])
-        local newPos = mxu.float3(entry.x, entry.y, entry.z)
+        local size = mxu.tmpFloat3(1, obb.floats[3], obb.floats[4], obb.floats[5])
+        local quat = mxu.tmpQuat(1, obb.floats[6], obb.floats[7], obb.floats[8], obb.floats[9])
+        local newPos = mxu.tmpFloat3(2, entry.x, entry.y, entry.z)
         local newObb = mx.composeBounds(newPos, size, quat)
         
         mx.setLocalBoundsAttr(entity, "obb", newObb)
     end
 end
 
-function merlinUpdate(dt)
-    -- Run one timestep of simulation per frame
-    advanceRealtimeSim(dt)
+function merlinSetTickRate(tickRate, maxCatchUpTicks)
+    -- Fixed simulation tick rate in Hz (0 = one tick per frame) and per-frame catch-up cap
+    setSimTickRate(tickRate, maxCatchUpTicks)
+end
+
+function merlinSetSimLod(ringInterval, backgroundInterval)
+    -- Ticks between deliberations for NPCs in the ring / background simulation LOD tiers
+    setSimLodIntervals(ringInterval, backgroundInterval)
+end
+
+function merlinUpdate(dt, budgetMs)
+    -- Run the fixed-rate ticks covered by dt (or a slice of one, if budgetMs is exceeded)
+    -- Returns (cyclesCompleted, suspended, ticksDropped, tick, tickAlpha)
+    local cycles, suspended, dropped = advanceRealtimeSim(dt, budgetMs)
+    return cycles, suspended, dropped, simClock.tick, simClock.alpha
+end
+
+function merlinBenchmarkJit(iterations)
+    -- Time the bridge's marshalling functions with the JIT on (how they normally run) and off,
+    -- and check that a C call re-entering Lua is still safe next to compiled code. Called by
+    -- MerlinLua::BenchmarkSyncPaths with the current positions in the feedback buffer, so
+    -- merlinApplyPosFeedback leaves the world unchanged; C++ resyncs the NPC mirror afterwards.
+    -- sampleAttrTable isn't timed: it draws from Merlin's random stream.
+    local cases = {
+        { "merlinGetNpcStates", merlinGetNpcStates, function() merlinGetNpcStates(nil, true) end },
+        { "merlinApplyPosFeedback", merlinApplyPosFeedback, merlinApplyPosFeedback },
+        { "mxu.rosterIter", mxu.rosterIter, function()
+            local n = 0
+            for _, npc in mxu.rosterIter() do
+                n = n + 1
+            end
+            return n
+        end },
+        { "mxu.makeBindings", mxu.makeBindings, function()
+            for _, npc in mxu.rosterIter() do
+                mxu.makeBindings({ "?child", npc, "?name", npc })
+            end
+        end },
+    }
+
+    local function timeMs(run)
+        run() -- warm up (and give the JIT a chance to record)
+        local startMs = bridgeNowMs()
+        for i = 1, iterations do
+            run()
+        end
+        return (bridgeNowMs() - startMs) / iterations
+    end
+
+    for _, case in ipairs(cases) do
+        local name, fn, run = case[1], case[2], case[3]
+        local onMs = timeMs(run)
+        jit.off(fn, true)
+        local offMs = timeMs(run)
+        jit.on(fn, true)
+        print(string.format("Merlin JIT benchmark (%d NPCs x %d): %s %.3f ms compiled, %.3f ms interpreted (x%.1f)",
+                            mxu.rosterSize(), iterations, name, onMs, offMs, offMs / math.max(onMs, 1e-6)))
+    end
+
+    local ok, err = mxu.checkCallbackReentry(math.max(iterations, 1000))
+    if ok then
+        print("Merlin JIT: callback re-entry check passed")
+    else
+        print("ERROR: Merlin JIT: callback re-entry check failed: " .. tostring(err))
+    end
+end
+
+function merlinBenchmarkIntrospection(iterations)
+    -- Per-NPC cost of reading a mind's acts by value (a whole MerlinActArray per list) against
+    -- mxu's cursor-based paging, over the first NPCs of the roster
+    local roster, rosterSize = mxu.roster()
+    local npcs = math.min(rosterSize, 16)
+    if npcs == 0 then
+        return
+    end
+    local cases = {
+        { "runningTasks by value", function(npc) return mx.runningTasks(npc).size end },
+        { "all four lists by value", function(npc)
+            return mx.proposedTasks(npc).size + mx.runningTasks(npc).size
+                   + mx.proposedActions(npc).size + mx.runningActions(npc).size
+        end },
+        { "mxu.countActs", function(npc) return mxu.countActs(npc, mxu.ACTS_ALL) end },
+        { "mxu.acts with causes", function(npc)
+            local n = 0
+            for _, _, _, _, numCauses in mxu.acts(npc, mxu.ACTS_ALL, nil, 64) do
+                n = n + 1 + numCauses
+            end
+            return n
+        end },
+    }
+
+    local function timeUs(run)
+        for i = 0, npcs - 1 do
+            run(roster[i]) -- warm up
+        end
+        local startMs = bridgeNowMs()
+        for _ = 1, iterations do
+            for i = 0, npcs - 1 do
+                run(roster[i])
+            end
+        end
+        return (bridgeNowMs() - startMs) * 1000 / (iterations * npcs)
+    end
+
+    for _, case in ipairs(cases) do
+        print(string.format("Merlin introspection benchmark (%d NPCs x %d): %s %.2f us/NPC%s",
+                            npcs, iterations, case[1], timeUs(case[2]),
+                            mxu.has("queryActs") and "" or " (no queryActs, by-value fallback)"))
+    end
 end
 
 function merlinShutdown()
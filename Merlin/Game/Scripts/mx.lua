@@ -1,7 +1,8 @@
 
 
 ffi = require("ffi")
-mx = ffi.load(cwd .. "/merlin")
+-- merlinLibPath lets headless runs (e.g. fastforward.lua on Linux) point at libmerlin.so
+mx = ffi.load(merlinLibPath or (cwd .. "/merlin"))
 
 ffi.cdef[[
 
@@ -54,6 +55,30 @@ ffi.cdef[[
         int size;
     } MerlinActArray;
 
+    // Cursor-based act introspection (queryActs): the caller owns the arrays, and only the acts
+    // that match the filter are copied, without the fixed 256 x 64 causes block
+    enum {
+        MERLIN_ACTS_PROPOSED_TASKS = 1,
+        MERLIN_ACTS_RUNNING_TASKS = 2,
+        MERLIN_ACTS_PROPOSED_ACTIONS = 4,
+        MERLIN_ACTS_RUNNING_ACTIONS = 8
+    };
+
+    typedef struct {
+        uint32_t kinds;          // MERLIN_ACTS_* bits to list
+        float minUtil;           // skip acts with a lower utility
+        int32_t maxCausesPerAct; // causes copied per act (0 = none)
+    } MerlinActFilter;
+
+    typedef struct {
+        uint64_t act;           // raw act symbol
+        uint64_t outcompetedBy; // the act that prevented this one from being selected
+        float util;
+        uint16_t kind;          // the MERLIN_ACTS_* list the act is from
+        uint16_t numCauses;     // causes copied for this act
+        int32_t firstCause;     // index of the first of them in the caller's causes array
+    } MerlinActRow;
+
     typedef struct {
         char buffer[kStringCapacity];
     } MerlinString;
@@ -76,6 +101,22 @@ ffi.cdef[[
         int size;
     } MerlinSectorArray;
 
+    // One root NPC for birthRootNpcs
+    typedef struct {
+        MerlinFloat3 pos;        // spawn position, meters
+        const char *gender;      // "male" or "female"
+        const char *socialClass; // "upper" or "common"
+        const char *modelPath;   // GRYM model for rendering ("" = none)
+    } MerlinNpcSpec;
+
+    // One scene-layout object for makeLayoutEntities, as scenelayout.lua compiles them
+    typedef struct {
+        MerlinObb bounds; // meters, y up; a sub-entity's position is a fraction of its parent's radii
+        uint32_t kind;    // offsets of NUL-terminated strings in the layout's string table
+        uint32_t name;
+        int32_t parent;   // index of the parent object earlier in the same call, -1 for a root
+    } MerlinLayoutObject;
+
     typedef uint64_t (*MerlinCallback)(uint64_t, uint64_t, uint64_t, uint64_t);
     typedef void (*SoundCallback)(uint64_t);
 
@@ -110,6 +151,12 @@ ffi.cdef[[
     float terrainElevation(float wx, float wy);
     void loadSceneLayout(const char *layoutPathName, const char **rawKindToSystemTable, int tableSize);
 
+    // Scene layout streaming (optional, see mxu.has): loadSceneLayout's entities for count compiled
+    // layout objects in one call, each in the system of the first kind in rawKindToSystemTable its
+    // kind is a kind of, named and bounded as loadSceneLayout does. Writes the entities to
+    // outEntities and returns how many were made.
+    int makeLayoutEntities(const MerlinLayoutObject *objects, int count, const char *strings, const char **rawKindToSystemTable, int tableSize, uint64_t *outEntities);
+
     void setNpcLocomotionMode(const char *mode);
 
     uint64_t makeRootEntityNow(const char *systemName, const char *kindStr, MerlinObb obb);
@@ -126,6 +173,12 @@ ffi.cdef[[
 
     MerlinSymbolArray npcs();
 
+    // Versioned roster (optional, see mxu.has): rosterVersion changes whenever minds are created
+    // or destroyed; rosterNpcs copies up to capacity NPC symbols and returns the roster size
+    // (not capped at kSymbolArrayCapacity)
+    uint32_t rosterVersion();
+    int rosterNpcs(uint64_t *rawNpcs, int capacity);
+
     uint64_t findEntityByName(const char *systemNameStr, uint64_t rawFirstName, uint64_t rawSurname);
     MerlinSymbolArray findEntitiesOfKind(const char *systemNameStr, const char *kindStr);
 
@@ -172,6 +225,36 @@ ffi.cdef[[
     void allSleep();
     void sim(int cycles);
 
+    // Resumable cycle (optional, see mxu.has): sim(1) split into an environment step, any number
+    // of mind slices, and a finishing step that dispatches the cycle's actions
+    void beginCycle();
+    void simMinds(const uint64_t *rawMinds, int numMinds);
+    void endCycle();
+
+    // World snapshots (optional, see mxu.has): the complete Merlin state, for history checkpoints
+    bool saveSnapshot(const char *path);
+    bool loadSnapshot(const char *path);
+
+    // Warm start (optional, see mxu.has): start() with the world of a saveSnapshot file the caller
+    // has mapped read-only into memory, instead of parsing the data tree. The mapping must
+    // outlive stop().
+    bool startFromSnapshot(const char *rootPath, const char *basePath, const void *snapshot, uint64_t size);
+
+    // Shared knowledge (optional, see mxu.has): makeKnowledge parses each pattern once and
+    // instantiates it with every row of bindings; believeKnowledge gives the resulting beliefs
+    // to many minds at once. Entities bound to variables stand for each mind's own mental
+    // representation of them (as mx.observe would give). Minds share the beliefs copy-on-write
+    // until they revise one. freeKnowledge drops the caller's reference; minds keep theirs.
+    uint64_t makeKnowledge(const char **patterns, int numPatterns, const MerlinVarBindings *rows, int numRows);
+    void believeKnowledge(uint64_t rawKnowledge, const uint64_t *rawMinds, int numMinds);
+    void freeKnowledge(uint64_t rawKnowledge);
+
+    // Bulk population (optional, see mxu.has): npc.lua's birthRootNpc for numNpcs NPCs in one
+    // call. Alias tables built from the trait tables sample each value in O(1) straight to a
+    // symbol, in parallel; the seed makes the result independent of the thread count. Writes
+    // the NPC symbols to outNpcs and returns how many were born.
+    int birthRootNpcs(const AttrTable *traitTable, const AttrTable *nonTraitTable, const MerlinNpcSpec *specs, int numNpcs, uint64_t birthSeconds, const char *rules, uint32_t seed, uint64_t *outNpcs);
+
     MerlinObb composeBounds(MerlinFloat3 pos, MerlinFloat3 scale, MerlinQuat quat);
     MerlinObb mentalBounds(uint64_t rawSubject, uint64_t rawSymbol);
     MerlinObb worldBounds(uint64_t rawSymbol);
@@ -211,6 +294,14 @@ ffi.cdef[[
     MerlinActArray runningTasks(uint64_t rawSubject);
     MerlinActArray proposedActions(uint64_t rawSubject);
     MerlinActArray runningActions(uint64_t rawSubject);
+
+    // Cursor-based introspection (optional, see mxu.has; mxu.acts falls back to the calls above).
+    // Copies the subject's acts that match the filter, in MERLIN_ACTS_* order, starting at
+    // *cursor. A page ends when rows or causes are full; *cursor is advanced past the rows
+    // copied and set to -1 once every matching act has been returned. Returns the rows copied,
+    // or with maxRows 0, the number of matching acts (nothing is copied).
+    int queryActs(uint64_t rawSubject, const MerlinActFilter *filter, int32_t *cursor,
+                  MerlinActRow *rows, int maxRows, uint64_t *causes, int maxCauses);
 ]]
 
 MerlinSymbolArray = ffi.typeof("MerlinSymbolArray")
@@ -14,6 +14,13 @@ end
 mxu = mxu or {}
 
 
+-- True if the loaded Merlin library exports the given CInterface function.
+-- Lets scripts use newer entry points while still running against older Merlin builds.
+function mxu.has(funcName)
+    local ok, fn = pcall(function() return mx[funcName] end)
+    return ok and fn ~= nil
+end
+
 function mxu.setRandomSeed(seed)
     math.randomseed(seed)
     mx.setRandomSeed(seed)
@@ -29,6 +36,51 @@ function mxu.iter(mxarray)
     end
 end
 
+-- NPC roster cached on the game side: a dense uint64_t array, rebuilt only when Merlin's roster
+-- version changes (births, deaths, spawns), so walking it every frame copies nothing and isn't
+-- capped at 256. Merlin builds without rosterVersion fall back to copying mx.npcs() per call.
+local hasRosterVersion = mxu.has("rosterVersion") and mxu.has("rosterNpcs")
+local roster = { version = nil, symbols = nil, count = 0, capacity = 0, array = nil }
+
+-- Returns (symbols, count, version), symbols[0 .. count - 1]. The array is reused: it is only
+-- valid until the roster next changes, which changes version. version is nil without
+-- rosterVersion, where every call may return a different roster.
+function mxu.roster()
+    if not hasRosterVersion then
+        roster.array = mx.npcs()
+        return roster.array.buffer, roster.array.size, nil
+    end
+    local version = mx.rosterVersion()
+    if version ~= roster.version then
+        local count = mx.rosterNpcs(roster.symbols, roster.capacity)
+        if count > roster.capacity then
+            roster.capacity = math.max(count, roster.capacity * 2)
+            roster.symbols = ffi.new("uint64_t[?]", roster.capacity)
+            count = mx.rosterNpcs(roster.symbols, roster.capacity)
+        end
+        roster.version = version
+        roster.count = count
+    end
+    return roster.symbols, roster.count, roster.version
+end
+
+-- for i, npc in mxu.rosterIter() do ... end, like mxu.iter(mx.npcs())
+function mxu.rosterIter()
+    local symbols, count = mxu.roster()
+    local i = -1
+    return function()
+        i = i + 1
+        if i < count then
+            return i+1, symbols[i]
+        end
+    end
+end
+
+function mxu.rosterSize()
+    local _, count = mxu.roster()
+    return count
+end
+
 function mxu.actIter(mxarray)
     local i = -1
     return function()
@@ -39,6 +91,121 @@ function mxu.actIter(mxarray)
     end
 end
 
+-- Act introspection through Merlin's cursor API (mx.queryActs): acts are copied a page at a time
+-- into scratch arrays reused across calls, and only populated rows are copied. Merlin builds
+-- without it fall back to the by-value calls, each of which copies a whole ~137 KB
+-- MerlinActArray. kinds is a sum of mxu.ACTS_* bits; minUtil (optional) skips weaker acts.
+mxu.ACTS_PROPOSED_TASKS = ffi.C.MERLIN_ACTS_PROPOSED_TASKS
+mxu.ACTS_RUNNING_TASKS = ffi.C.MERLIN_ACTS_RUNNING_TASKS
+mxu.ACTS_PROPOSED_ACTIONS = ffi.C.MERLIN_ACTS_PROPOSED_ACTIONS
+mxu.ACTS_RUNNING_ACTIONS = ffi.C.MERLIN_ACTS_RUNNING_ACTIONS
+mxu.ACTS_ALL = bit.bor(mxu.ACTS_PROPOSED_TASKS, mxu.ACTS_RUNNING_TASKS,
+                       mxu.ACTS_PROPOSED_ACTIONS, mxu.ACTS_RUNNING_ACTIONS)
+
+local ACT_PAGE_ROWS = 64
+local ACT_PAGE_CAUSES = 1024
+local hasQueryActs = mxu.has("queryActs")
+local actPage = nil -- scratch for mx.queryActs, created on first use
+local actLists = { -- by-value fallback, in MERLIN_ACTS_* order
+    { kind = mxu.ACTS_PROPOSED_TASKS, fn = "proposedTasks" },
+    { kind = mxu.ACTS_RUNNING_TASKS, fn = "runningTasks" },
+    { kind = mxu.ACTS_PROPOSED_ACTIONS, fn = "proposedActions" },
+    { kind = mxu.ACTS_RUNNING_ACTIONS, fn = "runningActions" },
+}
+
+local function actQuery(kinds, minUtil, maxCausesPerAct)
+    if actPage == nil then
+        actPage = {
+            filter = ffi.new("MerlinActFilter"),
+            cursor = ffi.new("int32_t[1]"),
+            rows = ffi.new("MerlinActRow[?]", ACT_PAGE_ROWS),
+            causes = ffi.new("uint64_t[?]", ACT_PAGE_CAUSES),
+        }
+    end
+    actPage.filter.kinds = kinds
+    actPage.filter.minUtil = minUtil or -math.huge
+    actPage.filter.maxCausesPerAct = math.min(maxCausesPerAct or 0, ACT_PAGE_CAUSES)
+    actPage.cursor[0] = 0
+    return actPage
+end
+
+-- Number of the subject's acts of the given kinds
+function mxu.countActs(subject, kinds, minUtil)
+    if hasQueryActs then
+        local page = actQuery(kinds, minUtil, 0)
+        return mx.queryActs(subject, page.filter, page.cursor, nil, 0, nil, 0)
+    end
+    local count = 0
+    minUtil = minUtil or -math.huge
+    for _, list in ipairs(actLists) do
+        if bit.band(kinds, list.kind) ~= 0 then
+            local array = mx[list.fn](subject)
+            for i = 0, array.size - 1 do
+                if array.util[i] >= minUtil then
+                    count = count + 1
+                end
+            end
+        end
+    end
+    return count
+end
+
+-- for kind, act, util, outcompetedBy, numCauses, causes in mxu.acts(subject, kinds) do ... end
+-- causes points at up to maxCausesPerAct (default 0) causes and, like the rows, is only valid
+-- until the next step. The scratch arrays are shared, so mxu.acts loops can't be nested.
+function mxu.acts(subject, kinds, minUtil, maxCausesPerAct)
+    if not hasQueryActs then
+        return mxu.actsByValue(subject, kinds, minUtil, maxCausesPerAct)
+    end
+    local page = actQuery(kinds, minUtil, maxCausesPerAct)
+    local count, i = 0, 0
+    return function()
+        if i >= count then
+            if page.cursor[0] < 0 then
+                return nil
+            end
+            count = mx.queryActs(subject, page.filter, page.cursor, page.rows, ACT_PAGE_ROWS,
+                                 page.causes, ACT_PAGE_CAUSES)
+            i = 0
+            if count == 0 then
+                return nil
+            end
+        end
+        local row = page.rows[i]
+        i = i + 1
+        return row.kind, row.act, row.util, row.outcompetedBy, row.numCauses,
+               page.causes + row.firstCause
+    end
+end
+
+-- mxu.acts over the by-value MerlinActArray calls (one full copy per list)
+function mxu.actsByValue(subject, kinds, minUtil, maxCausesPerAct)
+    minUtil = minUtil or -math.huge
+    maxCausesPerAct = maxCausesPerAct or 0
+    local listIndex, array, i = 0, nil, 0
+    return function()
+        while true do
+            if array ~= nil and i < array.size then
+                local row = i
+                i = i + 1
+                if array.util[row] >= minUtil then
+                    local list = actLists[listIndex]
+                    return list.kind, array.acts[row], array.util[row], array.outcompetedBy[row],
+                           math.min(array.numCauses[row], maxCausesPerAct), array.causes[row]
+                end
+            else
+                repeat
+                    listIndex = listIndex + 1
+                until listIndex > #actLists or bit.band(kinds, actLists[listIndex].kind) ~= 0
+                if listIndex > #actLists then
+                    return nil
+                end
+                array, i = mx[actLists[listIndex].fn](subject), 0
+            end
+        end
+    end
+end
+
 function mxu.sectorIter(mxarray)
     local i = -1
     return function()
@@ -68,6 +235,44 @@ function mxu.initMerlinSymbols()
     msym.participant = mx.hstrSymbol("participant")
 end
 
+-- Lua source that rebuilds a value made of tables, strings, numbers, booleans and symbols
+-- (uint64_t cdata), for loadstring. Tables must not contain cycles.
+function mxu.serialize(value)
+    local parts = {}
+    local function write(v)
+        local kind = type(v)
+        if kind == "table" then
+            parts[#parts + 1] = "{"
+            for key, item in pairs(v) do
+                parts[#parts + 1] = "["
+                write(key)
+                parts[#parts + 1] = "]="
+                write(item)
+                parts[#parts + 1] = ","
+            end
+            parts[#parts + 1] = "}"
+        elseif kind == "string" then
+            parts[#parts + 1] = string.format("%q", v)
+        elseif kind == "number" then
+            if v ~= v then
+                parts[#parts + 1] = "(0/0)"
+            elseif v == math.huge or v == -math.huge then
+                parts[#parts + 1] = v > 0 and "math.huge" or "-math.huge"
+            else
+                parts[#parts + 1] = string.format("%.17g", v)
+            end
+        elseif kind == "boolean" then
+            parts[#parts + 1] = tostring(v)
+        elseif kind == "cdata" and ffi.istype("uint64_t", v) then
+            parts[#parts + 1] = tostring(v) -- 123ULL, a uint64_t literal to LuaJIT
+        else
+            error("mxu.serialize: can't serialize a " .. kind)
+        end
+    end
+    write(value)
+    return table.concat(parts)
+end
+
 function mxu.toLuaString(symbol)
     return ffi.string(mx.toString(symbol).buffer)
 end
@@ -137,6 +342,51 @@ function mxu.quat(x, y, z, w)
     return quat
 end
 
+-- Scratch values
+-- Allocation-free variants of mxu.float3/quat/makeBindings for code that runs per NPC per frame.
+-- Each returns the same preallocated cdata every time, so a result is only valid until the next
+-- call with the same slot: pass it straight to Merlin and never keep it. Don't use them in code
+-- that a Merlin callback can re-enter.
+local SCRATCH_SLOTS = 4
+local scratchFloat3, scratchFloat3Ptr = {}, {}
+local scratchQuat, scratchQuatPtr = {}, {}
+for slot = 1, SCRATCH_SLOTS do
+    scratchFloat3[slot] = ffi.new("MerlinFloat3")
+    scratchFloat3Ptr[slot] = ffi.cast("float *", scratchFloat3[slot].floats)
+    scratchQuat[slot] = ffi.new("MerlinQuat")
+    scratchQuatPtr[slot] = ffi.cast("float *", scratchQuat[slot].floats)
+end
+local scratchBindings = ffi.new("MerlinVarBindings[1]")
+
+function mxu.tmpFloat3(slot, x, y, z)
+    local floats = scratchFloat3Ptr[slot]
+    floats[0] = x
+    floats[1] = y
+    floats[2] = z
+    return scratchFloat3[slot]
+end
+
+function mxu.tmpQuat(slot, x, y, z, w)
+    local floats = scratchQuatPtr[slot]
+    floats[0] = x
+    floats[1] = y
+    floats[2] = z
+    floats[3] = w
+    return scratchQuat[slot]
+end
+
+function mxu.tmpBindings(name1, value1, name2, value2, name3, value3, name4, value4)
+    -- Up to four {name, value} pairs; names must be string constants (they aren't copied)
+    local bindingsRef = scratchBindings[0]
+    local n = 0
+    if name1 ~= nil then bindingsRef.varNames[0] = name1; bindingsRef.values[0] = value1; n = 1 end
+    if name2 ~= nil then bindingsRef.varNames[1] = name2; bindingsRef.values[1] = value2; n = 2 end
+    if name3 ~= nil then bindingsRef.varNames[2] = name3; bindingsRef.values[2] = value3; n = 3 end
+    if name4 ~= nil then bindingsRef.varNames[3] = name4; bindingsRef.values[3] = value4; n = 4 end
+    bindingsRef.numBindings = n
+    return scratchBindings
+end
+
 function mxu.obbPos(obb)
     return mxu.float3(obb.floats[0], obb.floats[1], obb.floats[2])
 end
@@ -247,8 +497,60 @@ local dispatcher = ffi.cast("MerlinCallback", function(arg1, arg2, arg3, arg4)
     return ffi.new("uint64_t", 0) -- placeholder, will be overridden
 end)
 
+-- JIT partitioning
+-- Merlin calls registered callbacks from inside some of its entry points (mx.sim, simMinds,
+-- ...). LuaJIT can't take a callback while a C call made from compiled code is in progress, so
+-- the callback handlers and every Lua function that calls such an entry point are kept
+-- interpreted with mxu.interpreted(). Everything else is left to the JIT; in particular the
+-- sync bridge's marshalling loops, which only call plain data accessors.
+
+mxu.interpretedFns = mxu.interpretedFns or {} -- name -> function, for diagnostics
+
+function mxu.interpreted(name, fn)
+    -- Never compile fn (or the functions defined inside it). Returns fn.
+    jit.off(fn, true)
+    mxu.interpretedFns[name] = fn
+    return fn
+end
+
+function mxu.checkCallbackReentry(iterations)
+    -- Make a C call that re-enters Lua (qsort with a Lua comparator) from a hot loop in an
+    -- interpreted function, while a compiled loop keeps calling it. This is the pattern mx.sim
+    -- and the Merlin callbacks follow. Returns true, or false and the error.
+    pcall(ffi.cdef, [[
+        void qsort(void *base, size_t num, size_t size, int (*compare)(const void *, const void *));
+    ]])
+    local values = ffi.new("int32_t[8]")
+    local compares = 0
+    local compare = ffi.cast("int (*)(const void *, const void *)", function(a, b)
+        compares = compares + 1
+        return ffi.cast("const int32_t *", a)[0] - ffi.cast("const int32_t *", b)[0]
+    end)
+    local sortValues = mxu.interpreted("checkCallbackReentry.sortValues", function(seed)
+        for i = 0, 7 do
+            values[i] = (seed * 7 + i * 13) % 31
+        end
+        ffi.C.qsort(values, 8, ffi.sizeof("int32_t"), compare)
+    end)
+    local ok, err = pcall(function()
+        for i = 1, iterations do
+            sortValues(i)
+            for j = 1, 7 do
+                assert(values[j - 1] <= values[j], "callback result lost")
+            end
+        end
+    end)
+    compare:free()
+    mxu.interpretedFns["checkCallbackReentry.sortValues"] = nil
+    if ok and compares == 0 then
+        return false, "comparator never called"
+    end
+    return ok, err
+end
+
 function mxu.safeRegisterCallback(name, lua_fn)
     -- make a wrapped ffi callback that catches errors
+    mxu.interpreted(name, lua_fn)
     local cb = ffi.cast("MerlinCallback", function(arg1, arg2, arg3, arg4)
         local ok, res = pcall(lua_fn, arg1, arg2, arg3, arg4)
         if not ok then
@@ -274,6 +576,7 @@ end
 
 function mxu.safeRegisterSoundCallback(lua_fn)
     -- make a wrapped ffi callback that catches errors
+    mxu.interpreted("SoundCallback", lua_fn)
     local cb = ffi.cast("SoundCallback", function(arg)
         local ok = pcall(lua_fn, arg)
         if not ok then
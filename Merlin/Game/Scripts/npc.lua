@@ -27,13 +27,76 @@ function generateChildNpcNameSymbol(gender, nationality, father)
     return mx.assembleRandomName("human_npc", firstNameStr, surname)
 end
 
+-- Compiled trait tables (see MerlinLua::SetDataCache): a table file's rows as uint32 rows,
+-- 4 bytes of padding, a double per row, a uint32 name offset per row, then the NUL-terminated
+-- names. Tables are read relative to projectPath, which is Game in the data tree.
+local function compiledTable(path)
+    if bridgeCompiledData == nil then
+        return nil
+    end
+    return bridgeCompiledData("Game/" .. path)
+end
+
+local function storeCompiledTable(path, names, weights, rows)
+    if bridgeStoreCompiled == nil then
+        return
+    end
+    local headerSize = 8 + rows * 12
+    local text, offsets = {}, {}
+    local at = headerSize
+    for i = 0, rows - 1 do
+        local name = ffi.string(names[i])
+        offsets[i] = at
+        text[i + 1] = name .. "\0"
+        at = at + #name + 1
+    end
+    local blob = ffi.new("uint8_t[?]", at)
+    ffi.cast("uint32_t *", blob)[0] = rows
+    local blobWeights = ffi.cast("double *", blob + 8)
+    local blobOffsets = ffi.cast("uint32_t *", blob + 8 + rows * 8)
+    for i = 0, rows - 1 do
+        blobWeights[i] = weights[i]
+        blobOffsets[i] = offsets[i]
+    end
+    ffi.copy(blob + headerSize, table.concat(text), at - headerSize)
+    bridgeStoreCompiled("Game/" .. path, ffi.string(blob, at))
+end
+
+-- Fill names/weights from a compiled table; the names point into the cache, which stays mapped
+-- for the session
+local function readCompiledTable(data, names, weights, capacity)
+    local blob = ffi.cast("const uint8_t *", data)
+    local rows = ffi.cast("const uint32_t *", blob)[0]
+    local blobWeights = ffi.cast("const double *", blob + 8)
+    local blobOffsets = ffi.cast("const uint32_t *", blob + 8 + rows * 8)
+    for i = 0, math.min(rows, capacity) - 1 do
+        names[i] = ffi.cast("char *", blob + blobOffsets[i])
+        weights[i] = blobWeights[i]
+    end
+    return math.min(rows, capacity)
+end
+
 function loadAttrTable(tablesDir)
     -- List all .txt files
     local tableFiles = mx.ls(tablesDir, "txt")
     -- If there is a count.txt, make a table of it
     local countsTable = ffi.new("CountsTable[1]")
+    local capacity = ffi.sizeof(countsTable[0].counts) / ffi.sizeof("int")
     if(mxu.containsStr(tableFiles, "counts.txt")) then
-        mx.makeCountsTable(countsTable, tablesDir .. "/counts.txt")
+        local path = tablesDir .. "/counts.txt"
+        local data = compiledTable(path)
+        if data ~= nil then
+            local counts = ffi.new("double[?]", capacity)
+            countsTable[0].size = readCompiledTable(data, countsTable[0].attrNames, counts,
+                                                    capacity)
+            for i = 0, countsTable[0].size - 1 do
+                countsTable[0].counts[i] = counts[i]
+            end
+        else
+            mx.makeCountsTable(countsTable, path)
+            storeCompiledTable(path, countsTable[0].attrNames, countsTable[0].counts,
+                               countsTable[0].size)
+        end
     end
     local attrTable = ffi.new("AttrTable[1]", {NULL,NULL,NULL,0,0})
     for i = 0, tableFiles.size - 1 do
@@ -42,13 +105,71 @@ function loadAttrTable(tablesDir)
         local attrName = string.gsub(luaFilename, "[.]%w%w%w$", "")
         if(attrName ~= "counts") then
             local valueTable = ffi.new("ValueTable[1]", {NULL,NULL,0})
-            mx.makeValueTable(valueTable, tablesDir .. "/" .. luaFilename)
+            local path = tablesDir .. "/" .. luaFilename
+            local data = compiledTable(path)
+            if data ~= nil then
+                local values = valueTable[0]
+                values.size = readCompiledTable(data, values.valueNames, values.freqs, capacity)
+            else
+                mx.makeValueTable(valueTable, path)
+                storeCompiledTable(path, valueTable[0].valueNames, valueTable[0].freqs,
+                                   valueTable[0].size)
+            end
             mx.updateAttrTable(attrTable, attrName, valueTable, countsTable)
         end
     end
     return attrTable
 end
 
+-- Plain-Lua copy of an AttrTable, for the warm-start state (see merlinWarmState)
+function attrTableState(attrTable)
+    local attrs = attrTable[0]
+    local state = {}
+    for i = 0, attrs.size - 1 do
+        local values = attrs.valueTables[i]
+        local entry = {
+            name = ffi.string(attrs.attrNames[i]),
+            count = attrs.counts[i],
+            values = {},
+            freqs = {},
+        }
+        for j = 0, values.size - 1 do
+            entry.values[j + 1] = ffi.string(values.valueNames[j])
+            entry.freqs[j + 1] = values.freqs[j]
+        end
+        state[i + 1] = entry
+    end
+    return state
+end
+
+-- The AttrTable's strings live in Lua memory, kept alive for as long as the table is
+local attrTableStrings = setmetatable({}, { __mode = "k" })
+
+-- Rebuild an AttrTable saved by attrTableState, without reading the tables directory again
+function restoreAttrTable(state)
+    local attrTable = ffi.new("AttrTable[1]")
+    local strings = {}
+    local function cString(str)
+        local buf = ffi.new("char[?]", #str + 1, str)
+        strings[#strings + 1] = buf
+        return buf
+    end
+    local attrs = attrTable[0]
+    attrs.size = #state
+    for i, entry in ipairs(state) do
+        attrs.attrNames[i - 1] = cString(entry.name)
+        attrs.counts[i - 1] = entry.count
+        local values = attrs.valueTables[i - 1]
+        values.size = #entry.values
+        for j, name in ipairs(entry.values) do
+            values.valueNames[j - 1] = cString(name)
+            values.freqs[j - 1] = entry.freqs[j]
+        end
+    end
+    attrTableStrings[attrTable] = strings
+    return attrTable
+end
+
 function isPluralTrait(npcTable, attrName)
     return mx.numAttrTableValues(npcTable, attrName) > 1
 end
@@ -138,7 +259,8 @@ function giveBirth(mother)
     mx.setOccluder(child, false)
     local lhand = createHand(child, "leftHand", mx.seconds(), lhandSpatialBounds)
     local rhand = createHand(child, "rightHand", mx.seconds(), rhandSpatialBounds)
-    resolveNpcOverlaps(child, 4)
+    -- resolveNpcOverlaps disabled: GRYM handles physics/collision for visual NPCs
+    -- resolveNpcOverlaps(child, 4)
     -- Gender is random
     local gender = sampleAttrTable(npcNonTraitTable, "gender")
     mx.setSymbolAttr(child, "gender", gender)
@@ -275,9 +397,69 @@ function birthRootNpc(gender, socialClass, knowledge, rules, manSurnameSymbol, s
     return npc
 end
 
+function birthRootNpcsAt(spawnPoints, npcModelPaths)
+    -- A root NPC at every spawn point, cycling through the model paths; returns their symbols.
+    -- One birthRootNpcs call if this Merlin build has it, else birthRootNpc per NPC.
+    local genders, classes = {}, {}
+    for i = 1, #spawnPoints do
+        -- Randomize gender and social class for variety
+        genders[i] = (math.random() < 0.5) and "male" or "female"
+        classes[i] = (math.random() < 0.5) and "upper" or "common"
+    end
+    local function modelPathFor(i)
+        if #npcModelPaths == 0 then
+            return ""
+        end
+        return npcModelPaths[((i - 1) % #npcModelPaths) + 1]
+    end
+    local npcs = {}
+    if mxu.has("birthRootNpcs") then
+        local count = #spawnPoints
+        local specs = ffi.new("MerlinNpcSpec[?]", math.max(count, 1))
+        for i = 1, count do
+            local spec = specs[i - 1]
+            spec.pos.floats[0] = spawnPoints[i].x
+            spec.pos.floats[1] = spawnPoints[i].y
+            spec.pos.floats[2] = spawnPoints[i].z
+            -- The strings stay alive in genders/classes/npcModelPaths until the call returns
+            spec.gender = genders[i]
+            spec.socialClass = classes[i]
+            spec.modelPath = modelPathFor(i)
+        end
+        local out = ffi.new("uint64_t[?]", math.max(count, 1))
+        local birthTime = mx.makeSeconds(1720, 3, 0, 6, 0, 0)
+        local seed = math.random(0, 0x7fffffff)
+        count = mx.birthRootNpcs(npcTraitTable, npcNonTraitTable, specs, count, birthTime, "Npc",
+                                 seed, out)
+        for i = 1, count do
+            npcs[i] = out[i - 1]
+        end
+        return npcs
+    end
+    for i = 1, #spawnPoints do
+        local spawnPoint = spawnPoints[i]
+        local spawnPos = mxu.float3(spawnPoint.x, spawnPoint.y, spawnPoint.z)
+        local npc = birthRootNpc(genders[i], classes[i], {}, "Npc", nil, spawnPos,
+                                 modelPathFor(i))
+        
+        -- Get NPC size for positioning
+        local npcObb = mx.worldBounds(mx.attrSymbol(npc, "obb"))
+        local npcSize = mxu.float3(npcObb.floats[3], npcObb.floats[4], npcObb.floats[5])
+        local unitQuat = mxu.quat(0,0,0,1)
+        
+        -- Position NPC at spawn point
+        mx.setLocalBoundsAttr(npc, "obb", mx.composeBounds(spawnPos, npcSize, unitQuat))
+        -- resolveNpcOverlaps disabled: GRYM handles physics/collision for visual NPCs
+        -- resolveNpcOverlaps(npc, 4)
+        npcs[i] = npc
+    end
+    return npcs
+end
+
 function injectWaypointKnowledge(npc, waypointEntity, waypointObb)
     -- Inject knowledge about a waypoint into an NPC's mind
     -- Follows the pattern from Merlin/Game/Knowledge/Waypoint.mc
+    -- (fallback for Merlin builds without makeKnowledge, see makeWaypointKnowledge)
     mx.enterMind(npc)
     
     -- Create mental representation of the waypoint
@@ -286,11 +468,8 @@ function injectWaypointKnowledge(npc, waypointEntity, waypointObb)
     -- Get the OBB symbol from the waypoint entity's obb attribute
     local obbSymbol = mx.attrSymbol(waypointEntity, "obb")
     
-    -- Create bindings for ?waypoint and ?obb variables
-    local bindings = mxu.makeBindings({
-        "?waypoint", mwaypoint,
-        "?obb", obbSymbol
-    })
+    -- Create bindings for ?waypoint and ?obb variables (scratch: this runs per NPC per waypoint)
+    local bindings = mxu.tmpBindings("?waypoint", mwaypoint, "?obb", obbSymbol)
     
     -- Inject each pattern from Waypoint.mc
     mx.believe("{ ?waypoint isa [k waypoint] }", bindings)
@@ -299,22 +478,52 @@ function injectWaypointKnowledge(npc, waypointEntity, waypointObb)
     mx.enterAbsMind()
 end
 
-function createRootNpcs(spawnPoints, npcModelPaths, waypointPositions)
-    -- Create NPCs at spawn points from scene metadata
-    -- spawnPoints: table of {x, y, z} positions in meters
-    -- npcModelPaths: table of NPC model file paths for GRYM rendering (cycles through for multiple NPCs)
-    -- waypointPositions: table of {x, y, z} waypoint positions in meters
-    if spawnPoints == nil then
-        spawnPoints = {}
+-- Waypoint.mc's beliefs, as in injectWaypointKnowledge (kept here so the C strings stay alive)
+local waypointPatternStrs = { "{ ?waypoint isa [k waypoint] }", "{ ?waypoint obb ?obb }" }
+local waypointPatterns = ffi.new("const char *[2]", waypointPatternStrs)
+
+function makeWaypointKnowledge(waypointEntities)
+    -- The beliefs about every waypoint, parsed once for all minds. Returns nil if this Merlin
+    -- build has no shared knowledge; callers then fall back to injectWaypointKnowledge per mind.
+    if not mxu.has("makeKnowledge") or #waypointEntities == 0 then
+        return nil
     end
-    if npcModelPaths == nil then
-        npcModelPaths = {}
+    local rows = ffi.new("MerlinVarBindings[?]", #waypointEntities)
+    for j = 1, #waypointEntities do
+        local wp = waypointEntities[j]
+        local row = rows[j - 1]
+        row.varNames[0] = "?waypoint"
+        row.values[0] = wp.entity
+        row.varNames[1] = "?obb"
+        row.values[1] = mx.attrSymbol(wp.entity, "obb")
+        row.numBindings = 2
     end
-    if waypointPositions == nil then
-        waypointPositions = {}
+    return mx.makeKnowledge(waypointPatterns, #waypointPatternStrs, rows, #waypointEntities)
+end
+
+function giveWaypointKnowledge(npcs, waypointEntities)
+    -- Every NPC in npcs (a Lua array of symbols) learns about every waypoint
+    local knowledge = makeWaypointKnowledge(waypointEntities)
+    if knowledge == nil then
+        for i = 1, #npcs do
+            for j = 1, #waypointEntities do
+                local wp = waypointEntities[j]
+                injectWaypointKnowledge(npcs[i], wp.entity, wp.obb)
+            end
+        end
+        return
     end
-    
+    local minds = ffi.new("uint64_t[?]", math.max(#npcs, 1))
+    for i = 1, #npcs do
+        minds[i - 1] = npcs[i]
+    end
+    mx.believeKnowledge(knowledge, minds, #npcs)
+    mx.freeKnowledge(knowledge)
+end
+
+function createWaypoints(waypointPositions)
     -- Create waypoint entities in Merlin environment
+    -- Returns a table of {entity, obb}, and lists the symbols in waypointBuf for C++
     local waypointEntities = {}
     local birthTime = mx.makeSeconds(1720, 3, 0, 6, 0, 0)
     waypointBuf.count = 0
@@ -330,48 +539,59 @@ function createRootNpcs(spawnPoints, npcModelPaths, waypointPositions)
         
         table.insert(waypointEntities, {entity = waypoint, obb = wpObb})
         
-        -- Write waypoint symbol to shared buffer for C++ to read
-        waypointBuf.entries[waypointBuf.count].merlinId = waypoint
-        waypointBuf.count = waypointBuf.count + 1
-    end
-    
-    -- Loop through each spawn point and create a Merlin NPC
-    for i = 1, #spawnPoints do
-        local spawnPoint = spawnPoints[i]
-        local spawnPos = mxu.float3(spawnPoint.x, spawnPoint.y, spawnPoint.z)
-        
-        -- Cycle through model paths (modulo to wrap around)
-        local modelPath = ""
-        if #npcModelPaths > 0 then
-            local modelIndex = ((i - 1) % #npcModelPaths) + 1  -- Lua 1-based indexing
-            modelPath = npcModelPaths[modelIndex]
-        end
-        
-        -- Create a single NPC at this spawn point
-        -- Randomize gender and social class for variety
-        local gender = (math.random() < 0.5) and "male" or "female"
-        local socialClass = (math.random() < 0.5) and "upper" or "common"
-        local npc = birthRootNpc(gender, socialClass, {}, "Npc", nil, spawnPos, modelPath)
-        
-        -- Get NPC size for positioning
-        local npcObb = mx.worldBounds(mx.attrSymbol(npc, "obb"))
-        local npcSize = mxu.float3(npcObb.floats[3], npcObb.floats[4], npcObb.floats[5])
-        local unitQuat = mxu.quat(0,0,0,1)
-        
-        -- Position NPC at spawn point
-        mx.setLocalBoundsAttr(npc, "obb", mx.composeBounds(spawnPos, npcSize, unitQuat))
-        -- resolveNpcOverlaps disabled: GRYM handles physics/collision for visual NPCs
-        -- resolveNpcOverlaps(npc, 4)
-        
-        -- Inject waypoint knowledge into this NPC's mind
-        for j = 1, #waypointEntities do
-            local wp = waypointEntities[j]
-            injectWaypointKnowledge(npc, wp.entity, wp.obb)
+        -- Write waypoint symbol to shared buffer for C++ to read (C++ sizes it for every waypoint)
+        if waypointBuf.count < waypointBuf.capacity then
+            waypointBuf.entries[waypointBuf.count].merlinId = waypoint
+            waypointBuf.count = waypointBuf.count + 1
         end
     end
+    return waypointEntities
+end
+
+function createRootNpcs(spawnPoints, npcModelPaths, waypointPositions)
+    -- Create NPCs at spawn points from scene metadata
+    -- spawnPoints: table of {x, y, z} positions in meters
+    -- npcModelPaths: table of NPC model file paths for GRYM rendering (cycles through for multiple NPCs)
+    -- waypointPositions: table of {x, y, z} waypoint positions in meters
+    if spawnPoints == nil then
+        spawnPoints = {}
+    end
+    if npcModelPaths == nil then
+        npcModelPaths = {}
+    end
+    if waypointPositions == nil then
+        waypointPositions = {}
+    end
+    
+    local waypointEntities = createWaypoints(waypointPositions)
+    
+    -- A Merlin NPC at each spawn point
+    local npcs = birthRootNpcsAt(spawnPoints, npcModelPaths)
+    
+    -- Every NPC knows the waypoints: one shared set of beliefs, not one parse per NPC per waypoint
+    giveWaypointKnowledge(npcs, waypointEntities)
     
     -- Enable all NPCs to see the environment (call once after all NPCs created)
     mx.allPerceive()
     
     mx.enterAbsMind()
 end
+
+function adoptCheckpointNpcs(npcModelPaths, waypointPositions)
+    -- Prepare an NPC population restored from a history checkpoint for the game:
+    -- NPCs born during the fast-forward have no GRYM model yet, and nobody knows the scene's waypoints
+    local waypointEntities = createWaypoints(waypointPositions)
+    local modelIndex = 0
+    local npcs = {}
+    for _, npc in mxu.rosterIter() do
+        local modelPathAttr = mx.attrSymbol(npc, "modelPath")
+        if #npcModelPaths > 0 and (modelPathAttr == nil or modelPathAttr == 0) then
+            mx.setSymbolAttr(npc, "modelPath", mx.hstrSymbol(npcModelPaths[modelIndex % #npcModelPaths + 1]))
+            modelIndex = modelIndex + 1
+        end
+        npcs[#npcs + 1] = npc
+    end
+    giveWaypointKnowledge(npcs, waypointEntities)
+    mx.allPerceive()
+    mx.enterAbsMind()
+end
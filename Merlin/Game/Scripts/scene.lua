@@ -15,23 +15,31 @@ function printManors()
     end
 end
 
+-- The scene layout (hand-placed spaces, buildings, props etc), streamed in around the player
+-- (see scenelayout.lua). A compiled .mlb file can be named instead of the layout itself.
+sceneLayoutPath = "Env/layout.dat"
+kindToSystemTable = {
+    ["space"]="space",
+    ["structure"]="struct",
+    ["collection stack"]="stack",
+    ["structurePart"]="part",
+    ["*"]="prop"
+}
+
 function loadScene()
-    -- Load the scene layout (hand-placed spaces, buildings, props etc)
-    kindToSystemTable = {
-        ["space"]="space",
-        ["structure"]="struct",
-        ["collection stack"]="stack",
-        ["structurePart"]="part",
-        ["*"]="prop"
-    }
-
-    -- Create a world directly from the terrain file
+    -- Create a world directly from the terrain file (or, with a Merlin build that exports
+    -- useHeightfield, from the heightfield MerlinLua maps, see MerlinLua::SetHeightfield)
     -- 100m wide sectors (in meters)
     mx.makeWorldFromTerrain("Env/island.ter", 100)
-    -- Load the scene layout (objects, buildings, spaces, set dressing etc)
-    --mxu.loadSceneLayout("Env/layout.dat", kindToSystemTable)
+    -- Open the scene layout (objects, buildings, spaces, set dressing etc); its sectors are made
+    -- as the player comes near them (streamSceneLayout, from merlinCreatePlayer on)
+    openSceneLayout(sceneLayoutPath, kindToSystemTable)
+
+    gatherSceneEntities()
+end
 
-    -- Gather things that we use in the setup
+function gatherSceneEntities()
+    -- Gather things that we use in the setup (also after a warm start, which skips loadScene)
     spaces = mx.findEntitiesOfKind("space", "space")
     manors = mx.findEntitiesOfKind("struct", "manor")
     cottages = mx.findEntitiesOfKind("struct", "cottage")
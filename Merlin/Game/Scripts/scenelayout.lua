@@ -0,0 +1,483 @@
+-- Compiled scene layout: the objects of a layout.dat exported from the editor, in a compact
+-- binary indexed by ground sector, and streamed into Merlin around the player instead of being
+-- loaded whole. A town-sized layout then costs nothing at start-up beyond the sectors near where
+-- the player starts, and the rest is made a few sectors per frame as the player approaches.
+--
+-- The binary is the layout's compiled form in the data cache (see MerlinLua::SetDataCache), so a
+-- layout is only parsed when it changes, and is read in place from the cache's memory mapping.
+-- It can also be compiled ahead of time with compilelayout.lua and loaded from its .mlb file.
+--
+-- File layout: a SceneLayoutHeader, then columns x rows SceneLayoutSectors (row-major, from
+-- originX/originZ), then the objects, then the string table. Each sector's objects are
+-- consecutive: every root object placed in the sector, each followed by its descendants, so a
+-- sector is made in one makeLayoutEntities call. Object kinds and names are offsets into the
+-- string table, whose first byte is the empty string.
+
+ffi.cdef[[
+    typedef struct {
+        char magic[4];        // "MLAY"
+        uint32_t version;
+        float sectorSize;     // meters
+        float originX;        // ground position of sector (0, 0)'s corner
+        float originZ;
+        int32_t columns;      // sectors along x
+        int32_t rows;         // sectors along z
+        uint32_t numObjects;
+        uint32_t stringsSize; // bytes
+        float maxReach;       // largest reach of any sector
+    } SceneLayoutHeader;
+
+    typedef struct {
+        uint32_t first;       // index of the sector's first object
+        uint32_t count;
+        float reach;          // how far its objects extend past the sector, in meters
+    } SceneLayoutSector;
+
+    // Same layout as MerlinLayoutObject in mx.lua, which the objects are passed to Merlin as
+    typedef struct {
+        float bounds[10];     // MerlinObb: position, radii, orientation
+        uint32_t kind;
+        uint32_t name;
+        int32_t parent;       // index relative to the sector's first object, -1 for a root
+    } SceneLayoutObject;
+]]
+
+local LAYOUT_MAGIC = "MLAY"
+local LAYOUT_VERSION = 1
+local LAYOUT_SECTOR_SIZE = 100   -- meters, as the world's sectors (see loadScene)
+local LAYOUT_MAX_SECTORS = 65536 -- larger layouts get larger sectors
+local LAYOUT_STREAM_RANGE = 250  -- meters from the player a sector's objects are made within
+
+local headerSize = ffi.sizeof("SceneLayoutHeader")
+local sectorSize = ffi.sizeof("SceneLayoutSector")
+local objectSize = ffi.sizeof("SceneLayoutObject")
+
+-- Parse layout.dat text into a list of objects (positions etc still in the editor's centimeters
+-- and axes), in file order. Each object remembers the CLASS block it was in, since parents are
+-- named and names repeat across blocks ("the bedroom").
+local function parseLayoutText(text)
+    local objects = {}
+    local block = 0
+    local object = nil
+    local function triple(line)
+        local x, y, z = string.match(line, "X=(%S+)%s+Y=(%S+)%s+Z=(%S+)")
+        return { tonumber(x) or 0, tonumber(y) or 0, tonumber(z) or 0 }
+    end
+    for line in string.gmatch(text, "[^\r\n]+") do
+        local key, value = string.match(line, "^%s*(%S+)%s*(.-)%s*$")
+        if key == "CLASS" then
+            block = block + 1
+        elseif key == "UTYPE" then
+            object = { block = block, kind = "", name = "", pos = { 0, 0, 0 }, radii = { 0, 0, 0 },
+                       orient = { 0, 0, 0, 1 } }
+        elseif object == nil then
+            -- outside an object
+        elseif key == "MKIND" then
+            object.kind = value
+        elseif key == "MNAME" then
+            object.name = value
+        elseif key == "MPARENT" then
+            object.parentName = value
+        elseif key == "MPOS" then
+            object.pos = triple(value)
+        elseif key == "MRADII" then
+            object.radii = triple(value)
+        elseif key == "MORIENT" then
+            local x, y, z, w = string.match(value, "X=(%S+)%s+Y=(%S+)%s+Z=(%S+)%s+W=(%S+)")
+            object.orient = { tonumber(x) or 0, tonumber(y) or 0, tonumber(z) or 0,
+                              tonumber(w) or 1 }
+        elseif key == "END-MOBJ" then
+            objects[#objects + 1] = object
+            object = nil
+        end
+    end
+    return objects
+end
+
+-- Compile layout.dat text into the binary form. Returns the binary as a Lua string and a table
+-- of counts (objects, roots, sectors used, objects dropped for a missing parent).
+function compileSceneLayout(text)
+    local objects = parseLayoutText(text)
+
+    -- Resolve parents by name, in the object's own CLASS block first
+    local byBlockName, byName = {}, {}
+    for _, object in ipairs(objects) do
+        local key = object.block .. "\n" .. object.name
+        byBlockName[key] = byBlockName[key] or object
+        byName[object.name] = byName[object.name] or object
+        object.children = {}
+    end
+    local roots = {}
+    for _, object in ipairs(objects) do
+        if object.parentName == nil or object.parentName == "" then
+            roots[#roots + 1] = object
+        else
+            object.parent = byBlockName[object.block .. "\n" .. object.parentName]
+                            or byName[object.parentName]
+            if object.parent == object then
+                object.parent = nil
+            end
+            if object.parent then
+                table.insert(object.parent.children, object)
+            end
+        end
+    end
+
+    -- Editor (centimeters, z up) to game axes (meters, y up). Swapping y and z mirrors the
+    -- axes, so rotations turn the other way. A sub-entity's position is a fraction of its
+    -- parent's radii, so it is only reordered.
+    for _, object in ipairs(objects) do
+        local p, r, q = object.pos, object.radii, object.orient
+        local scale = object.parentName and object.parentName ~= "" and 1 or 0.01
+        object.bounds = { p[1] * scale, p[3] * scale, p[2] * scale,
+                          r[1] * 0.01, r[3] * 0.01, r[2] * 0.01,
+                          -q[1], -q[3], -q[2], q[4] }
+    end
+
+    -- Sector grid over the roots' ground positions
+    local size = LAYOUT_SECTOR_SIZE
+    local minX, minZ, maxX, maxZ = math.huge, math.huge, -math.huge, -math.huge
+    for _, root in ipairs(roots) do
+        minX = math.min(minX, root.bounds[1])
+        maxX = math.max(maxX, root.bounds[1])
+        minZ = math.min(minZ, root.bounds[3])
+        maxZ = math.max(maxZ, root.bounds[3])
+    end
+    local originX, originZ, columns, rows = 0, 0, 0, 0
+    if #roots > 0 then
+        repeat
+            originX = math.floor(minX / size) * size
+            originZ = math.floor(minZ / size) * size
+            columns = math.floor((maxX - originX) / size) + 1
+            rows = math.floor((maxZ - originZ) / size) + 1
+            if columns * rows > LAYOUT_MAX_SECTORS then
+                size = size * 2
+            end
+        until columns * rows <= LAYOUT_MAX_SECTORS
+    end
+
+    local sectorRoots = {}
+    for _, root in ipairs(roots) do
+        local column = math.floor((root.bounds[1] - originX) / size)
+        local row = math.floor((root.bounds[3] - originZ) / size)
+        local index = row * columns + column
+        sectorRoots[index] = sectorRoots[index] or {}
+        table.insert(sectorRoots[index], root)
+    end
+
+    -- Strings, each stored once
+    local strings, stringOffsets, stringsSize = { "\0" }, { [""] = 0 }, 1
+    local function intern(str)
+        local offset = stringOffsets[str]
+        if offset == nil then
+            offset = stringsSize
+            stringOffsets[str] = offset
+            strings[#strings + 1] = str .. "\0"
+            stringsSize = stringsSize + #str + 1
+        end
+        return offset
+    end
+
+    -- Order the objects by sector, each root followed by its descendants. An object whose parent
+    -- is missing (or which is its own ancestor) is never reached, and is dropped.
+    local ordered, sectorFirst, sectorCount, sectorReach = {}, {}, {}, {}
+    local usedSectors, maxReach = 0, 0
+    for index = 0, columns * rows - 1 do
+        sectorFirst[index] = #ordered
+        local reach = 0
+        local function add(object, parentIndex)
+            if object.index then
+                return
+            end
+            object.index = #ordered - sectorFirst[index]
+            object.parentIndex = parentIndex
+            ordered[#ordered + 1] = object
+            for _, child in ipairs(object.children) do
+                add(child, object.index)
+            end
+        end
+        for _, root in ipairs(sectorRoots[index] or {}) do
+            add(root, -1)
+            local r = root.bounds
+            reach = math.max(reach, math.sqrt(r[4] * r[4] + r[5] * r[5] + r[6] * r[6]))
+        end
+        sectorCount[index] = #ordered - sectorFirst[index]
+        sectorReach[index] = reach
+        maxReach = math.max(maxReach, reach)
+        if sectorCount[index] > 0 then
+            usedSectors = usedSectors + 1
+        end
+    end
+
+    local objectsAt = headerSize + columns * rows * sectorSize
+    local stringsAt = objectsAt + #ordered * objectSize
+    for _, object in ipairs(ordered) do
+        object.kindOffset = intern(object.kind)
+        object.nameOffset = intern(object.name)
+    end
+    local blob = ffi.new("uint8_t[?]", stringsAt + stringsSize)
+
+    local header = ffi.cast("SceneLayoutHeader *", blob)
+    ffi.copy(header.magic, LAYOUT_MAGIC, 4)
+    header.version = LAYOUT_VERSION
+    header.sectorSize = size
+    header.originX = originX
+    header.originZ = originZ
+    header.columns = columns
+    header.rows = rows
+    header.numObjects = #ordered
+    header.stringsSize = stringsSize
+    header.maxReach = maxReach
+
+    local sectors = ffi.cast("SceneLayoutSector *", blob + headerSize)
+    for index = 0, columns * rows - 1 do
+        sectors[index].first = sectorFirst[index]
+        sectors[index].count = sectorCount[index]
+        sectors[index].reach = sectorReach[index]
+    end
+    local out = ffi.cast("SceneLayoutObject *", blob + objectsAt)
+    for i, object in ipairs(ordered) do
+        local entry = out[i - 1]
+        for j = 1, 10 do
+            entry.bounds[j - 1] = object.bounds[j]
+        end
+        entry.kind = object.kindOffset
+        entry.name = object.nameOffset
+        entry.parent = object.parentIndex
+    end
+    ffi.copy(blob + stringsAt, table.concat(strings), stringsSize)
+
+    return ffi.string(blob, stringsAt + stringsSize), {
+        objects = #ordered,
+        roots = #roots,
+        dropped = #objects - #ordered,
+        sectors = columns * rows,
+        usedSectors = usedSectors,
+        sectorSize = size,
+    }
+end
+
+-- Compiling runs once per layout change. Its traces would stay behind for the rest of the
+-- session, for the paced collector to walk every cycle, so it is left to the interpreter.
+jit.off(parseLayoutText, true)
+jit.off(compileSceneLayout, true)
+
+-- Check a compiled layout of size bytes at data (a pointer or a Lua string). Returns the header,
+-- sectors, objects and strings, or nil if it isn't a layout this version can read.
+local function readCompiledLayout(data, size)
+    local blob = ffi.cast("const uint8_t *", data)
+    if size < headerSize then
+        return nil
+    end
+    local header = ffi.cast("const SceneLayoutHeader *", blob)
+    local numSectors = header.columns * header.rows
+    if ffi.string(header.magic, 4) ~= LAYOUT_MAGIC or header.version ~= LAYOUT_VERSION
+       or header.columns < 0 or header.rows < 0 or header.stringsSize < 1
+       or headerSize + numSectors * sectorSize + header.numObjects * objectSize
+          + header.stringsSize ~= size then
+        return nil
+    end
+    local sectors = ffi.cast("const SceneLayoutSector *", blob + headerSize)
+    local objects = ffi.cast("const SceneLayoutObject *",
+                             blob + headerSize + numSectors * sectorSize)
+    local strings = ffi.cast("const char *", blob + size - header.stringsSize)
+    if strings[header.stringsSize - 1] ~= 0 then
+        return nil
+    end
+    for index = 0, numSectors - 1 do
+        local sector = sectors[index]
+        if sector.first > header.numObjects or sector.count > header.numObjects - sector.first then
+            return nil
+        end
+    end
+    return header, sectors, objects, strings
+end
+
+-- The layout being streamed (nil until openSceneLayout)
+local layout = nil
+
+-- Open the layout at path (relative to projectPath; a .mlb file is a precompiled one), ready for
+-- streamSceneLayout. kindToSystemTable maps layout kinds to the Merlin systems their entities go
+-- in, as for mxu.loadSceneLayout. loadedSectors (optional) lists the sectors whose entities
+-- Merlin already has, after a warm start. Returns true if the layout can be streamed.
+function openSceneLayout(path, kindToSystemTable, loadedSectors)
+    layout = nil
+    if not mxu.has("makeLayoutEntities") then
+        print("Scene layout " .. path .. " not loaded: Merlin doesn't export makeLayoutEntities")
+        return false
+    end
+    local startMs = bridgeNowMs()
+    local data, size, source = nil, 0, "compiled cache"
+    if string.match(path, "%.mlb$") then
+        local file = io.open(projectPath .. "/" .. path, "rb")
+        if file then
+            data = file:read("*a")
+            size = #data
+            file:close()
+        end
+        source = "precompiled"
+    elseif bridgeCompiledData ~= nil then
+        data, size = bridgeCompiledData("Game/" .. path)
+    end
+    if data == nil or (source == "compiled cache" and readCompiledLayout(data, size) == nil) then
+        local file = io.open(projectPath .. "/" .. path, "r")
+        if file == nil then
+            print("ERROR: Can't read scene layout " .. path)
+            return false
+        end
+        local text = file:read("*a")
+        file:close()
+        local counts
+        data, counts = compileSceneLayout(text)
+        size = #data
+        source = "compiled"
+        if counts.dropped > 0 then
+            print(string.format("WARNING: Scene layout %s: %d objects dropped (parent not found)",
+                                path, counts.dropped))
+        end
+        if bridgeStoreCompiled ~= nil then
+            bridgeStoreCompiled("Game/" .. path, data)
+        end
+    end
+    local header, sectors, objects, strings = readCompiledLayout(data, size)
+    if header == nil then
+        print("ERROR: Scene layout " .. path .. " is not a compiled layout this build can read")
+        return false
+    end
+
+    -- Kinds are tried in table order, so the catch-all "*" goes last
+    local kinds = {}
+    for kind in pairs(kindToSystemTable) do
+        kinds[#kinds + 1] = kind
+    end
+    table.sort(kinds, function(a, b)
+        if (a == "*") ~= (b == "*") then
+            return b == "*"
+        end
+        return a < b
+    end)
+    local anchors = {} -- the Lua strings kindTable points into
+    local kindTable = ffi.new("const char *[?]", #kinds * 2)
+    for i, kind in ipairs(kinds) do
+        anchors[#anchors + 1] = kind
+        anchors[#anchors + 1] = kindToSystemTable[kind]
+        kindTable[i * 2 - 2] = kind
+        kindTable[i * 2 - 1] = kindToSystemTable[kind]
+    end
+
+    local numSectors = header.columns * header.rows
+    local largest, remaining = 0, 0
+    for index = 0, numSectors - 1 do
+        largest = math.max(largest, sectors[index].count)
+        if sectors[index].count > 0 then
+            remaining = remaining + 1
+        end
+    end
+    layout = {
+        path = path,
+        data = data, -- keeps a Lua string alive; the data cache stays mapped for the session
+        header = header,
+        sectors = sectors,
+        objects = objects,
+        strings = strings,
+        kindTable = kindTable,
+        kindTableSize = #kinds,
+        anchors = anchors,
+        entities = ffi.new("uint64_t[?]", math.max(largest, 1)),
+        loaded = {},
+        remaining = remaining,
+        queue = {},
+        cell = nil,
+    }
+    for _, index in ipairs(loadedSectors or {}) do
+        if not layout.loaded[index] and index >= 0 and index < numSectors
+           and sectors[index].count > 0 then
+            layout.loaded[index] = true
+            layout.remaining = layout.remaining - 1
+        end
+    end
+    print(string.format("Scene layout %s: %d objects in %d sectors of %dm (%s, %.1f ms)",
+                        path, header.numObjects, remaining, header.sectorSize, source,
+                        bridgeNowMs() - startMs))
+    return true
+end
+
+-- The sectors made so far, for merlinWarmState
+function loadedSceneSectors()
+    local indices = {}
+    if layout then
+        for index in pairs(layout.loaded) do
+            indices[#indices + 1] = index
+        end
+        table.sort(indices)
+    end
+    return indices
+end
+
+-- Make the entities of the unloaded sectors within LAYOUT_STREAM_RANGE of the player at ground
+-- position (x, z), nearest first, at most maxSectors of them (nil = all). The sectors in range
+-- are only looked for when the player enters another sector, so most calls return straight
+-- away. Entities are kept once made. Returns the number of sectors made.
+function streamSceneLayout(x, z, maxSectors)
+    if layout == nil or layout.remaining == 0 then
+        return 0
+    end
+    local header = layout.header
+    local size = header.sectorSize
+    local column = math.floor((x - header.originX) / size)
+    local row = math.floor((z - header.originZ) / size)
+    local cell = column * 1048576 + row
+    local queue = layout.queue
+    if cell == layout.cell and #queue == 0 then
+        return 0
+    end
+
+    if cell ~= layout.cell then
+        layout.cell = cell
+        -- Unloaded sectors close enough for their objects to reach into range, farthest first
+        local range = LAYOUT_STREAM_RANGE + header.maxReach
+        local c0 = math.max(math.floor((x - range - header.originX) / size), 0)
+        local c1 = math.min(math.floor((x + range - header.originX) / size), header.columns - 1)
+        local r0 = math.max(math.floor((z - range - header.originZ) / size), 0)
+        local r1 = math.min(math.floor((z + range - header.originZ) / size), header.rows - 1)
+        local distances = {}
+        queue = {}
+        for r = r0, r1 do
+            for c = c0, c1 do
+                local index = r * header.columns + c
+                local sector = layout.sectors[index]
+                if sector.count > 0 and not layout.loaded[index] then
+                    local minX = header.originX + c * size
+                    local minZ = header.originZ + r * size
+                    local dx = math.max(minX - x, 0, x - (minX + size))
+                    local dz = math.max(minZ - z, 0, z - (minZ + size))
+                    local distance = math.sqrt(dx * dx + dz * dz) - sector.reach
+                    if distance <= LAYOUT_STREAM_RANGE then
+                        queue[#queue + 1] = index
+                        distances[index] = distance
+                    end
+                end
+            end
+        end
+        table.sort(queue, function(a, b) return distances[a] > distances[b] end)
+        layout.queue = queue
+    end
+
+    local made = 0
+    while #queue > 0 and (maxSectors == nil or made < maxSectors) do
+        local index = table.remove(queue)
+        if not layout.loaded[index] then
+            local sector = layout.sectors[index]
+            local objects = ffi.cast("const MerlinLayoutObject *", layout.objects + sector.first)
+            mx.makeLayoutEntities(objects, sector.count, layout.strings, layout.kindTable,
+                                  layout.kindTableSize, layout.entities)
+            layout.loaded[index] = true
+            layout.remaining = layout.remaining - 1
+            made = made + 1
+        end
+    end
+    if made > 0 then
+        gatherSceneEntities()
+    end
+    return made
+end
@@ -14,43 +14,525 @@ function endSim()
     mx.stop()
 end
 
+-- ---------------------------------------------------------------------------
+-- Sim-time events. The realtime clock is simClock.seconds, sim seconds since midnight of the
+-- session's first day; simHour/simMin/simSec are derived from it. Time-of-day events are timers
+-- on simTimers (see timerwheel.lua), which the clock advances. Per-NPC work an event starts is
+-- spread over the following ticks (spreadOverNpcs), so crossing an hour isn't an O(N) frame.
+-- ---------------------------------------------------------------------------
+
+local SECONDS_PER_DAY = 24 * 3600
+local NPC_SPREAD_TICKS = 10 -- ticks an event's per-NPC work is spread over (1 s at 10 Hz)
+
+local npcJobs = {} -- pending spreadOverNpcs work, oldest first
+
+-- Call perNpc(npc) for every NPC in the roster, a share of them per tick over the next ticks
+function spreadOverNpcs(perNpc, ticks)
+    -- Copied: the roster can change before the job finishes
+    local roster, rosterSize = mxu.roster()
+    local npcs = ffi.new("uint64_t[?]", math.max(rosterSize, 1))
+    ffi.copy(npcs, roster, rosterSize * ffi.sizeof("uint64_t"))
+    npcJobs[#npcJobs + 1] = { npcs = npcs, size = rosterSize, cursor = 0,
+                              ticksLeft = math.max(1, ticks or NPC_SPREAD_TICKS), perNpc = perNpc }
+end
+
+local function runNpcJobs()
+    local remaining = {}
+    for _, job in ipairs(npcJobs) do
+        local share = math.ceil((job.size - job.cursor) / job.ticksLeft)
+        for i = job.cursor, job.cursor + share - 1 do
+            job.perNpc(job.npcs[i])
+        end
+        job.cursor = job.cursor + share
+        job.ticksLeft = job.ticksLeft - 1
+        if job.cursor < job.size then
+            remaining[#remaining + 1] = job
+        end
+    end
+    npcJobs = remaining
+end
+
 function setNpcAlertness(alertness)
-    for _, npc in mxu.iter(mx.npcs()) do
+    spreadOverNpcs(function(npc)
         mx.setSymbolAttr(npc, "alertness", alertness)
         --mx.logDebug(mxu.toLuaString(npc) .. " becomes " .. mxu.toLuaString(alertness))
+    end)
+end
+
+-- Call handler(at) every sim day at hour:minute, from the next time the clock reaches it
+function atTimeOfDay(hour, minute, handler)
+    local now = simTimers.now
+    local first = now - now % SECONDS_PER_DAY + hour * 3600 + minute * 60
+    if first <= now then
+        first = first + SECONDS_PER_DAY
     end
+    return simTimers:every(first, SECONDS_PER_DAY, handler)
 end
 
-function advanceRealtimeSim(luaDt)
-    -- Realtime simulation: advance time by actual frame delta and run one sim step per frame
-    -- Since this function calls mx.sim(), which in turn can call Lua functions, we should disable JITTing this function
-    jit.off()
+local function scheduleTimeOfDayEvents()
+    atTimeOfDay(20, 0, function() setNpcAlertness(msym.sleepy) end)
+end
 
-    -- Advance simulation time by actual frame delta
-    simSec = simSec + luaDt
-    if simSec >= 60 then
-        simSec = simSec - 60
-        simMin = simMin + 1
+-- Set the time of day and restart the timers from it (at start-up, warm start and checkpoints)
+function setSimClock(hour, minute, second)
+    simClock.seconds = hour * 3600 + minute * 60 + second
+    simTimers = TimerWheel.new(simClock.seconds)
+    npcJobs = {}
+    simHour, simMin, simSec = hour, minute, second
+    scheduleTimeOfDayEvents()
+end
+
+-- State of the current (possibly suspended) cycle when running frame-budgeted
+simBudget = {
+    minds = nil,       -- uint64_t[] minds due in the cycle in progress (LOD-filtered roster)
+    numMinds = 0,
+    cursor = 0,        -- next mind to process
+    msPerMind = 0.5,   -- running estimate of deliberation cost per mind (starts pessimistic)
+    debtMs = 0,        -- whole-cycle fallback: time owed from cycles that blew the budget
+}
+
+-- Simulation LOD: per-NPC tiers pushed from C++ (MerlinLua::AddSimTier) decide how often each
+-- mind deliberates. NPCs the game hasn't assigned a tier simulate at full rate.
+simLod = {
+    intervals = {1, 4, 20}, -- ticks between deliberations for tier 0 (full), 1 (ring), 2 (background)
+    version = nil,          -- simTierBuf version tierByKey was built from
+    tierByKey = {},         -- tostring(npc) -> tier
+    tierByIndex = nil,      -- uint8_t[] tier per roster position, from tierByKey
+    indexedRoster = nil,    -- roster version tierByIndex was built for (nil: rebuild)
+    active = false,         -- tiers present and Merlin can simulate a subset of minds
+}
+
+function setSimLodIntervals(ringInterval, backgroundInterval)
+    simLod.intervals[2] = math.max(1, ringInterval)
+    simLod.intervals[3] = math.max(1, backgroundInterval)
+end
+
+-- Tiers only matter when Merlin can simulate a subset of minds; the C++ side only bumps the
+-- version when the game's tiers actually change
+local function refreshSimTiers()
+    if not simCanSlice or simTierBuf == nil or simTierBuf.version == simLod.version then
+        return
+    end
+    simLod.version = simTierBuf.version
+    simLod.tierByKey = {}
+    for i = 0, simTierBuf.count - 1 do
+        local entry = simTierBuf.entries[i]
+        simLod.tierByKey[tostring(entry.merlinId)] = entry.tier
     end
-    
-    if simMin >= 60 then
-        simMin = simMin - 60
-        simHour = simHour + 1
-        if simHour == 20 then
-            setNpcAlertness(msym.sleepy)
+    simLod.indexedRoster = nil
+    simLod.active = simTierBuf.count > 0
+end
+
+-- Lays the tiers out by roster position, so the per-tick due check needs no string keys. Only
+-- redone when the tiers or the roster change.
+local function indexSimTiers(roster, rosterSize, rosterVersion)
+    if rosterVersion ~= nil and rosterVersion == simLod.indexedRoster then
+        return
+    end
+    local tierByIndex = ffi.new("uint8_t[?]", math.max(rosterSize, 1))
+    for i = 0, rosterSize - 1 do
+        tierByIndex[i] = simLod.tierByKey[tostring(roster[i])] or 0
+    end
+    simLod.tierByIndex = tierByIndex
+    simLod.indexedRoster = rosterVersion
+end
+
+local function isMindDue(rosterIndex)
+    local tier = simLod.tierByIndex[rosterIndex]
+    local interval = simLod.intervals[tier + 1] or 1
+    -- Offset by roster position so a tier's minds are spread evenly across its interval
+    return (simClock.tick + rosterIndex) % interval == 0
+end
+
+-- AI profiler (MerlinLua::SetAiProfiling). Every aiProfileBuf.intervalMs one cycle is run a mind
+-- at a time and each mind is timed. When it ends, the rules that fired in the most expensive
+-- minds are read back and each mind's time is split evenly between its rules, so the behaviour
+-- rules that dominate sim time stand out. All other cycles run unsampled.
+local AI_PROFILE_RULE_MINDS = 256 -- most expensive minds whose firing rules are read back
+aiProfile = {
+    nextSampleMs = 0,
+    sampling = false, -- the cycle in progress is timed per mind
+    mindMs = nil,     -- double[] time per mind in the sampled cycle, indexed like simBudget.minds
+    ruleNames = {},   -- tostring(rule symbol) -> name, kept across samples
+}
+
+local function isAiSampleDue()
+    if aiProfileBuf == nil or aiProfileBuf.intervalMs <= 0 then
+        return false
+    end
+    local nowMs = bridgeNowMs()
+    if nowMs < aiProfile.nextSampleMs then
+        return false
+    end
+    aiProfile.nextSampleMs = nowMs + aiProfileBuf.intervalMs
+    return true
+end
+
+-- Indices of the (at most) count most expensive minds, most expensive first
+local function mostExpensiveMinds(mindMs, numMinds, count)
+    local top = {}
+    for i = 0, numMinds - 1 do
+        local ms = mindMs[i]
+        if #top < count or ms > mindMs[top[#top]] then
+            local j = #top < count and #top + 1 or #top
+            while j > 1 and mindMs[top[j - 1]] < ms do
+                top[j] = top[j - 1]
+                j = j - 1
+            end
+            top[j] = i
+        end
+    end
+    return top
+end
+
+local function copyName(dst, name)
+    local len = math.min(#name, ffi.C.AI_PROFILE_NAME_MAX - 1)
+    ffi.copy(dst, name, len)
+    dst[len] = 0
+end
+
+-- Fill aiProfileBuf from the cycle that just ended. mindMs is nil when Merlin can't run a
+-- cycle in slices: then only rule firing counts are gathered, from the first minds.
+local function collectAiProfile(minds, numMinds, mindMs, endCycleMs)
+    local startMs = bridgeNowMs()
+    local buf = aiProfileBuf
+    local order, mindsMs = {}, 0
+    if mindMs ~= nil then
+        order = mostExpensiveMinds(mindMs, numMinds, AI_PROFILE_RULE_MINDS)
+        for i = 0, numMinds - 1 do
+            mindsMs = mindsMs + mindMs[i]
         end
-        if simHour >= 24 then
-            simHour = 0
-            simMin = 0
-            simSec = 0
+    else
+        for i = 0, math.min(numMinds, AI_PROFILE_RULE_MINDS) - 1 do
+            order[i + 1] = i
         end
     end
 
-    -- Set the current time in Merlin
+    local rules, attributedMs = {}, 0 -- name -> { name, fires, ms }
+    for rank, i in ipairs(order) do
+        local mind = minds[i]
+        local ms = mindMs ~= nil and mindMs[i] or 0
+        attributedMs = attributedMs + ms
+        local firing = mx.firingRuleNames(mind)
+        for r = 0, firing.size - 1 do
+            local key = tostring(firing.buffer[r])
+            local name = aiProfile.ruleNames[key]
+            if name == nil then
+                name = mxu.toLuaString(firing.buffer[r])
+                aiProfile.ruleNames[key] = name
+            end
+            local rule = rules[name]
+            if rule == nil then
+                rule = { name = name, fires = 0, ms = 0 }
+                rules[name] = rule
+            end
+            rule.fires = rule.fires + 1
+            rule.ms = rule.ms + ms / firing.size
+        end
+
+        if rank <= ffi.C.AI_PROFILE_MAX_MINDS then
+            local entry = buf.topMinds[rank - 1]
+            local nameSymbol = mx.attrSymbol(mind, "name")
+            entry.merlinId = mind
+            copyName(entry.name, mxu.toLuaString(nameSymbol ~= 0 and nameSymbol or mind))
+            entry.ms = ms
+            entry.firingRules = firing.size
+            entry.currentGoals = mx.currentGoals(mind).size
+            entry.runningTasks = mxu.countActs(mind, mxu.ACTS_RUNNING_TASKS)
+            entry.runningActions = mxu.countActs(mind, mxu.ACTS_RUNNING_ACTIONS)
+        end
+    end
+
+    local sorted = {}
+    for _, rule in pairs(rules) do
+        sorted[#sorted + 1] = rule
+    end
+    table.sort(sorted, function(a, b)
+        if a.ms ~= b.ms then
+            return a.ms > b.ms
+        end
+        return a.fires > b.fires
+    end)
+    buf.ruleCount = math.min(#sorted, ffi.C.AI_PROFILE_MAX_RULES)
+    buf.unlistedRules = #sorted - buf.ruleCount
+    for r = 1, buf.ruleCount do
+        local entry = buf.rules[r - 1]
+        copyName(entry.name, sorted[r].name)
+        entry.fires = sorted[r].fires
+        entry.ms = sorted[r].ms
+    end
+
+    buf.mindCount = math.min(#order, ffi.C.AI_PROFILE_MAX_MINDS)
+    buf.cycle = mx.cycle()
+    buf.minds = numMinds
+    buf.attributedMinds = #order
+    buf.mindsMs = mindsMs
+    buf.attributedMs = attributedMs
+    buf.endCycleMs = endCycleMs
+    buf.collectMs = bridgeNowMs() - startMs
+    buf.sample = buf.sample + 1
+end
+
+local function simMindsTimed(first, count)
+    local mindMs = aiProfile.mindMs
+    for i = first, first + count - 1 do
+        local startMs = bridgeNowMs()
+        mx.simMinds(simBudget.minds + i, 1)
+        mindMs[i] = bridgeNowMs() - startMs
+    end
+end
+-- Calls mx.simMinds, which can call back into Lua: see "JIT partitioning" in mxu.lua. jit.off on
+-- resumeBudgetedCycle doesn't cover it, since it is defined outside.
+mxu.interpreted("simMindsTimed", simMindsTimed)
+
+local function beginBudgetedCycle(sample)
+    -- Copied: minds born during the cycle can change the cached roster before it finishes
+    local roster, rosterSize, rosterVersion = mxu.roster()
+    simBudget.minds = ffi.new("uint64_t[?]", math.max(rosterSize, 1))
+    if simLod.active then
+        indexSimTiers(roster, rosterSize, rosterVersion)
+        local numMinds = 0
+        for i = 0, rosterSize - 1 do
+            if isMindDue(i) then
+                simBudget.minds[numMinds] = roster[i]
+                numMinds = numMinds + 1
+            end
+        end
+        simBudget.numMinds = numMinds
+    else
+        ffi.copy(simBudget.minds, roster, rosterSize * ffi.sizeof("uint64_t"))
+        simBudget.numMinds = rosterSize
+    end
+    simBudget.cursor = 0
+    aiProfile.sampling = sample
+    aiProfile.mindMs = sample and ffi.new("double[?]", math.max(simBudget.numMinds, 1)) or nil
     mx.setTime(simHour, simMin, simSec)
-    
-    -- Run one simulation step
-    mx.sim(1)
-    
+    mx.beginCycle()
+end
+mxu.interpreted("beginBudgetedCycle", beginBudgetedCycle)
+
+-- Process minds of the current cycle until budgetMs is used up. Always processes at least one
+-- mind so a cycle makes progress even if a single mind exceeds the budget.
+-- Returns true when the cycle finished this frame.
+local function resumeBudgetedCycle(budgetMs)
+    local startMs = bridgeNowMs()
+    while simBudget.cursor < simBudget.numMinds do
+        local remaining = simBudget.numMinds - simBudget.cursor
+        local spentMs = bridgeNowMs() - startMs
+        local slice = math.floor((budgetMs - spentMs) / simBudget.msPerMind)
+        slice = math.max(1, math.min(slice, remaining))
+        local sliceStartMs = bridgeNowMs()
+        if aiProfile.sampling then
+            simMindsTimed(simBudget.cursor, slice)
+        else
+            mx.simMinds(simBudget.minds + simBudget.cursor, slice)
+        end
+        local sliceMs = bridgeNowMs() - sliceStartMs
+        simBudget.msPerMind = 0.8 * simBudget.msPerMind + 0.2 * (sliceMs / slice)
+        simBudget.cursor = simBudget.cursor + slice
+        if bridgeNowMs() - startMs >= budgetMs then
+            break
+        end
+    end
+
+    if simBudget.cursor >= simBudget.numMinds then
+        local endStartMs = bridgeNowMs()
+        mx.endCycle()
+        if aiProfile.sampling then
+            collectAiProfile(simBudget.minds, simBudget.numMinds, aiProfile.mindMs,
+                             bridgeNowMs() - endStartMs)
+            aiProfile.sampling = false
+            aiProfile.mindMs = nil
+        end
+        simBudget.minds = nil
+        return true
+    end
+    return false
+end
+mxu.interpreted("resumeBudgetedCycle", resumeBudgetedCycle)
+
+-- Fixed-rate simulation clock. Render frames add wall time to the accumulator and Merlin runs
+-- whole ticks of 1/tickRate sim seconds, so AI cost is independent of the render frame rate.
+simClock = {
+    tickRate = 10,        -- Merlin ticks per second (0 = legacy: one tick per render frame)
+    maxCatchUpTicks = 3,  -- most ticks run in one frame; any older backlog is dropped
+    accumulator = 0,      -- wall time not yet simulated (seconds)
+    tick = 0,             -- ticks completed so far
+    alpha = 1,            -- fraction of the next tick already elapsed (for interpolation)
+    droppedTicks = 0,     -- ticks discarded by the catch-up cap
+    seconds = 0,          -- sim time (see setSimClock)
+}
+
+function setSimTickRate(tickRate, maxCatchUpTicks)
+    simClock.tickRate = math.max(0, tickRate or 0)
+    simClock.maxCatchUpTicks = math.max(1, maxCatchUpTicks or 1)
+    simClock.accumulator = 0
+end
+
+local function advanceSimClock(stepSec)
+    if simTimers == nil then
+        setSimClock(simHour, simMin, simSec)
+    end
+    simClock.seconds = simClock.seconds + stepSec
+    runNpcJobs()
+    simTimers:advance(simClock.seconds)
+    local secondOfDay = simClock.seconds % SECONDS_PER_DAY
+    simHour = math.floor(secondOfDay / 3600)
+    simMin = math.floor(secondOfDay / 60) % 60
+    simSec = secondOfDay % 60
+end
+
+function advanceRealtimeSim(luaDt, budgetMs)
+    -- Realtime simulation: accumulate the frame delta and run as many fixed-length ticks as it
+    -- covers (at most simClock.maxCatchUpTicks, so a long hitch can't snowball).
+    -- With a budget (ms > 0) a cycle that doesn't fit is suspended and resumed next frame.
+    -- Returns (cyclesCompleted, suspended, ticksDropped).
+    budgetMs = budgetMs or 0
+    local frameStartMs = bridgeNowMs()
+    simClock.accumulator = simClock.accumulator + luaDt
+
+    -- Legacy mode (tickRate 0) runs a single tick covering all time since the last one
+    local fixedRate = simClock.tickRate > 0
+    local tickSec = fixedRate and 1 / simClock.tickRate or simClock.accumulator
+    local maxTicks = fixedRate and simClock.maxCatchUpTicks or 1
+    local cycles, suspended, dropped = 0, false, 0
+
+    -- A cycle suspended last frame is a tick already taken off the accumulator: finish it first
+    if simBudget.minds ~= nil then
+        if resumeBudgetedCycle(budgetMs) then
+            cycles = 1
+            simClock.tick = simClock.tick + 1
+        else
+            suspended = true
+        end
+    elseif budgetMs > 0 and simBudget.debtMs > 0 then
+        -- Merlin can't suspend a cycle: skip frames until the overrun has been paid back
+        simBudget.debtMs = math.max(0, simBudget.debtMs - budgetMs)
+        suspended = true
+    end
+
+    -- Spiral-of-death guard: drop whole ticks beyond what this frame is allowed to catch up
+    if fixedRate then
+        dropped = math.max(0, math.floor(simClock.accumulator / tickSec) - (maxTicks - cycles))
+        simClock.accumulator = simClock.accumulator - dropped * tickSec
+        simClock.droppedTicks = simClock.droppedTicks + dropped
+    end
+
+    while not suspended and cycles < maxTicks and simClock.accumulator >= tickSec do
+        local remainingMs = budgetMs - (bridgeNowMs() - frameStartMs)
+        if budgetMs > 0 and remainingMs <= 0 then
+            break -- budget used up; the backlog waits for the next frame
+        end
+
+        simClock.accumulator = simClock.accumulator - tickSec
+        advanceSimClock(tickSec)
+
+        refreshSimTiers()
+        local sample = isAiSampleDue()
+        if simCanSlice and (budgetMs > 0 or simLod.active or sample) then
+            beginBudgetedCycle(sample)
+            suspended = not resumeBudgetedCycle(budgetMs > 0 and remainingMs or math.huge)
+        else
+            -- Set the current time in Merlin and run one simulation step
+            mx.setTime(simHour, simMin, simSec)
+            local startMs = bridgeNowMs()
+            mx.sim(1)
+            if budgetMs > 0 then
+                simBudget.debtMs = math.max(0, bridgeNowMs() - startMs - remainingMs)
+            end
+            if sample then
+                local roster, rosterSize = mxu.roster()
+                collectAiProfile(roster, rosterSize, nil, 0)
+            end
+        end
+
+        if not suspended then
+            cycles = cycles + 1
+            simClock.tick = simClock.tick + 1
+        end
+        if simBudget.debtMs > 0 then
+            break -- whole cycle overran: the following frames repay it
+        end
+    end
+
+    simClock.alpha = fixedRate and math.min(simClock.accumulator / tickSec, 1) or 1
+    return cycles, suspended, dropped
+end
+-- Calls mx.sim(), which can call back into Lua: see "JIT partitioning" in mxu.lua
+mxu.interpreted("advanceRealtimeSim", advanceRealtimeSim)
+
+-- ---------------------------------------------------------------------------
+-- Historical simulation: coarse steps of whole months with teleporting NPCs, used to age the
+-- world from firstSimYear to the game's start date (see fastforward.lua).
+-- ---------------------------------------------------------------------------
+
+function advanceHistorySim(monthsPerStep, cyclesPerStep)
+    simMonth = simMonth + monthsPerStep
+    while simMonth >= 12 do
+        simMonth = simMonth - 12
+        simYear = simYear + 1
+    end
+    simQuarter = math.floor(simMonth / 3) + 1
+
+    mx.setDateAndTime(simYear, simMonth, 0, simHour, 0, 0)
+    mx.sim(cyclesPerStep)
+end
+mxu.interpreted("advanceHistorySim", advanceHistorySim)
+
+-- Checkpoints are a Lua manifest (sim date, counters) next to a Merlin world snapshot.
+-- Snapshots need a Merlin build that exports saveSnapshot/loadSnapshot; without it only the
+-- manifest is written and the checkpoint can't be booted from.
+function saveCheckpoint(manifestPath)
+    local snapshotPath = string.gsub(manifestPath, "%.lua$", "") .. ".msnap"
+    local hasSnapshot = mxu.has("saveSnapshot") and mx.saveSnapshot(snapshotPath)
+    if not hasSnapshot then
+        snapshotPath = nil
+        print("WARNING: Merlin can't save world snapshots; checkpoint " .. manifestPath .. " is manifest only")
+    end
+
+    local file = assert(io.open(manifestPath, "w"))
+    file:write("-- Merlin history checkpoint (written by saveCheckpoint in sim.lua)\n")
+    file:write("return {\n")
+    file:write(string.format("    year = %d,\n", simYear))
+    file:write(string.format("    month = %d,\n", simMonth))
+    file:write(string.format("    hour = %d,\n", simHour))
+    file:write(string.format("    cycle = %d,\n", mx.cycle()))
+    file:write(string.format("    npcCount = %d,\n", mxu.rosterSize()))
+    if snapshotPath then
+        -- Stored relative to the manifest so checkpoints can be copied to another machine
+        file:write(string.format("    snapshot = %q,\n", string.match(snapshotPath, "[^/\\]+$")))
+    end
+    file:write("}\n")
+    file:close()
+    return snapshotPath ~= nil
+end
+
+-- Restore a checkpoint written by saveCheckpoint. Returns true if the world was replaced.
+function loadCheckpoint(manifestPath)
+    local ok, manifest = pcall(dofile, manifestPath)
+    if not ok or type(manifest) ~= "table" then
+        print("ERROR: Can't read checkpoint manifest " .. manifestPath .. ": " .. tostring(manifest))
+        return false
+    end
+    if manifest.snapshot == nil or not mxu.has("loadSnapshot") then
+        print("ERROR: Checkpoint " .. manifestPath .. " has no world snapshot Merlin can load")
+        return false
+    end
+
+    local dir = string.match(manifestPath, "^(.*[/\\])") or ""
+    if not mx.loadSnapshot(dir .. manifest.snapshot) then
+        print("ERROR: Merlin failed to load world snapshot " .. dir .. manifest.snapshot)
+        return false
+    end
+
+    simYear = manifest.year
+    simMonth = manifest.month
+    simQuarter = math.floor(simMonth / 3) + 1
+    simHour = manifest.hour
+    simMin = 0.0
+    simSec = 0
+    setSimClock(simHour, simMin, simSec)
+    mx.setDateAndTime(simYear, simMonth, 0, simHour, 0, 0)
+    print(string.format("Booted from checkpoint %s (%d, %d NPCs)", manifestPath, simYear, mxu.rosterSize()))
     return true
 end
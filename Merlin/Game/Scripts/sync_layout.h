@@ -0,0 +1,114 @@
+// Shared C layout of the Merlin <-> GRYM sync buffers. This is the only definition: MerlinLua.h
+// includes it, and main.lua reads this file and passes it to ffi.cdef (lines starting with '#'
+// are skipped there). Plain C declarations only; no macros.
+//
+// Entry arrays are owned by C++ and reached through a pointer, so buffers can grow without
+// changing the layout. Producers fill at most `capacity` entries and report what didn't fit
+// in `unsent`; C++ counts the overflow and grows the buffer before the next fill.
+// uint64 entity symbols flow through these buffers raw — no double conversion.
+#pragma once
+
+#include <stdint.h>
+
+enum {
+    // EntitySyncEntry.flags: what changed since the entity was last sent (npc state buffers)
+    SYNC_SPAWNED = 1, // first time sent (or re-sent by a full sync)
+    SYNC_MOVED = 2,   // position changed
+    SYNC_REMOVED = 4, // tombstone: entity no longer exists
+
+    // EntitySyncBuffer.flags
+    SYNC_FULL = 1, // lists every entity; anything not in it has been removed
+
+    // Model path table
+    MODEL_PATH_CAPACITY = 64,
+    MODEL_PATH_MAX = 260, // MAX_PATH, including the terminator
+    NO_MODEL = 255,
+
+    // SimTierEntry.tier
+    SIM_TIER_FULL = 0,      // deliberates every tick
+    SIM_TIER_RING = 1,      // reduced rate
+    SIM_TIER_BACKGROUND = 2, // slow background cadence
+
+    // AI profile sample
+    AI_PROFILE_MAX_RULES = 64,
+    AI_PROFILE_MAX_MINDS = 8,
+    AI_PROFILE_NAME_MAX = 64
+};
+
+typedef struct EntitySyncEntry {
+    uint64_t merlinId;  // Merlin entity symbol (raw uint64, never converted)
+    float x, y, z;      // Position in meters
+    uint16_t version;   // per-entity change counter, bumped every time the entity is sent
+    uint8_t flags;      // SYNC_SPAWNED / SYNC_MOVED / SYNC_REMOVED
+    uint8_t modelIndex; // ModelPathTable index for GRYM rendering (NO_MODEL if none)
+} EntitySyncEntry;
+
+// NPC state buffers carry deltas: only entities that spawned, moved or were removed since the
+// previous fill.
+typedef struct EntitySyncBuffer {
+    EntitySyncEntry *entries; // `capacity` entries, allocated by C++
+    int32_t capacity;
+    int32_t count;
+    int32_t unsent;  // entries the producer couldn't fit (reported again by the next fill)
+    uint32_t flags;  // SYNC_FULL
+    uint32_t tick;   // sim tick the entries reflect (npc state buffers only)
+    float tickAlpha; // fraction of the following tick already elapsed (0..1)
+} EntitySyncBuffer;
+
+// Simulation LOD tier per NPC (C++ fills, Lua reads at the start of each tick)
+typedef struct SimTierEntry {
+    uint64_t merlinId; // Merlin NPC symbol (raw uint64)
+    int32_t tier;      // SIM_TIER_*
+} SimTierEntry;
+
+typedef struct SimTierBuffer {
+    SimTierEntry *entries; // `capacity` entries, allocated by C++
+    int32_t capacity;
+    int32_t count;
+    uint32_t version; // bumped on every commit so Lua only re-reads changed tiers
+} SimTierBuffer;
+
+// Model paths interned once, shared by Lua and C++. Append-only: an index handed out in an
+// EntitySyncEntry always refers to the same path, so entries never carry the string itself.
+typedef struct ModelPathTable {
+    char paths[MODEL_PATH_CAPACITY][MODEL_PATH_MAX];
+    int32_t count;
+} ModelPathTable;
+
+// One behaviour rule in a sampled cycle. Each mind's deliberation time is split evenly between
+// the rules that fired in it.
+typedef struct AiRuleSample {
+    char name[AI_PROFILE_NAME_MAX];
+    uint32_t fires; // minds the rule fired in
+    float ms;       // share of those minds' deliberation time
+} AiRuleSample;
+
+// One of the most expensive minds in a sampled cycle
+typedef struct AiMindSample {
+    uint64_t merlinId; // Merlin NPC symbol (raw uint64)
+    char name[AI_PROFILE_NAME_MAX];
+    float ms; // deliberation time
+    uint16_t firingRules;
+    uint16_t currentGoals;
+    uint16_t runningTasks;
+    uint16_t runningActions;
+} AiMindSample;
+
+// AI profiler. C++ sets intervalMs; every intervalMs Lua runs one cycle a mind at a time,
+// timing each mind, then reads back what fired in the most expensive ones and bumps `sample`.
+typedef struct AiProfileBuffer {
+    float intervalMs;        // C++: time between samples (0 = off)
+    uint32_t sample;         // Lua: bumped when a new sample has been written
+    uint32_t cycle;          // Merlin cycle sampled
+    int32_t minds;           // minds that deliberated in the cycle
+    int32_t attributedMinds; // most expensive minds whose firing rules were read
+    float mindsMs;           // deliberation time of all minds (0 = Merlin can't time minds)
+    float attributedMs;      // part of mindsMs spent in attributedMinds
+    float endCycleMs;        // endCycle (action dispatch)
+    float collectMs;         // reading the sample back (profiler overhead)
+    int32_t ruleCount;
+    int32_t unlistedRules; // rules that fired but didn't fit in `rules`
+    int32_t mindCount;
+    AiRuleSample rules[AI_PROFILE_MAX_RULES];    // most expensive first
+    AiMindSample topMinds[AI_PROFILE_MAX_MINDS]; // most expensive first
+} AiProfileBuffer;
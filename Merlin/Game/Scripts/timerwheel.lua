@@ -0,0 +1,123 @@
+-- Hierarchical timer wheel for sim-time events (simTimers in sim.lua). Times are whole units;
+-- the sim layer uses sim seconds. Level 1 has a slot per unit for the next 64 units, and each
+-- higher level has a slot per 64x as many. A timer is kept in the lowest level whose span
+-- reaches its time, and moves down a level each time the wheel turns past its slot on the
+-- level above. Scheduling and cancelling are O(1). A timer is moved at most once per level, so
+-- firing costs amortized O(1) however far ahead it was set. Timers due at the same unit fire in
+-- the order they were scheduled.
+
+TimerWheel = {}
+TimerWheel.__index = TimerWheel
+
+local SLOTS = 64
+local LEVELS = 4 -- 64^4 units, 194 days of sim seconds; later timers wait in the overflow list
+
+local spans = {} -- units covered by one slot of each level
+for level = 1, LEVELS + 1 do
+    spans[level] = SLOTS ^ (level - 1)
+end
+
+function TimerWheel.new(now)
+    local wheel = setmetatable({ now = math.floor(now), levels = {}, overflow = {}, count = 0 },
+                               TimerWheel)
+    for level = 1, LEVELS do
+        local slots = {}
+        for slot = 0, SLOTS - 1 do
+            slots[slot] = {}
+        end
+        wheel.levels[level] = slots
+    end
+    return wheel
+end
+
+local function place(wheel, timer)
+    local delta = timer.at - wheel.now
+    for level = 1, LEVELS do
+        if delta < spans[level + 1] then
+            local slots = wheel.levels[level]
+            local slot = slots[math.floor(timer.at / spans[level]) % SLOTS]
+            slot[#slot + 1] = timer
+            return
+        end
+    end
+    wheel.overflow[#wheel.overflow + 1] = timer
+end
+
+-- Call handler(at, timer) once the wheel reaches unit at. A time not after now fires on the
+-- next unit. Returns the timer, for cancel.
+function TimerWheel:schedule(at, handler)
+    local timer = { at = math.max(math.floor(at), self.now + 1), handler = handler }
+    timer.pending = true
+    self.count = self.count + 1
+    place(self, timer)
+    return timer
+end
+
+-- Call handler(at, timer) at first and then every period units, until cancelled
+function TimerWheel:every(first, period, handler)
+    local timer
+    local function fire(at)
+        timer.at = at + period
+        timer.pending = true
+        self.count = self.count + 1
+        place(self, timer)
+        handler(at, timer)
+    end
+    timer = self:schedule(first, fire)
+    return timer
+end
+
+-- Cancelled timers are dropped when the wheel reaches their slot
+function TimerWheel:cancel(timer)
+    if timer.pending then
+        timer.pending = false
+        self.count = self.count - 1
+    end
+end
+
+-- Move a slot of a higher level down to the levels below it
+local function cascade(wheel, timers)
+    for i = 1, #timers do
+        if timers[i].pending then
+            place(wheel, timers[i])
+        end
+    end
+end
+
+-- Fire every timer due at or before unit to, in time order
+function TimerWheel:advance(to)
+    to = math.floor(to)
+    while self.now < to do
+        if self.count == 0 then
+            self.now = to -- nothing scheduled: no slots to visit
+            return
+        end
+        local now = self.now + 1
+        self.now = now
+        if now % spans[LEVELS + 1] == 0 then
+            local overflow = self.overflow
+            self.overflow = {}
+            cascade(self, overflow)
+        end
+        for level = LEVELS, 2, -1 do
+            if now % spans[level] == 0 then
+                local slots = self.levels[level]
+                local index = math.floor(now / spans[level]) % SLOTS
+                local timers = slots[index]
+                slots[index] = {}
+                cascade(self, timers)
+            end
+        end
+        local slots = self.levels[1]
+        local due = slots[now % SLOTS]
+        slots[now % SLOTS] = {}
+        for i = 1, #due do
+            local timer = due[i]
+            if timer.pending then
+                timer.pending = false
+                self.count = self.count - 1
+                timer.handler(timer.at, timer)
+            end
+        end
+    end
+end
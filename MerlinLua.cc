@@ -2,15 +2,47 @@
 
 #include "GrymEngine.h"
 
+#ifdef _WIN32
 #include <Windows.h>
+#else
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <ctime>
 #include <filesystem>
+#include <memory>
+#include <type_traits>
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #include <lua.hpp>
 
+// Include Merlin's shared header for action buffer communication (pure C, no Merlin internals)
+#include "../Merlin/Src/Lib/Interface/C/ForeignActionCommandBuffer.h"
+
 // Initialize static function pointers
 MerlinLua::WorldPosFn MerlinLua::worldPos = nullptr;
 MerlinLua::QueryHstrFn MerlinLua::queryHstr = nullptr;
 MerlinLua::RegisterBufferFn MerlinLua::registerForeignActionCommandBuffer = nullptr;
 MerlinLua::UnregisterBufferFn MerlinLua::unregisterForeignActionCommandBuffer = nullptr;
+MerlinLua::NpcsFn MerlinLua::npcs = nullptr;
+MerlinLua::AttrSymbolFn MerlinLua::attrSymbol = nullptr;
+MerlinLua::ToStringFn MerlinLua::toString = nullptr;
+MerlinLua::WorldPositionsFn MerlinLua::worldPositions = nullptr;
+MerlinLua::SetWorldPositionsFn MerlinLua::setWorldPositions = nullptr;
+MerlinLua::RosterVersionFn MerlinLua::rosterVersion = nullptr;
+MerlinLua::RosterNpcsFn MerlinLua::rosterNpcs = nullptr;
+MerlinLua::PoolStatsFn MerlinLua::poolStats = nullptr;
+MerlinLua::UseCompiledSourcesFn MerlinLua::useCompiledSources = nullptr;
+MerlinLua::UseHeightfieldFn MerlinLua::useHeightfield = nullptr;
+MerlinLua::TerrainElevationsFn MerlinLua::terrainElevations = nullptr;
+MerlinLua::WorldSectorsFn MerlinLua::worldSectors = nullptr;
 
 // Pure C print function - no C++ objects on the stack
 static int merlin_lua_print(lua_State *L) {
@@ -33,12 +65,123 @@ static int merlin_lua_print(lua_State *L) {
     return 0;
 }
 
-bool MerlinLua::Initialize(const std::string &merlin_path) {
+// NPCs that moved less than this (1 mm) since they were last sent don't produce a delta
+static constexpr float kNpcMoveEpsilonSq = 0.001f * 0.001f;
+
+// Monotonic wall clock in milliseconds, for frame-budgeted simulation in sim.lua
+static double SteadyNowMs() {
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+static int merlin_lua_now_ms(lua_State *L) {
+    lua_pushnumber(L, SteadyNowMs());
+    return 1;
+}
+
+// Bridge recording format: a header, then events of { uint8 type, uint32 size, payload }.
+// Payloads are little-endian PODs written in field order (see the Record* call sites).
+static constexpr char kRecordMagic[4] = {'M', 'B', 'R', 'C'};
+static constexpr uint32_t kRecordVersion = 1;
+enum RecordEventType : uint8_t {
+    REC_INIT = 1,           // uint32 syncCapacity, string bootCheckpoint
+    REC_TICK_RATE,          // float ticksPerSecond, int maxCatchUpTicks
+    REC_SIM_LOD,            // int ringInterval, int backgroundInterval
+    REC_GC_BUDGET,          // float milliseconds
+    REC_CREATE_PLAYER,      // XMFLOAT3
+    REC_CREATE_NPCS,        // spawn points, model paths, waypoints (each uint32 count + items)
+    REC_ASYNC_START,        // the worker thread took over; later events are per tick
+    REC_PLAYER_POS,         // XMFLOAT3
+    REC_POS_FEEDBACK,       // int count, { uint64 merlinId, XMFLOAT3 }
+    REC_SIM_TIERS,          // int count, uint32 changed, { uint32 index, uint64 id, int tier }
+    REC_REGISTER_ACTIONS,   // uint64 merlinId, ForeignActionCommandBuffer contents
+    REC_UNREGISTER_ACTIONS, // uint64 merlinId
+    REC_ACTION_OUTCOMES,    // uint32 count, { uint64 merlinId, uint8 motor, int outcome }
+    REC_UPDATE,             // float dt, float frameBudgetMs
+    REC_NPC_STATES,         // uint8 fullSync, uint64 state hash after the fill
+};
+
+template <typename T> static void RecordValue(std::vector<uint8_t> &out, const T &value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+static void RecordString(std::vector<uint8_t> &out, const std::string &str) {
+    RecordValue(out, (uint32_t)str.size());
+    out.insert(out.end(), str.begin(), str.end());
+}
+
+// Reads one event payload; any read past the end leaves ok false and returns zeros
+struct RecordReader {
+    const uint8_t *at;
+    const uint8_t *end;
+    bool ok = true;
+
+    template <typename T> T Get() {
+        T value = {};
+        if (end - at < (ptrdiff_t)sizeof(T)) {
+            ok = false;
+            return value;
+        }
+        memcpy(&value, at, sizeof(T));
+        at += sizeof(T);
+        return value;
+    }
+
+    std::string GetString() {
+        uint32_t size = Get<uint32_t>();
+        if (end - at < (ptrdiff_t)size) {
+            ok = false;
+            return {};
+        }
+        std::string str(reinterpret_cast<const char *>(at), size);
+        at += size;
+        return str;
+    }
+
+    std::vector<XMFLOAT3> GetPositions() {
+        uint32_t count = Get<uint32_t>();
+        std::vector<XMFLOAT3> positions;
+        for (uint32_t i = 0; i < count && ok; i++)
+            positions.push_back(Get<XMFLOAT3>());
+        return positions;
+    }
+};
+
+// FNV-1a, for the replay state hash and the warm-start key
+static constexpr uint64_t kStateHashSeed = 14695981039346656037ull;
+
+static uint64_t HashBytes(uint64_t hash, const void *data, size_t size) {
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    return hash;
+}
+
+// What a delta fill tells the game: who changed, where to, and how
+static uint64_t HashNpcDeltas(uint64_t hash, const EntitySyncBuffer &buffer) {
+    auto mix = [&hash](const void *data, size_t size) { hash = HashBytes(hash, data, size); };
+    for (int i = 0; i < buffer.count; i++) {
+        const EntitySyncEntry &entry = buffer.entries[i];
+        mix(&entry.merlinId, sizeof(entry.merlinId));
+        mix(&entry.x, sizeof(float) * 3);
+        mix(&entry.version, sizeof(entry.version));
+        mix(&entry.flags, sizeof(entry.flags));
+    }
+    return hash;
+}
+
+bool MerlinLua::Initialize(const std::string &merlin_path, const std::string &bootCheckpoint,
+                           int syncCapacity) {
     if (L != nullptr) {
         wi::backlog::post("MerlinLua already initialized\n");
         return false;
     }
 
+    bootCheckpointPath = bootCheckpoint;
+    initStartMs = SteadyNowMs();
+
     // Create new Lua state with all standard libraries
     L = luaL_newstate();
     if (!L) {
@@ -52,6 +195,19 @@ bool MerlinLua::Initialize(const std::string &merlin_path) {
     lua_pushcfunction(L, merlin_lua_print);
     lua_setglobal(L, "print");
 
+    lua_pushcfunction(L, merlin_lua_now_ms);
+    lua_setglobal(L, "bridgeNowMs");
+
+    // Compiled data cache access for loadAttrTable (see SetDataCache)
+    if (!dataCacheDir.empty()) {
+        lua_pushlightuserdata(L, this);
+        lua_pushcclosure(L, LuaCompiledData, 1);
+        lua_setglobal(L, "bridgeCompiledData");
+        lua_pushlightuserdata(L, this);
+        lua_pushcclosure(L, LuaStoreCompiled, 1);
+        lua_setglobal(L, "bridgeStoreCompiled");
+    }
+
     // Get the current executable directory for cwd (where Merlin.dll lives)
     std::string exe_path = wi::helper::GetExecutablePath();
     std::string exe_dir = wi::helper::GetDirectoryFromPath(exe_path);
@@ -60,19 +216,51 @@ bool MerlinLua::Initialize(const std::string &merlin_path) {
     lua_pushstring(L, exe_dir.c_str());
     lua_setglobal(L, "cwd");
 
+#ifndef _WIN32
+    // Elsewhere the library is libmerlin.so next to the executable (e.g. the stand-in library
+    // built by Tools/MerlinStub for headless benchmarking)
+    lua_pushstring(L, (exe_dir + "libmerlin.so").c_str());
+    lua_setglobal(L, "merlinLibPath");
+#endif
+
     // Set global 'merlin_path' so Lua scripts can find Merlin data tree
     lua_pushstring(L, merlin_path.c_str());
     lua_setglobal(L, "merlin_path");
 
+    // Set global 'bootCheckpoint' so merlinInit() restores an aged world instead of 1720
+    if (!bootCheckpoint.empty()) {
+        std::filesystem::path checkpoint(bootCheckpoint);
+        if (checkpoint.is_relative())
+            checkpoint = std::filesystem::path(merlin_path) / checkpoint;
+        lua_pushstring(L, checkpoint.generic_string().c_str());
+        lua_setglobal(L, "bootCheckpoint");
+    }
+
+    // Allocate the sync buffers at the negotiated capacity; Lua reads it from each buffer
+    npcSyncCapacity = std::clamp(syncCapacity, 1, kMaxSyncCapacity);
+    npcStateBuffer.Reserve(npcSyncCapacity);
+    posFeedbackBuffer.Reserve(npcSyncCapacity);
+    posFeedbackStaging.Reserve(npcSyncCapacity);
+    waypointBuffer.Reserve(npcSyncCapacity);
+    simTierBuffer.Reserve(npcSyncCapacity);
+    simTierStaging.Reserve(npcSyncCapacity);
+    syncStats.npcCapacity = npcSyncCapacity;
+
     // Pass shared buffer pointers to Lua as lightuserdata.
     // Lua will cast these to FFI struct pointers for direct read/write.
     // uint64 entity symbols flow through these buffers raw — no double conversion.
-    lua_pushlightuserdata(L, &npcStateBuffer);
+    lua_pushlightuserdata(L, static_cast<EntitySyncBuffer *>(&npcStateBuffer));
     lua_setglobal(L, "g_npcStateBufferPtr");
-    lua_pushlightuserdata(L, &posFeedbackBuffer);
+    lua_pushlightuserdata(L, static_cast<EntitySyncBuffer *>(&posFeedbackBuffer));
     lua_setglobal(L, "g_posFeedbackBufferPtr");
-    lua_pushlightuserdata(L, &waypointBuffer);
+    lua_pushlightuserdata(L, static_cast<EntitySyncBuffer *>(&waypointBuffer));
     lua_setglobal(L, "g_waypointBufferPtr");
+    lua_pushlightuserdata(L, static_cast<SimTierBuffer *>(&simTierBuffer));
+    lua_setglobal(L, "g_simTierBufferPtr");
+    lua_pushlightuserdata(L, &modelPathTable);
+    lua_setglobal(L, "g_modelPathTablePtr");
+    lua_pushlightuserdata(L, &aiProfileBuffer);
+    lua_setglobal(L, "g_aiProfilePtr");
 
     // Adjust package.path to include Merlin scripts and Lua directory
     lua_getglobal(L, "package");
@@ -120,21 +308,11 @@ bool MerlinLua::Initialize(const std::string &merlin_path) {
         return false;
     }
 
-    // Call merlinInit() to start the simulation
-    lua_getglobal(L, "merlinInit");
-    if (!lua_isfunction(L, -1)) {
-        char buffer[512];
-        int type = lua_type(L, -1);
-        sprintf_s(buffer, "ERROR: merlinInit is not a function (type=%s)\n", lua_typename(L, type));
-        wi::backlog::post(buffer);
-        lua_pop(L, 1);
-        lua_close(L);
-        L = nullptr;
-        return false;
-    }
+    // Resolve the entry points C++ calls, then call merlinInit() to start the simulation
+    ResolveBridge();
 
-    // Disable JIT compilation (Merlin FFI callbacks re-enter Lua, which can cause issues with JIT)
-    luaL_dostring(L, "jit.off()");
+    // The JIT stays on: the scripts keep every function Merlin callbacks can re-enter interpreted
+    // (mxu.interpreted), so the sync marshalling loops get compiled
 
     // Load Merlin CInterface functions from DLL
     if (!LoadMerlinCInterface()) {
@@ -144,19 +322,122 @@ bool MerlinLua::Initialize(const std::string &merlin_path) {
         return false;
     }
 
-    // Call merlinInit()
-    if (lua_pcall(L, 0, 0, 0) != LUA_OK) {
+    // Hash the data tree (the data cache, the heightfield and the warm-start key depend on it),
+    // and hand Merlin what is still compiled and the terrain before it starts
+    if (!dataCacheDir.empty() || !warmStartDir.empty() || !heightfieldPath.empty())
+        HashDataTree(merlin_path);
+    if (!dataCacheDir.empty())
+        OpenDataCache();
+    if (!heightfieldPath.empty())
+        OpenHeightfield();
+
+    // Resume from a warm-start file when there is a usable one for this data
+    if (!TryWarmStart(merlin_path)) {
+        // Call merlinInit()
+        if (!PushBridge(BRIDGE_INIT)) {
+            wi::backlog::post("ERROR: merlinInit is not a function\n");
+            lua_close(L);
+            L = nullptr;
+            CloseDataCache();
+            CloseHeightfield();
+            return false;
+        }
+        if (!CallBridge(BRIDGE_INIT, 0, 0)) {
+            lua_close(L);
+            L = nullptr;
+            CloseDataCache();
+            CloseHeightfield();
+            return false;
+        }
+        if (!dataCacheDir.empty())
+            SaveDataCache();
+    }
+    if (!heightfieldPath.empty() && !HasHeightfield())
+        BakeHeightfield();
+
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Lua bridge calls
+// ---------------------------------------------------------------------------
+
+// Indexed by MerlinLua::BridgeEntry
+static const char *const kBridgeEntryNames[] = {
+    "merlinInit",         "merlinCreatePlayer",     "merlinUpdatePlayerPos", "merlinCreateNpcs",
+    "merlinGetNpcStates", "merlinApplyPosFeedback", "merlinSetSimLod",       "merlinSetTickRate",
+    "merlinUpdate",       "merlinShutdown",         "merlinBenchmarkJit",
+    "merlinBenchmarkIntrospection", "merlinWarmStart", "merlinWarmState",
+};
+
+static int BridgeTraceback(lua_State *L) {
+    const char *msg = lua_tostring(L, 1);
+    luaL_traceback(L, L, msg ? msg : "(error object is not a string)", 1);
+    return 1;
+}
+
+void MerlinLua::ResolveBridge() {
+    static_assert(std::size(kBridgeEntryNames) == BRIDGE_ENTRY_COUNT);
+
+    lua_pushcfunction(L, BridgeTraceback);
+    tracebackRef = luaL_ref(L, LUA_REGISTRYINDEX);
+
+    for (int i = 0; i < BRIDGE_ENTRY_COUNT; i++) {
+        bridgeStats[i] = MerlinBridgeStats();
+        bridgeStats[i].name = kBridgeEntryNames[i];
+        lua_getglobal(L, kBridgeEntryNames[i]);
+        if (lua_isfunction(L, -1)) {
+            bridgeRefs[i] = luaL_ref(L, LUA_REGISTRYINDEX);
+        } else {
+            lua_pop(L, 1);
+            bridgeRefs[i] = LUA_NOREF;
+        }
+    }
+    syncedBridgeStats = bridgeStats;
+}
+
+void MerlinLua::ReleaseBridge() {
+    bridgeRefs.fill(LUA_NOREF);
+    tracebackRef = LUA_NOREF;
+}
+
+bool MerlinLua::PushBridge(BridgeEntry entry) {
+    // Refs are never 0 (or negative); a zero ref means Initialize hasn't resolved it
+    if (bridgeRefs[entry] <= 0)
+        return false;
+    lua_rawgeti(L, LUA_REGISTRYINDEX, bridgeRefs[entry]);
+    return true;
+}
+
+bool MerlinLua::CallBridge(BridgeEntry entry, int nargs, int nresults) {
+    MerlinBridgeStats &stats = bridgeStats[entry];
+
+    // Slip the traceback handler in below the function
+    int handler = lua_gettop(L) - nargs;
+    lua_rawgeti(L, LUA_REGISTRYINDEX, tracebackRef);
+    lua_insert(L, handler);
+
+    auto range = wi::profiler::BeginRange(stats.name, wi::profiler::DOMAIN_CPU);
+    auto startTime = std::chrono::high_resolution_clock::now();
+    int status = lua_pcall(L, nargs, nresults, handler);
+    auto endTime = std::chrono::high_resolution_clock::now();
+    wi::profiler::EndRange(range);
+    lua_remove(L, handler);
+
+    double ms = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+    stats.calls++;
+    stats.totalMs += ms;
+    stats.maxMs = std::max(stats.maxMs, ms);
+    stats.lastMs = ms;
+
+    if (status != LUA_OK) {
+        stats.errors++;
         const char *error_msg = lua_tostring(L, -1);
-        char buffer[512];
-        sprintf_s(buffer, "ERROR: merlinInit() failed: %s\n",
-                  error_msg ? error_msg : "unknown error");
-        wi::backlog::post(buffer);
+        wi::backlog::post(std::string("ERROR: ") + stats.name + "() failed: " +
+                          (error_msg ? error_msg : "unknown error") + "\n");
         lua_pop(L, 1);
-        lua_close(L);
-        L = nullptr;
         return false;
     }
-
     return true;
 }
 
@@ -166,15 +447,14 @@ void MerlinLua::CreatePlayer(const XMFLOAT3 &position) {
         return;
     }
 
+    if (recordFile) {
+        RecordValue(recordEvent, position);
+        WriteRecordEvent(REC_CREATE_PLAYER);
+    }
+
     // Call merlinCreatePlayer(x, y, z) to create player entity in Merlin
-    lua_getglobal(L, "merlinCreatePlayer");
-    if (!lua_isfunction(L, -1)) {
-        char buffer[512];
-        int type = lua_type(L, -1);
-        sprintf_s(buffer, "ERROR: merlinCreatePlayer is not a function (type=%s)\n",
-                  lua_typename(L, type));
-        wi::backlog::post(buffer);
-        lua_pop(L, 1);
+    if (!PushBridge(BRIDGE_CREATE_PLAYER)) {
+        wi::backlog::post("ERROR: merlinCreatePlayer is not a function\n");
         return;
     }
 
@@ -183,14 +463,7 @@ void MerlinLua::CreatePlayer(const XMFLOAT3 &position) {
     lua_pushnumber(L, position.y);
     lua_pushnumber(L, position.z);
 
-    if (lua_pcall(L, 3, 0, 0) != LUA_OK) {
-        const char *error_msg = lua_tostring(L, -1);
-        char buffer[512];
-        sprintf_s(buffer, "ERROR: merlinCreatePlayer() failed: %s\n",
-                  error_msg ? error_msg : "unknown error");
-        wi::backlog::post(buffer);
-        lua_pop(L, 1);
-    } else {
+    if (CallBridge(BRIDGE_CREATE_PLAYER, 3, 0)) {
         char buffer[256];
         sprintf_s(buffer, "Merlin player entity created at (%.2f, %.2f, %.2f)\n", position.x,
                   position.y, position.z);
@@ -203,26 +476,32 @@ void MerlinLua::UpdatePlayerPosition(const XMFLOAT3 &position) {
         return;
     }
 
-    // Call merlinUpdatePlayerPos(x, y, z) to update player position in Merlin
-    lua_getglobal(L, "merlinUpdatePlayerPos");
-    if (!lua_isfunction(L, -1)) {
-        lua_pop(L, 1);
+    if (IsAsyncSimulation()) {
+        // Queued for the next tick; only the latest position matters
+        stagedPlayerPos = position;
+        hasStagedPlayerPos = true;
         return;
     }
 
+    CallUpdatePlayerPos(position);
+}
+
+void MerlinLua::CallUpdatePlayerPos(const XMFLOAT3 &position) {
+    if (recordFile) {
+        RecordValue(recordEvent, position);
+        WriteRecordEvent(REC_PLAYER_POS);
+    }
+
+    // Call merlinUpdatePlayerPos(x, y, z) to update player position in Merlin
+    if (!PushBridge(BRIDGE_UPDATE_PLAYER_POS))
+        return;
+
     // Push position arguments (in meters)
     lua_pushnumber(L, position.x);
     lua_pushnumber(L, position.y);
     lua_pushnumber(L, position.z);
 
-    if (lua_pcall(L, 3, 0, 0) != LUA_OK) {
-        const char *error_msg = lua_tostring(L, -1);
-        char buffer[512];
-        sprintf_s(buffer, "ERROR: merlinUpdatePlayerPos() failed: %s\n",
-                  error_msg ? error_msg : "unknown error");
-        wi::backlog::post(buffer);
-        lua_pop(L, 1);
-    }
+    CallBridge(BRIDGE_UPDATE_PLAYER_POS, 3, 0);
 }
 
 void MerlinLua::CreateNpcs(const std::vector<XMFLOAT3> &spawnPoints,
@@ -233,15 +512,29 @@ void MerlinLua::CreateNpcs(const std::vector<XMFLOAT3> &spawnPoints,
         return;
     }
 
+    if (recordFile) {
+        RecordValue(recordEvent, (uint32_t)spawnPoints.size());
+        for (const XMFLOAT3 &point : spawnPoints)
+            RecordValue(recordEvent, point);
+        RecordValue(recordEvent, (uint32_t)npcModelPaths.size());
+        for (const std::string &modelPath : npcModelPaths)
+            RecordString(recordEvent, modelPath);
+        RecordValue(recordEvent, (uint32_t)waypointPositions.size());
+        for (const XMFLOAT3 &point : waypointPositions)
+            RecordValue(recordEvent, point);
+        WriteRecordEvent(REC_CREATE_NPCS);
+    }
+
+    // Intern the configured models up front so NPC deltas only ever carry their index
+    for (const std::string &modelPath : npcModelPaths)
+        InternModelPath(modelPath.c_str());
+
+    // Lua lists every waypoint symbol in waypointBuffer
+    waypointBuffer.Reserve(std::min(static_cast<int>(waypointPositions.size()), kMaxSyncCapacity));
+
     // Call merlinCreateNpcs(spawnPoints, npcModelPaths, waypoints)
-    lua_getglobal(L, "merlinCreateNpcs");
-    if (!lua_isfunction(L, -1)) {
-        char buffer[512];
-        int type = lua_type(L, -1);
-        sprintf_s(buffer, "ERROR: merlinCreateNpcs is not a function (type=%s)\n",
-                  lua_typename(L, type));
-        wi::backlog::post(buffer);
-        lua_pop(L, 1);
+    if (!PushBridge(BRIDGE_CREATE_NPCS)) {
+        wi::backlog::post("ERROR: merlinCreateNpcs is not a function\n");
         return;
     }
 
@@ -302,181 +595,2286 @@ void MerlinLua::CreateNpcs(const std::vector<XMFLOAT3> &spawnPoints,
               spawnPoints.size(), npcModelPaths.size(), waypointPositions.size());
     wi::backlog::post(buffer);
 
-    if (lua_pcall(L, 3, 0, 0) != LUA_OK) {
-        const char *error_msg = lua_tostring(L, -1);
-        sprintf_s(buffer, "ERROR: merlinCreateNpcs() failed: %s\n",
-                  error_msg ? error_msg : "unknown error");
-        wi::backlog::post(buffer);
-        lua_pop(L, 1);
-    } else {
+    if (CallBridge(BRIDGE_CREATE_NPCS, 3, 0)) {
         sprintf_s(buffer,
                   "Merlin NPCs created successfully at %zu spawn points with %zu waypoints\n",
                   spawnPoints.size(), waypointPositions.size());
         wi::backlog::post(buffer);
+
+        // A cold-started world is now complete enough to save for the next launch
+        if (warmStarted) {
+            sprintf_s(buffer, "Merlin world ready %.0f ms after Initialize (warm start)\n",
+                      SteadyNowMs() - initStartMs);
+            wi::backlog::post(buffer);
+        } else if (!warmStartDir.empty() && !recordFile) {
+            SaveWarmStart();
+        }
     }
 }
 
-std::vector<NpcState> MerlinLua::GetNpcStates() {
-    std::vector<NpcState> states;
+std::span<const NpcState> MerlinLua::GetNpcStates() {
+    if (L) {
+        if (IsAsyncSimulation()) {
+            // Apply the worker's latest snapshot if it hasn't been yet. Never waits; sync points
+            // also consume snapshots, so no tick's deltas are ever skipped.
+            ConsumeNpcSnapshot();
+        } else if (ReadNpcStates(npcStateBuffer, npcResyncRequested)) {
+            npcResyncRequested = false;
+            ApplyNpcDeltas(npcStateBuffer);
+        }
+    }
+    removedNpcs.swap(pendingRemovedNpcs);
+    pendingRemovedNpcs.clear();
+
+    // NPCs that moved in the latest tick are shown between their previous and latest position;
+    // everyone else is at rest at their latest position
+    float alpha = std::clamp(mirrorTickAlpha, 0.0f, 1.0f);
+    for (size_t i = 0; i < npcMirror.size(); i++) {
+        const NpcMotion &motion = npcMotion[i];
+        float t = motion.latestTick == mirrorTick ? alpha : 1.0f;
+        npcMirror[i].x = motion.previous.x + (motion.latest.x - motion.previous.x) * t;
+        npcMirror[i].y = motion.previous.y + (motion.latest.y - motion.previous.y) * t;
+        npcMirror[i].z = motion.previous.z + (motion.latest.z - motion.previous.z) * t;
+    }
 
-    if (!L) {
-        return states;
+    return npcMirror;
+}
+
+void MerlinLua::ApplyNpcDeltas(const EntitySyncBuffer &buffer) {
+    if (buffer.flags & SYNC_FULL) {
+        mirrorGeneration++;
+        mirrorSweepPending = true;
     }
+    mirrorTick = buffer.tick;
+    mirrorTickAlpha = buffer.tickAlpha;
+
+    // uint64 IDs come through with exact bits intact
+    for (int i = 0; i < buffer.count; i++) {
+        const EntitySyncEntry &entry = buffer.entries[i];
+        auto it = npcMirrorIndex.find(entry.merlinId);
+
+        if (entry.flags & SYNC_REMOVED) {
+            if (it != npcMirrorIndex.end())
+                RemoveMirrorNpc(it->second);
+            continue;
+        }
 
-    // Trigger Lua to fill the shared npcStateBuffer (no data through the Lua stack)
-    lua_getglobal(L, "merlinGetNpcStates");
-    if (!lua_isfunction(L, -1)) {
-        lua_pop(L, 1);
-        return states;
+        XMFLOAT3 position(entry.x, entry.y, entry.z);
+        if (it == npcMirrorIndex.end()) {
+            NpcState state;
+            state.merlinId = entry.merlinId;
+            state.modelIndex = entry.modelIndex;
+            npcMirrorIndex[entry.merlinId] = npcMirror.size();
+            npcMirror.push_back(state);
+            NpcMotion motion;
+            motion.previous = position;
+            motion.latestTick = buffer.tick;
+            npcMotion.push_back(motion);
+            it = npcMirrorIndex.find(entry.merlinId);
+        } else if (entry.flags & SYNC_SPAWNED) {
+            npcMirror[it->second].modelIndex = entry.modelIndex;
+        }
+
+        // On a new tick the latest position becomes the previous one. Within a tick only the
+        // latest is refreshed (position feedback can move entities between ticks).
+        NpcMotion &motion = npcMotion[it->second];
+        if (motion.latestTick != buffer.tick)
+            motion.previous = motion.latest;
+        motion.latest = position;
+        motion.latestTick = buffer.tick;
+        motion.generation = mirrorGeneration;
+        npcMirror[it->second].version = entry.version;
     }
 
-    if (lua_pcall(L, 0, 0, 0) != LUA_OK) {
-        const char *error_msg = lua_tostring(L, -1);
+    // A full sync lists every NPC: anything it didn't mention is gone. If it overflowed, the rest
+    // arrives in the following fills, so wait for the first fill that sent everything.
+    if (mirrorSweepPending && buffer.unsent == 0) {
+        mirrorSweepPending = false;
+        for (size_t i = npcMirror.size(); i-- > 0;) {
+            if (npcMotion[i].generation != mirrorGeneration)
+                RemoveMirrorNpc(i);
+        }
+    }
+}
+
+void MerlinLua::RemoveMirrorNpc(size_t index) {
+    uint64_t merlinId = npcMirror[index].merlinId;
+    pendingRemovedNpcs.push_back(merlinId);
+    npcMirrorIndex.erase(merlinId);
+
+    // Swap-and-pop keeps the mirror dense
+    size_t last = npcMirror.size() - 1;
+    if (index != last) {
+        npcMirror[index] = std::move(npcMirror[last]);
+        npcMotion[index] = npcMotion[last];
+        npcMirrorIndex[npcMirror[index].merlinId] = index;
+    }
+    npcMirror.pop_back();
+    npcMotion.pop_back();
+}
+
+MerlinSyncStats MerlinLua::GetSyncStats() const {
+    MerlinSyncStats stats = IsAsyncSimulation() ? syncedSyncStats : syncStats;
+    stats.entriesDropped = syncEntriesDropped;
+    return stats;
+}
+
+const char *MerlinLua::GetModelPath(uint8_t modelIndex) const {
+    // Entries are appended before any delta refers to them and never change afterwards, so
+    // this is safe while the worker thread interns new paths
+    if (modelIndex >= MODEL_PATH_CAPACITY)
+        return nullptr;
+    return modelPathTable.paths[modelIndex];
+}
+
+uint8_t MerlinLua::InternModelPath(const char *path) {
+    for (int i = 0; i < modelPathTable.count; i++) {
+        if (strcmp(modelPathTable.paths[i], path) == 0)
+            return static_cast<uint8_t>(i);
+    }
+    if (modelPathTable.count >= MODEL_PATH_CAPACITY) {
         char buffer[512];
-        sprintf_s(buffer, "ERROR: merlinGetNpcStates() failed: %s\n",
-                  error_msg ? error_msg : "unknown error");
+        sprintf_s(buffer, "WARNING: Model path table full, NPCs using %s will not be rendered\n",
+                  path);
         wi::backlog::post(buffer);
-        lua_pop(L, 1);
-        return states;
+        return NO_MODEL;
+    }
+    int index = modelPathTable.count;
+    strncpy_s(modelPathTable.paths[index], path, _TRUNCATE);
+    modelPathTable.count = index + 1;
+    return static_cast<uint8_t>(index);
+}
+
+void MerlinLua::ConsumeNpcSnapshot() {
+    if (!(readySnapshot.load(std::memory_order_relaxed) & kSnapshotFresh))
+        return;
+    int ready = readySnapshot.exchange(frontSnapshot, std::memory_order_acq_rel);
+    frontSnapshot = ready & ~kSnapshotFresh;
+    ApplyNpcDeltas(npcStateSnapshots[frontSnapshot]);
+}
+
+bool MerlinLua::CallGetNpcStates(EntitySyncBuffer &buffer, bool fullSync) {
+    // Trigger Lua to fill the given buffer with deltas (no data through the Lua stack)
+    if (!PushBridge(BRIDGE_GET_NPC_STATES))
+        return false;
+
+    lua_pushlightuserdata(L, &buffer);
+    lua_pushboolean(L, fullSync);
+    return CallBridge(BRIDGE_GET_NPC_STATES, 2, 0);
+}
+
+bool MerlinLua::ReadNpcStates(EntitySyncStorage &buffer, bool fullSync) {
+    buffer.Reserve(npcSyncCapacity);
+    if (HasBatchSync()) {
+        ReadNpcStatesNative(buffer, fullSync);
+    } else if (!CallGetNpcStates(buffer, fullSync)) {
+        return false;
+    }
+
+    if (recordFile || replaying) {
+        stateHash = HashNpcDeltas(stateHash, buffer);
+        if (recordFile) {
+            RecordValue(recordEvent, (uint8_t)fullSync);
+            RecordValue(recordEvent, stateHash);
+            WriteRecordEvent(REC_NPC_STATES);
+        }
     }
 
-    // Read from the shared buffer — uint64 IDs come through with exact bits intact
-    states.reserve(npcStateBuffer.count);
-    for (int i = 0; i < npcStateBuffer.count; i++) {
-        NpcState state;
-        state.merlinId = npcStateBuffer.entries[i].merlinId;
-        state.x = npcStateBuffer.entries[i].x;
-        state.y = npcStateBuffer.entries[i].y;
-        state.z = npcStateBuffer.entries[i].z;
-        state.modelPath = npcStateBuffer.entries[i].modelPath;
-        states.push_back(state);
+    // Whatever didn't fit is reported again by the next fill; grow so it fits then
+    if (buffer.unsent > 0) {
+        syncStats.npcOverflowFills++;
+        syncStats.npcEntriesDeferred += buffer.unsent;
+        int wanted = std::min(std::max(npcSyncCapacity * 2, buffer.count + buffer.unsent),
+                              kMaxSyncCapacity);
+        if (wanted > npcSyncCapacity) {
+            char text[256];
+            sprintf_s(text, "Merlin NPC sync buffer full (%d entries deferred), growing %d -> %d\n",
+                      buffer.unsent, npcSyncCapacity, wanted);
+            wi::backlog::post(text);
+            npcSyncCapacity = wanted;
+            syncStats.npcCapacity = wanted;
+        }
     }
+    return true;
+}
 
-    return states;
+const std::vector<uint64_t> &MerlinLua::Roster() {
+    if (!HasVersionedRoster()) {
+        MerlinSymbolArray npcArray = npcs();
+        roster.assign(npcArray.buffer, npcArray.buffer + npcArray.size);
+        return roster;
+    }
+    uint32_t version = rosterVersion();
+    if (rosterValid && version == rosterSeenVersion)
+        return roster;
+    roster.resize(rosterNpcs(nullptr, 0));
+    rosterNpcs(roster.data(), (int)roster.size());
+    rosterSeenVersion = version;
+    rosterValid = true;
+    return roster;
 }
 
-void MerlinLua::BeginPositionFeedback() { posFeedbackBuffer.count = 0; }
+void MerlinLua::ReadNpcStatesNative(EntitySyncBuffer &buffer, bool fullSync) {
+    // Same deltas as merlinGetNpcStates, with one batched position query instead of per-NPC FFI
+    // calls from Lua
+    if (fullSync)
+        nativeSentNpcs.clear();
+    uint32_t stamp = ++nativeSentStamp;
+
+    const std::vector<uint64_t> &npcIds = Roster();
+    int npcCount = (int)npcIds.size();
+    batchPositions.resize(npcCount);
+    worldPositions(npcIds.data(), batchPositions.data(), npcCount);
+
+    int count = 0;
+    int unsent = 0;
+    for (int i = 0; i < npcCount; i++) {
+        uint64_t merlinId = npcIds[i];
+        XMFLOAT3 position(batchPositions[i].floats[0], batchPositions[i].floats[1],
+                          batchPositions[i].floats[2]);
+        auto [it, spawned] = nativeSentNpcs.try_emplace(merlinId);
+        SentNpc &sent = it->second;
+        sent.seenStamp = stamp;
+
+        float dx = position.x - sent.position.x;
+        float dy = position.y - sent.position.y;
+        float dz = position.z - sent.position.z;
+        bool moved = dx * dx + dy * dy + dz * dz > kNpcMoveEpsilonSq;
+        if (!spawned && !moved)
+            continue;
+        if (count >= buffer.capacity) {
+            // No room: leave it unsent so it is reported again by the next fill
+            if (spawned)
+                nativeSentNpcs.erase(it);
+            unsent++;
+            continue;
+        }
 
-void MerlinLua::AddPositionFeedback(uint64_t merlinId, const XMFLOAT3 &position) {
-    if (posFeedbackBuffer.count >= EntitySyncBuffer::CAPACITY)
+        sent.position = position;
+        sent.version++;
+        EntitySyncEntry &entry = buffer.entries[count++];
+        entry.merlinId = merlinId;
+        entry.x = position.x;
+        entry.y = position.y;
+        entry.z = position.z;
+        entry.version = sent.version;
+        entry.flags = spawned ? SYNC_SPAWNED : SYNC_MOVED;
+        entry.modelIndex = NO_MODEL;
+        if (spawned) {
+            // Model path symbols are interned once; after that a spawn is a map lookup
+            uint64_t modelPathAttr = attrSymbol(merlinId, "modelPath");
+            if (modelPathAttr != 0) {
+                auto [model, added] = nativeModelIndex.try_emplace(modelPathAttr);
+                if (added)
+                    model->second = InternModelPath(toString(modelPathAttr).buffer);
+                entry.modelIndex = model->second;
+            }
+        }
+    }
+
+    // Tombstones for NPCs that have left the roster since the last fill
+    for (auto it = nativeSentNpcs.begin(); it != nativeSentNpcs.end();) {
+        if (it->second.seenStamp == stamp) {
+            ++it;
+            continue;
+        }
+        if (count >= buffer.capacity) {
+            unsent++;
+            ++it;
+            continue;
+        }
+        EntitySyncEntry &entry = buffer.entries[count++];
+        entry.merlinId = it->first;
+        entry.version = static_cast<uint16_t>(it->second.version + 1);
+        entry.flags = SYNC_REMOVED;
+        entry.modelIndex = NO_MODEL;
+        it = nativeSentNpcs.erase(it);
+    }
+
+    buffer.count = count;
+    buffer.unsent = unsent;
+    buffer.flags = fullSync ? SYNC_FULL : 0;
+    buffer.tick = simTick;
+    buffer.tickAlpha = simTickAlpha;
+}
+
+void MerlinLua::WritePosFeedback() {
+    if (recordFile) {
+        RecordValue(recordEvent, posFeedbackBuffer.count);
+        for (int i = 0; i < posFeedbackBuffer.count; i++) {
+            const EntitySyncEntry &entry = posFeedbackBuffer.entries[i];
+            RecordValue(recordEvent, entry.merlinId);
+            RecordValue(recordEvent, XMFLOAT3(entry.x, entry.y, entry.z));
+        }
+        WriteRecordEvent(REC_POS_FEEDBACK);
+    }
+
+    if (HasBatchSync()) {
+        WritePosFeedbackNative();
         return;
+    }
+    CallApplyPosFeedback();
+}
+
+void MerlinLua::WritePosFeedbackNative() {
+    // Same effect as merlinApplyPosFeedback: move each entity, keeping its size and orientation
+    int count = posFeedbackBuffer.count;
+    batchIds.resize(count);
+    batchPositions.resize(count);
+    for (int i = 0; i < count; i++) {
+        const EntitySyncEntry &entry = posFeedbackBuffer.entries[i];
+        batchIds[i] = entry.merlinId;
+        batchPositions[i] = {entry.x, entry.y, entry.z};
+    }
+    setWorldPositions(batchIds.data(), batchPositions.data(), count);
+}
+
+void MerlinLua::BeginPositionFeedback() { FeedbackBuffer().count = 0; }
+
+void MerlinLua::AddPositionFeedback(uint64_t merlinId, const XMFLOAT3 &position) {
+    EntitySyncStorage &feedback = FeedbackBuffer();
+    if (feedback.count >= feedback.capacity) {
+        if (feedback.capacity >= kMaxSyncCapacity) {
+            syncEntriesDropped++;
+            return;
+        }
+        feedback.Reserve(std::min(feedback.capacity * 2, kMaxSyncCapacity));
+    }
 
-    int idx = posFeedbackBuffer.count++;
-    posFeedbackBuffer.entries[idx].merlinId = merlinId;
-    posFeedbackBuffer.entries[idx].x = position.x;
-    posFeedbackBuffer.entries[idx].y = position.y;
-    posFeedbackBuffer.entries[idx].z = position.z;
+    int idx = feedback.count++;
+    feedback.entries[idx].merlinId = merlinId;
+    feedback.entries[idx].x = position.x;
+    feedback.entries[idx].y = position.y;
+    feedback.entries[idx].z = position.z;
 }
 
 void MerlinLua::ApplyPositionFeedback() {
-    if (!L || posFeedbackBuffer.count == 0)
+    // In async mode the staged feedback is handed to the worker at the next sync point
+    if (!L || IsAsyncSimulation() || posFeedbackBuffer.count == 0)
         return;
 
+    WritePosFeedback();
+}
+
+void MerlinLua::CallApplyPosFeedback() {
     // Trigger Lua to read the posFeedbackBuffer and apply positions to Merlin entities
-    lua_getglobal(L, "merlinApplyPosFeedback");
-    if (!lua_isfunction(L, -1)) {
-        lua_pop(L, 1);
-        return;
-    }
+    if (PushBridge(BRIDGE_APPLY_POS_FEEDBACK))
+        CallBridge(BRIDGE_APPLY_POS_FEEDBACK, 0, 0);
+}
 
-    if (lua_pcall(L, 0, 0, 0) != LUA_OK) {
-        const char *error_msg = lua_tostring(L, -1);
-        char buffer[512];
-        sprintf_s(buffer, "ERROR: merlinApplyPosFeedback() failed: %s\n",
-                  error_msg ? error_msg : "unknown error");
-        wi::backlog::post(buffer);
-        lua_pop(L, 1);
+void MerlinLua::BeginSimTiers() {
+    SimTierStorage &tiers = TierBuffer();
+    simTiersPrevCount = tiers.count;
+    simTiersChanged = false;
+    tiers.count = 0;
+}
+
+void MerlinLua::AddSimTier(uint64_t merlinId, int tier) {
+    SimTierStorage &tiers = TierBuffer();
+    if (tiers.count >= tiers.capacity) {
+        if (tiers.capacity >= kMaxSyncCapacity) {
+            syncEntriesDropped++;
+            return;
+        }
+        tiers.Reserve(std::min(tiers.capacity * 2, kMaxSyncCapacity));
     }
+
+    int idx = tiers.count++;
+    SimTierEntry &entry = tiers.entries[idx];
+    if (idx >= simTiersPrevCount || entry.merlinId != merlinId || entry.tier != tier)
+        simTiersChanged = true;
+    entry.merlinId = merlinId;
+    entry.tier = tier;
 }
 
-void MerlinLua::Update(float dt) {
-    if (!L) {
+void MerlinLua::CommitSimTiers() {
+    SimTierStorage &tiers = TierBuffer();
+    if (!simTiersChanged && tiers.count == simTiersPrevCount)
+        return; // the game resent the same tiers
+    // In async mode the staged tiers are handed to the worker at the next sync point
+    tiers.version++;
+    if (recordFile && !IsAsyncSimulation())
+        RecordSimTiers();
+}
+
+void MerlinLua::SetSimLodIntervals(int ringInterval, int backgroundInterval) {
+    if (!L || IsAsyncSimulation())
         return;
+
+    if (recordFile) {
+        RecordValue(recordEvent, ringInterval);
+        RecordValue(recordEvent, backgroundInterval);
+        WriteRecordEvent(REC_SIM_LOD);
     }
 
-    // Call merlinUpdate(dt) each frame
-    lua_getglobal(L, "merlinUpdate");
-    if (!lua_isfunction(L, -1)) {
-        lua_pop(L, 1);
+    if (!PushBridge(BRIDGE_SET_SIM_LOD))
+        return;
+
+    lua_pushinteger(L, ringInterval);
+    lua_pushinteger(L, backgroundInterval);
+    CallBridge(BRIDGE_SET_SIM_LOD, 2, 0);
+}
+
+void MerlinLua::SetSimTickRate(float ticksPerSecond, int maxCatchUpTicks) {
+    if (!L || IsAsyncSimulation())
         return;
+
+    if (recordFile) {
+        RecordValue(recordEvent, ticksPerSecond);
+        RecordValue(recordEvent, maxCatchUpTicks);
+        WriteRecordEvent(REC_TICK_RATE);
     }
 
-    lua_pushnumber(L, dt);
+    if (!PushBridge(BRIDGE_SET_TICK_RATE))
+        return;
 
-    if (lua_pcall(L, 1, 0, 0) != LUA_OK) {
-        const char *error_msg = lua_tostring(L, -1);
-        char buffer[512];
-        sprintf_s(buffer, "ERROR: merlinUpdate() failed: %s\n",
-                  error_msg ? error_msg : "unknown error");
-        wi::backlog::post(buffer);
-        lua_pop(L, 1);
+    lua_pushnumber(L, ticksPerSecond);
+    lua_pushinteger(L, maxCatchUpTicks);
+    if (!CallBridge(BRIDGE_SET_TICK_RATE, 2, 0))
+        return;
+
+    char buffer[256];
+    if (ticksPerSecond > 0.0f) {
+        sprintf_s(buffer, "Merlin simulation ticking at %.1f Hz (catch-up cap %d ticks/frame)\n",
+                  ticksPerSecond, maxCatchUpTicks);
+    } else {
+        sprintf_s(buffer, "Merlin simulation ticking once per frame\n");
     }
+    wi::backlog::post(buffer);
 }
 
-void MerlinLua::Shutdown() {
+void MerlinLua::Update(float dt) {
     if (!L) {
         return;
     }
 
-    // Call merlinShutdown() to cleanly stop the simulation
-    lua_getglobal(L, "merlinShutdown");
-    if (lua_isfunction(L, -1)) {
-        if (lua_pcall(L, 0, 0, 0) != LUA_OK) {
-            const char *error_msg = lua_tostring(L, -1);
-            char buffer[512];
-            sprintf_s(buffer, "WARNING: merlinShutdown() failed: %s\n",
-                      error_msg ? error_msg : "unknown error");
-            wi::backlog::post(buffer);
-            lua_pop(L, 1);
-        }
-    } else {
-        lua_pop(L, 1);
+    if (IsAsyncSimulation()) {
+        pendingDt += dt;
+        // Worker still busy with the previous tick: keep accumulating, don't block the frame
+        if (simTickInFlight.load(std::memory_order_acquire))
+            return;
+        AsyncSyncPoint();
+        return;
     }
 
-    // Close Lua state
-    lua_close(L);
-    L = nullptr;
-
-    wi::backlog::post("Merlin Lua subsystem shut down\n");
+    aiProfileBuffer.intervalMs = aiProfileIntervalMs;
+    if (aiProfileIntervalMs > 0.0f)
+        CountActionTraffic();
+    if (recordFile)
+        RecordActionOutcomes();
+    CallUpdate(dt);
+    CollectAiProfile();
+    StepGarbageCollector();
 }
 
-uint16_t MerlinLua::QueryHstr(const char *str) {
-    if (!queryHstr) {
-        wi::backlog::post("ERROR: queryHstr function not loaded from Merlin.dll\n");
-        return 0;
+void MerlinLua::CallUpdate(float dt) {
+    if (recordFile) {
+        RecordValue(recordEvent, dt);
+        RecordValue(recordEvent, frameBudgetMs);
+        WriteRecordEvent(REC_UPDATE);
     }
-    return queryHstr(str);
-}
 
-std::vector<uint64_t> MerlinLua::GetWaypointSymbols() {
-    std::vector<uint64_t> symbols;
-    if (!L)
-        return symbols;
+    // Call merlinUpdate(dt, budgetMs) each frame
+    if (!PushBridge(BRIDGE_UPDATE))
+        return;
 
-    // waypointBuffer is already filled by createRootNpcs (via FFI)
-    symbols.reserve(waypointBuffer.count);
-    for (int i = 0; i < waypointBuffer.count; i++) {
-        symbols.push_back(waypointBuffer.entries[i].merlinId);
+    lua_pushnumber(L, dt);
+    lua_pushnumber(L, frameBudgetMs);
+    if (!CallBridge(BRIDGE_UPDATE, 2, 5))
+        return;
+
+    // merlinUpdate returns (cyclesCompleted, suspended, ticksDropped, tick, tickAlpha)
+    int cyclesCompleted = (int)lua_tointeger(L, -5);
+    bool suspended = lua_toboolean(L, -4);
+    int ticksDropped = (int)lua_tointeger(L, -3);
+    simTick = (uint32_t)lua_tointeger(L, -2);
+    simTickAlpha = (float)lua_tonumber(L, -1);
+    lua_pop(L, 5);
+
+    float frameMs = (float)bridgeStats[BRIDGE_UPDATE].lastMs;
+    budgetStats.frames++;
+    budgetStats.cyclesCompleted += cyclesCompleted;
+    budgetStats.ticksDropped += ticksDropped;
+    budgetStats.lastFrameMs = frameMs;
+    budgetStats.maxFrameMs = std::max(budgetStats.maxFrameMs, frameMs);
+    if (suspended)
+        budgetStats.framesSuspended++;
+    if (frameBudgetMs > 0.0f && frameMs > frameBudgetMs) {
+        budgetStats.overruns++;
+        budgetStats.worstOverrunMs = std::max(budgetStats.worstOverrunMs, frameMs - frameBudgetMs);
     }
+}
 
-    return symbols;
+// ---------------------------------------------------------------------------
+// Lua garbage collector pacing
+// ---------------------------------------------------------------------------
+
+static double LuaHeapKb(lua_State *L) {
+    return lua_gc(L, LUA_GCCOUNT, 0) + lua_gc(L, LUA_GCCOUNTB, 0) / 1024.0;
 }
 
-bool MerlinLua::LoadMerlinCInterface() {
-    // Load Merlin.dll (should already be loaded by Lua, but get handle)
-    HMODULE merlinDll = GetModuleHandleA("Merlin.dll");
-    if (!merlinDll) {
-        wi::backlog::post("ERROR: Merlin.dll not loaded\n");
-        return false;
-    }
+void MerlinLua::SetGcBudget(float milliseconds) {
+    gcBudgetMs = std::max(0.0f, milliseconds);
+    if (!L)
+        return;
 
-    // Load CInterface functions
-    worldPos = (WorldPosFn)GetProcAddress(merlinDll, "worldPos");
-    queryHstr = (QueryHstrFn)GetProcAddress(merlinDll, "queryHstr");
-    registerForeignActionCommandBuffer =
-        (RegisterBufferFn)GetProcAddress(merlinDll, "registerForeignActionCommandBuffer");
-    unregisterForeignActionCommandBuffer =
-        (UnregisterBufferFn)GetProcAddress(merlinDll, "unregisterForeignActionCommandBuffer");
+    if (recordFile) {
+        RecordValue(recordEvent, gcBudgetMs);
+        WriteRecordEvent(REC_GC_BUDGET);
+    }
+
+    if (gcBudgetMs <= 0.0f) {
+        lua_gc(L, LUA_GCRESTART, 0);
+        return;
+    }
+
+    // Start from a clean heap (loading leaves plenty of garbage), then take over from the
+    // automatic collector
+    lua_gc(L, LUA_GCCOLLECT, 0);
+    lua_gc(L, LUA_GCSTOP, 0);
+    gcStats.heapKb = gcStats.heapAfterCycleKb = LuaHeapKb(L);
+
+    char buffer[256];
+    sprintf_s(buffer, "Merlin Lua GC paced at %.2f ms/frame (heap %.0f KB)\n", gcBudgetMs,
+              gcStats.heapKb);
+    wi::backlog::post(buffer);
+}
+
+void MerlinLua::StepGarbageCollector() {
+    if (gcBudgetMs <= 0.0f)
+        return;
+
+    auto range = wi::profiler::BeginRange("Merlin Lua GC", wi::profiler::DOMAIN_CPU);
+    auto startTime = std::chrono::high_resolution_clock::now();
+    auto elapsedMs = [&startTime] {
+        auto now = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double, std::milli>(now - startTime).count();
+    };
+
+    // Step until the budget is spent or a cycle finishes. Past the heap limit the budget is
+    // ignored until the cycle in progress is done, so memory stays bounded.
+    double heapLimitKb = std::max(2.0 * gcStats.heapAfterCycleKb, double(kGcMinHeapLimitKb));
+    bool forced = false;
+    for (;;) {
+        if (lua_gc(L, LUA_GCSTEP, kGcStepKb)) {
+            gcStats.cycles++;
+            gcStats.heapAfterCycleKb = LuaHeapKb(L);
+            break;
+        }
+        if (elapsedMs() < gcBudgetMs)
+            continue;
+        if (LuaHeapKb(L) <= heapLimitKb)
+            break;
+        forced = true;
+    }
+    // A step re-arms Lua's allocation threshold; keep the automatic collector off
+    lua_gc(L, LUA_GCSTOP, 0);
+
+    double ms = elapsedMs();
+    wi::profiler::EndRange(range);
+    gcStats.heapKb = LuaHeapKb(L);
+    gcStats.frames++;
+    gcStats.lastMs = ms;
+    gcStats.maxMs = std::max(gcStats.maxMs, ms);
+    gcStats.totalMs += ms;
+    if (forced)
+        gcStats.forcedFrames++;
+}
+
+// ---------------------------------------------------------------------------
+// AI profiler
+// ---------------------------------------------------------------------------
+
+void MerlinLua::CountActionTraffic() {
+    // Called once Merlin's commands and the game's outcomes have both landed in the game-side
+    // buffers: a command that wasn't there at the last count is new, and so is an outcome that
+    // appeared on a command since
+    static_assert(kActionMotors == ForeignActionCommandBuffer::NUM_MOTORS,
+                  "ActionBufferSlot::seen must cover every motor");
+    int active = 0;
+    for (auto &[merlinId, slot] : actionBuffers) {
+        if (!slot.gameBuffer)
+            continue;
+        for (int motor = 0; motor < kActionMotors; motor++) {
+            const ForeignActionCommand &cmd = slot.gameBuffer->commands[motor];
+            ActionMotorSeen &seen = slot.seen[motor];
+            bool sameCommand =
+                seen.actionLabelHstr == cmd.actionLabelHstr && seen.target == cmd.target;
+            if (cmd.active && (!seen.active || !sameCommand))
+                actionCommandsIssued++;
+            if (cmd.outcome != ACTION_OUTCOME_NONE &&
+                (seen.outcome == ACTION_OUTCOME_NONE || !sameCommand)) {
+                actionOutcomesReported++;
+                if (cmd.outcome != ACTION_OUTCOME_SUCCESS)
+                    actionFailuresReported++;
+            }
+            if (cmd.active)
+                active++;
+            seen = {cmd.actionLabelHstr, cmd.target, cmd.active, cmd.outcome};
+        }
+    }
+    actionCommandsActive = active;
+}
+
+void MerlinLua::CollectAiProfile() {
+    if (aiProfileBuffer.sample == aiProfile.last.sample)
+        return;
+    aiProfile.last = aiProfileBuffer;
+    aiProfile.samples++;
+
+    for (int i = 0; i < aiProfileBuffer.ruleCount; i++) {
+        const AiRuleSample &sample = aiProfileBuffer.rules[i];
+        auto [it, added] = aiRuleIndex.try_emplace(sample.name, aiProfile.rules.size());
+        if (added)
+            aiProfile.rules.push_back({sample.name});
+        MerlinAiRuleStats &rule = aiProfile.rules[it->second];
+        rule.fires += sample.fires;
+        rule.ms += sample.ms;
+        rule.samples++;
+    }
+    std::sort(aiProfile.rules.begin(), aiProfile.rules.end(),
+              [](const MerlinAiRuleStats &a, const MerlinAiRuleStats &b) { return a.ms > b.ms; });
+    for (size_t i = 0; i < aiProfile.rules.size(); i++)
+        aiRuleIndex[aiProfile.rules[i].name] = i;
+
+    // Action traffic since the previous sample
+    double nowMs = std::chrono::duration<double, std::milli>(
+                       std::chrono::steady_clock::now().time_since_epoch())
+                       .count();
+    std::array<uint64_t, 3> traffic = {actionCommandsIssued, actionOutcomesReported,
+                                       actionFailuresReported};
+    double seconds = (nowMs - aiProfileSampleMs) / 1000.0;
+    if (aiProfileSampleMs > 0.0 && seconds > 0.0) {
+        aiProfile.commandsPerSec = (float)((traffic[0] - sampledActionTraffic[0]) / seconds);
+        aiProfile.outcomesPerSec = (float)((traffic[1] - sampledActionTraffic[1]) / seconds);
+        aiProfile.failuresPerSec = (float)((traffic[2] - sampledActionTraffic[2]) / seconds);
+    }
+    sampledActionTraffic = traffic;
+    aiProfileSampleMs = nowMs;
+    aiProfile.activeCommands = actionCommandsActive;
+    aiProfile.actionBuffers = (int)actionBuffers.size();
+}
+
+// ---------------------------------------------------------------------------
+// Pool telemetry
+// ---------------------------------------------------------------------------
+
+std::vector<MerlinLua::MerlinPoolStats> MerlinLua::ReadPoolStats() {
+    std::vector<MerlinPoolStats> pools;
+    if (!poolStats)
+        return pools;
+    pools.resize(poolStats(nullptr, 0));
+    pools.resize(std::min((size_t)poolStats(pools.data(), (int)pools.size()), pools.size()));
+    return pools;
+}
+
+// One line per pool, in MerlinLimits.txt order, after a short header:
+//   name  max  init-reserved  growth-stride  instances  current  peak  growths
+bool MerlinLua::WritePoolTelemetry(const std::string &path) {
+    std::vector<MerlinPoolStats> pools = ReadPoolStats();
+    if (pools.empty())
+        return false;
+    FILE *file = fopen(path.c_str(), "w");
+    if (!file) {
+        char text[512];
+        sprintf_s(text, "ERROR: Cannot write Merlin pool telemetry to %s\n", path.c_str());
+        wi::backlog::post(text);
+        return false;
+    }
+
+    time_t now = time(nullptr);
+    char stamp[32];
+    strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", localtime(&now));
+    fprintf(file, "# Merlin pool telemetry, merged into MerlinLimits.txt by limitstuner.lua\n");
+    fprintf(file, "session = %s\n", stamp);
+    fprintf(file, "frames = %llu\n", (unsigned long long)budgetStats.frames);
+    fprintf(file, "# %-34s %8s %8s %8s %9s %10s %8s %8s\n", "pool", "max", "reserved", "stride",
+            "instances", "current", "peak", "growths");
+    for (const MerlinPoolStats &pool : pools) {
+        fprintf(file, "%-36s %8u %8u %8u %9u %10llu %8u %8u\n", pool.name, pool.maxItems,
+                pool.initReserved, pool.growthStride, pool.instances,
+                (unsigned long long)pool.current, pool.peak, pool.growths);
+    }
+    fclose(file);
+
+    char text[512];
+    sprintf_s(text, "Merlin pool telemetry written to %s (%zu pools)\n", path.c_str(),
+              pools.size());
+    wi::backlog::post(text);
+    return true;
+}
+
+void MerlinLua::ReportPoolStats() {
+    std::vector<MerlinPoolStats> pools = ReadPoolStats();
+    for (const MerlinPoolStats &pool : pools) {
+        if (pool.growths == 0 && pool.peak < pool.maxItems)
+            continue;
+        char text[256];
+        sprintf_s(text,
+                  "Merlin pool %s: peak %u of %u reserved (max %u), grew %u times across %u "
+                  "instances\n",
+                  pool.name, pool.peak, pool.initReserved, pool.maxItems, pool.growths,
+                  pool.instances);
+        wi::backlog::post(text);
+    }
+
+    if (poolTelemetryDir.empty() || pools.empty())
+        return;
+    std::error_code error;
+    std::filesystem::create_directories(poolTelemetryDir, error);
+    time_t now = time(nullptr);
+    char name[64];
+    strftime(name, sizeof(name), "pools_%Y%m%d_%H%M%S.txt", localtime(&now));
+    WritePoolTelemetry((std::filesystem::path(poolTelemetryDir) / name).string());
+}
+
+// ---------------------------------------------------------------------------
+// Warm start
+// ---------------------------------------------------------------------------
+
+// Warm-start file: this header, the Lua state from merlinWarmState, then Merlin's snapshot at an
+// offset aligned for mapping, so Merlin can use it in place
+static constexpr char kWarmStartMagic[4] = {'M', 'W', 'R', 'M'};
+static constexpr uint32_t kWarmStartVersion = 1;
+static constexpr uint64_t kWarmStartAlign = 65536; // allocation granularity on Windows
+struct WarmStartHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t key;
+    uint64_t stateOffset;
+    uint64_t stateSize;
+    uint64_t snapshotOffset;
+    uint64_t snapshotSize;
+};
+
+// Map a whole file read-only; nullptr if it can't be. mapping receives the handle to close
+// (Windows only).
+static const void *MapFileReadOnly(const std::string &path, uint64_t &size, void *&mapping) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return nullptr;
+    LARGE_INTEGER fileSize = {};
+    HANDLE fileMapping = nullptr;
+    if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0)
+        fileMapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file); // the mapping keeps the file open
+    if (!fileMapping)
+        return nullptr;
+    const void *view = MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        CloseHandle(fileMapping);
+        return nullptr;
+    }
+    size = (uint64_t)fileSize.QuadPart;
+    mapping = fileMapping;
+    return view;
+#else
+    int file = open(path.c_str(), O_RDONLY);
+    if (file < 0)
+        return nullptr;
+    struct stat info = {};
+    void *view = MAP_FAILED;
+    if (fstat(file, &info) == 0 && info.st_size > 0)
+        view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file); // the mapping keeps the file open
+    if (view == MAP_FAILED)
+        return nullptr;
+    size = (uint64_t)info.st_size;
+    mapping = nullptr;
+    return view;
+#endif
+}
+
+// Undo MapFileReadOnly (nothing if view is nullptr), resetting the arguments
+static void UnmapFile(const void *&view, uint64_t &size, void *&mapping) {
+    if (!view)
+        return;
+#ifdef _WIN32
+    UnmapViewOfFile(view);
+    CloseHandle((HANDLE)mapping);
+#else
+    munmap(const_cast<void *>(view), (size_t)size);
+#endif
+    view = nullptr;
+    size = 0;
+    mapping = nullptr;
+}
+
+void MerlinLua::SetWarmStart(const std::string &dir, const std::vector<std::string> &keyFiles,
+                             const std::string &keyText) {
+    warmStartDir = dir;
+    warmStartKeyFiles = keyFiles;
+    warmStartKeyText = keyText;
+}
+
+// FNV-1a over the content hash of the Merlin data tree (see HashDataTree), the heightfield path
+// (a shared heightfield changes the world Merlin builds) and the path, size and modification time
+// of the larger inputs: the Merlin library, the boot checkpoint and the caller's key files
+uint64_t MerlinLua::WarmStartKey(const std::string &merlin_path) const {
+    namespace fs = std::filesystem;
+    uint64_t hash = HashBytes(kStateHashSeed, &kWarmStartVersion, sizeof(kWarmStartVersion));
+    auto mixString = [&hash](const std::string &str) {
+        hash = HashBytes(hash, str.c_str(), str.size() + 1);
+    };
+    auto mixStamp = [&](const fs::path &path) {
+        std::error_code error;
+        mixString(path.generic_string());
+        uint64_t size = fs::file_size(path, error);
+        int64_t modified = 0;
+        if (!error)
+            modified = (int64_t)fs::last_write_time(path, error).time_since_epoch().count();
+        hash = HashBytes(hash, &size, sizeof(size));
+        hash = HashBytes(hash, &modified, sizeof(modified));
+    };
+
+    hash = HashBytes(hash, &dataTreeHash, sizeof(dataTreeHash));
+    std::string exe_dir = wi::helper::GetDirectoryFromPath(wi::helper::GetExecutablePath());
+#ifdef _WIN32
+    mixStamp(fs::path(exe_dir) / "Merlin.dll");
+#else
+    mixStamp(fs::path(exe_dir) / "libmerlin.so");
+#endif
+    if (!bootCheckpointPath.empty()) {
+        fs::path checkpoint(bootCheckpointPath);
+        if (checkpoint.is_relative())
+            checkpoint = fs::path(merlin_path) / checkpoint;
+        mixStamp(checkpoint);
+    }
+    for (const std::string &keyFile : warmStartKeyFiles)
+        mixStamp(keyFile);
+    mixString(warmStartKeyText);
+    mixString(heightfieldPath);
+    return hash;
+}
+
+std::string MerlinLua::WarmStartPath() const {
+    char name[64];
+    sprintf_s(name, "warm_%016llx.mws", (unsigned long long)warmStartKey);
+    return (std::filesystem::path(warmStartDir) / name).string();
+}
+
+bool MerlinLua::TryWarmStart(const std::string &merlin_path) {
+    warmStarted = false;
+    if (warmStartDir.empty())
+        return false;
+    warmStartKey = WarmStartKey(merlin_path);
+    std::string path = WarmStartPath();
+    char text[512];
+    std::error_code error;
+    if (!std::filesystem::exists(path, error)) {
+        sprintf_s(text, "Merlin warm start: no snapshot for this data yet (%s), starting cold\n",
+                  path.c_str());
+        wi::backlog::post(text);
+        return false;
+    }
+
+    uint64_t size = 0;
+    void *mapping = nullptr;
+    const char *view = static_cast<const char *>(MapFileReadOnly(path, size, mapping));
+    WarmStartHeader header = {};
+    if (view && size >= sizeof(header))
+        memcpy(&header, view, sizeof(header));
+    bool valid = view && memcmp(header.magic, kWarmStartMagic, sizeof(kWarmStartMagic)) == 0 &&
+                 header.version == kWarmStartVersion && header.key == warmStartKey &&
+                 header.stateOffset <= size && header.stateSize <= size - header.stateOffset &&
+                 header.snapshotOffset <= size &&
+                 header.snapshotSize <= size - header.snapshotOffset;
+    warmStartView = view;
+    warmStartViewSize = size;
+    warmStartMapping = mapping;
+    if (!valid) {
+        UnmapWarmStart();
+        sprintf_s(text, "Merlin warm start: %s is unreadable or stale, starting cold\n",
+                  path.c_str());
+        wi::backlog::post(text);
+        return false;
+    }
+    if (!PushBridge(BRIDGE_WARM_START)) {
+        UnmapWarmStart();
+        return false;
+    }
+
+    // merlinWarmStart(snapshot, snapshotSize, savedState). It checks the saved state before
+    // Merlin starts, and stops Merlin again if the restore fails after that, so a cold start
+    // can follow. Merlin may have used the snapshot even so, so the mapping is kept until
+    // Shutdown either way.
+    lua_pushlightuserdata(L, const_cast<char *>(view + header.snapshotOffset));
+    lua_pushnumber(L, (double)header.snapshotSize);
+    lua_pushlstring(L, view + header.stateOffset, (size_t)header.stateSize);
+    if (CallBridge(BRIDGE_WARM_START, 3, 1)) {
+        warmStarted = lua_toboolean(L, -1);
+        lua_pop(L, 1);
+    }
+    if (!warmStarted) {
+        wi::backlog::post("Merlin warm start: Merlin can't resume from the snapshot, starting "
+                          "cold\n");
+        return false;
+    }
+    sprintf_s(text, "Merlin warm start from %s (%.1f MB snapshot) in %.0f ms\n", path.c_str(),
+              header.snapshotSize / (1024.0 * 1024.0), SteadyNowMs() - initStartMs);
+    wi::backlog::post(text);
+    return true;
+}
+
+// Called once CreateNpcs has populated a cold-started world
+void MerlinLua::SaveWarmStart() {
+    namespace fs = std::filesystem;
+    double coldMs = SteadyNowMs() - initStartMs;
+    std::error_code error;
+    fs::create_directories(warmStartDir, error);
+    std::string path = WarmStartPath();
+    std::string snapshotPath = path + ".msnap.tmp";
+    std::string partPath = path + ".tmp";
+    char text[512];
+
+    // merlinWarmState(snapshotPath) has Merlin save its snapshot there and returns the Lua state
+    if (!PushBridge(BRIDGE_WARM_STATE))
+        return;
+    lua_pushstring(L, snapshotPath.c_str());
+    if (!CallBridge(BRIDGE_WARM_STATE, 1, 1))
+        return;
+    size_t stateSize = 0;
+    const char *state = lua_tolstring(L, -1, &stateSize);
+    std::string luaState = state ? std::string(state, stateSize) : std::string();
+    lua_pop(L, 1);
+    if (!state) {
+        wi::backlog::post("Merlin warm start: this Merlin build can't save snapshots, every "
+                          "launch starts cold\n");
+        return;
+    }
+
+    WarmStartHeader header = {};
+    memcpy(header.magic, kWarmStartMagic, sizeof(kWarmStartMagic));
+    header.version = kWarmStartVersion;
+    header.key = warmStartKey;
+    header.stateOffset = sizeof(header);
+    header.stateSize = luaState.size();
+    header.snapshotOffset = (header.stateOffset + header.stateSize + kWarmStartAlign - 1) /
+                            kWarmStartAlign * kWarmStartAlign;
+
+    FILE *snapshot = fopen(snapshotPath.c_str(), "rb");
+    FILE *out = snapshot ? fopen(partPath.c_str(), "wb") : nullptr;
+    bool ok = out != nullptr;
+    if (ok) {
+        ok = fwrite(&header, sizeof(header), 1, out) == 1 &&
+             fwrite(luaState.data(), 1, luaState.size(), out) == luaState.size();
+        std::vector<char> chunk(1 << 16, 0);
+        size_t padding = (size_t)(header.snapshotOffset - header.stateOffset - header.stateSize);
+        ok = ok && fwrite(chunk.data(), 1, padding, out) == padding;
+        size_t read;
+        while (ok && (read = fread(chunk.data(), 1, chunk.size(), snapshot)) > 0) {
+            ok = fwrite(chunk.data(), 1, read, out) == read;
+            header.snapshotSize += read;
+        }
+        ok = ok && !ferror(snapshot) && fseek(out, 0, SEEK_SET) == 0 &&
+             fwrite(&header, sizeof(header), 1, out) == 1;
+        ok = fclose(out) == 0 && ok;
+    }
+    if (snapshot)
+        fclose(snapshot);
+    fs::remove(snapshotPath, error);
+
+    // Files saved for other keys are stale; the new one replaces them
+    if (ok) {
+        for (fs::directory_iterator it(warmStartDir, error), end; !error && it != end;
+             it.increment(error)) {
+            std::string name = it->path().filename().string();
+            if (name.rfind("warm_", 0) == 0 && it->path().extension() == ".mws")
+                fs::remove(it->path(), error);
+        }
+        fs::rename(partPath, path, error);
+        ok = !error;
+    }
+    if (!ok) {
+        fs::remove(partPath, error);
+        sprintf_s(text, "ERROR: Cannot save Merlin warm-start snapshot %s\n", path.c_str());
+        wi::backlog::post(text);
+        return;
+    }
+    sprintf_s(text,
+              "Merlin world ready %.0f ms after Initialize (cold start); warm-start snapshot "
+              "saved to %s (%.1f MB) in %.0f ms\n",
+              coldMs, path.c_str(), header.snapshotSize / (1024.0 * 1024.0),
+              SteadyNowMs() - initStartMs - coldMs);
+    wi::backlog::post(text);
+}
+
+void MerlinLua::UnmapWarmStart() { UnmapFile(warmStartView, warmStartViewSize, warmStartMapping); }
+
+// ---------------------------------------------------------------------------
+// Compiled data cache
+// ---------------------------------------------------------------------------
+
+// Cache file: this header, an entry per source, then the paths and compiled forms the entries
+// point to, each 8-byte aligned
+static constexpr char kDataCacheMagic[4] = {'M', 'D', 'C', 'H'};
+static constexpr uint32_t kDataCacheVersion = 1;
+struct DataCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t treeHash; // data tree the cache was written for
+    uint64_t count;
+};
+struct DataCacheEntry {
+    uint64_t hash; // content hash of the source the compiled form was made from
+    uint64_t pathOffset;
+    uint64_t pathSize;
+    uint64_t dataOffset;
+    uint64_t dataSize;
+};
+
+// Every file under Common and Game, with its content hash. Warm-start, cache and heightfield
+// files are skipped, in case they were put inside the tree.
+void MerlinLua::HashDataTree(const std::string &merlin_path) {
+    namespace fs = std::filesystem;
+    double startMs = SteadyNowMs();
+    dataSources.clear();
+    dataSourceIndex.clear();
+    std::error_code error;
+    for (const char *dir : {"Common", "Game"}) {
+        fs::recursive_directory_iterator it(fs::path(merlin_path) / dir, error), end;
+        for (; !error && it != end; it.increment(error)) {
+            fs::path extension = it->path().extension();
+            if (!it->is_regular_file(error) || extension == ".mws" || extension == ".mdc" ||
+                extension == ".mhf" || extension == ".tmp")
+                continue;
+            DataSource source;
+            source.path = fs::relative(it->path(), merlin_path, error).generic_string();
+            dataSources.push_back(std::move(source));
+        }
+    }
+    std::sort(dataSources.begin(), dataSources.end(),
+              [](const DataSource &a, const DataSource &b) { return a.path < b.path; });
+
+    std::vector<char> chunk(1 << 16);
+    dataTreeHash = kStateHashSeed;
+    for (size_t i = 0; i < dataSources.size(); i++) {
+        DataSource &source = dataSources[i];
+        source.hash = kStateHashSeed;
+        if (FILE *file = fopen((fs::path(merlin_path) / source.path).string().c_str(), "rb")) {
+            size_t read;
+            while ((read = fread(chunk.data(), 1, chunk.size(), file)) > 0)
+                source.hash = HashBytes(source.hash, chunk.data(), read);
+            fclose(file);
+        }
+        dataTreeHash = HashBytes(dataTreeHash, source.path.c_str(), source.path.size() + 1);
+        dataTreeHash = HashBytes(dataTreeHash, &source.hash, sizeof(source.hash));
+        dataSourceIndex[source.path] = i;
+    }
+    dataCacheStats = MerlinDataCacheStats();
+    dataCacheStats.sources = (int)dataSources.size();
+    dataCacheStats.hashMs = SteadyNowMs() - startMs;
+}
+
+// Map the cache written for this data tree, or else the newest one (its unchanged entries still
+// apply), and hand Merlin the compiled sources that are still valid
+void MerlinLua::OpenDataCache() {
+    namespace fs = std::filesystem;
+    char name[64];
+    sprintf_s(name, "data_%016llx.mdc", (unsigned long long)dataTreeHash);
+    fs::path path = fs::path(dataCacheDir) / name;
+    std::error_code error;
+    if (!fs::exists(path, error)) {
+        path.clear();
+        fs::file_time_type newest;
+        for (fs::directory_iterator it(dataCacheDir, error), end; !error && it != end;
+             it.increment(error)) {
+            std::string file = it->path().filename().string();
+            if (file.rfind("data_", 0) != 0 || it->path().extension() != ".mdc")
+                continue;
+            fs::file_time_type modified = it->last_write_time(error);
+            if (!error && (path.empty() || modified > newest)) {
+                path = it->path();
+                newest = modified;
+            }
+        }
+    }
+
+    if (!path.empty()) {
+        const char *view = static_cast<const char *>(
+            MapFileReadOnly(path.string(), dataCacheViewSize, dataCacheMapping));
+        uint64_t size = dataCacheViewSize;
+        dataCacheView = view;
+        DataCacheHeader header = {};
+        if (view && size >= sizeof(header))
+            memcpy(&header, view, sizeof(header));
+        if (view && memcmp(header.magic, kDataCacheMagic, sizeof(kDataCacheMagic)) == 0 &&
+            header.version == kDataCacheVersion &&
+            header.count <= (size - sizeof(header)) / sizeof(DataCacheEntry)) {
+            dataCacheTreeHash = header.treeHash;
+            for (uint64_t i = 0; i < header.count; i++) {
+                DataCacheEntry entry;
+                memcpy(&entry, view + sizeof(header) + i * sizeof(entry), sizeof(entry));
+                if (entry.pathOffset > size || entry.pathSize > size - entry.pathOffset ||
+                    entry.dataOffset > size || entry.dataSize > size - entry.dataOffset)
+                    continue;
+                auto it = dataSourceIndex.find(
+                    std::string(view + entry.pathOffset, (size_t)entry.pathSize));
+                if (it == dataSourceIndex.end() || dataSources[it->second].hash != entry.hash)
+                    continue;
+                dataSources[it->second].cached = view + entry.dataOffset;
+                dataSources[it->second].cachedSize = entry.dataSize;
+                dataCacheStats.reused++;
+            }
+        } else {
+            UnmapFile(dataCacheView, dataCacheViewSize, dataCacheMapping);
+            char text[512];
+            sprintf_s(text, "Merlin data cache: %s is unreadable, recompiling\n",
+                      path.string().c_str());
+            wi::backlog::post(text);
+        }
+    }
+
+    compiledSources.clear();
+    for (const DataSource &source : dataSources) {
+        if (source.cached)
+            compiledSources.push_back({source.path.c_str(), source.cached, source.cachedSize});
+    }
+    if (useCompiledSources) {
+        useCompiledSources(compiledSources.data(), (int)compiledSources.size(),
+                           StoreCompiledSource, this);
+    }
+}
+
+void MerlinLua::StoreCompiledSource(void *context, const char *path, const void *data,
+                                    uint64_t size) {
+    MerlinLua *self = static_cast<MerlinLua *>(context);
+    auto it = self->dataSourceIndex.find(path ? path : "");
+    if (it != self->dataSourceIndex.end() && data)
+        self->dataSources[it->second].compiled.assign(static_cast<const char *>(data), size);
+}
+
+// bridgeCompiledData(path): lightuserdata and size of a source's valid compiled form, or nil
+int MerlinLua::LuaCompiledData(lua_State *L) {
+    MerlinLua *self = static_cast<MerlinLua *>(lua_touserdata(L, lua_upvalueindex(1)));
+    const char *path = lua_tostring(L, 1);
+    auto it = self->dataSourceIndex.find(path ? path : "");
+    if (it == self->dataSourceIndex.end())
+        return 0;
+    const DataSource &source = self->dataSources[it->second];
+    if (source.cached) {
+        lua_pushlightuserdata(L, const_cast<char *>(source.cached));
+        lua_pushnumber(L, (double)source.cachedSize);
+        return 2;
+    }
+    return 0;
+}
+
+// bridgeStoreCompiled(path, bytes): the compiled form of a source Lua had to parse
+int MerlinLua::LuaStoreCompiled(lua_State *L) {
+    size_t size = 0;
+    const char *data = lua_tolstring(L, 2, &size);
+    StoreCompiledSource(lua_touserdata(L, lua_upvalueindex(1)), lua_tostring(L, 1), data, size);
+    return 0;
+}
+
+// Called once merlinInit has finished: report the parse time and write a new cache if anything
+// was compiled or the tree changed
+void MerlinLua::SaveDataCache() {
+    namespace fs = std::filesystem;
+    lua_getglobal(L, "dataParseMs");
+    dataCacheStats.parseMs = lua_tonumber(L, -1);
+    lua_pop(L, 1);
+    for (const DataSource &source : dataSources)
+        dataCacheStats.compiled += source.compiled.empty() ? 0 : 1;
+
+    char text[512];
+    const char *kind = dataCacheStats.reused == 0     ? "cold"
+                       : dataCacheStats.compiled == 0 ? "warm"
+                                                      : "partial";
+    sprintf_s(text,
+              "Merlin data parse (%s cache): %.0f ms, %d of %d files reused, %d compiled; "
+              "hashing %.1f ms\n",
+              kind, dataCacheStats.parseMs, dataCacheStats.reused, dataCacheStats.sources,
+              dataCacheStats.compiled, dataCacheStats.hashMs);
+    wi::backlog::post(text);
+    if (dataCacheStats.compiled == 0 && dataCacheView && dataCacheTreeHash == dataTreeHash)
+        return;
+
+    // Layout: header, entries, then each path and compiled form
+    std::vector<DataCacheEntry> entries;
+    std::vector<std::pair<const char *, uint64_t>> blobs; // path, then data, per entry
+    auto align = [](uint64_t offset) { return (offset + 7) & ~uint64_t(7); };
+    for (const DataSource &source : dataSources) {
+        if (source.compiled.empty() && !source.cached)
+            continue;
+        DataCacheEntry entry = {};
+        entry.hash = source.hash;
+        entry.pathSize = source.path.size();
+        entry.dataSize = source.compiled.empty() ? source.cachedSize : source.compiled.size();
+        entries.push_back(entry);
+        blobs.emplace_back(source.path.data(), entry.pathSize);
+        blobs.emplace_back(source.compiled.empty() ? source.cached : source.compiled.data(),
+                           entry.dataSize);
+    }
+    uint64_t offset = sizeof(DataCacheHeader) + entries.size() * sizeof(DataCacheEntry);
+    for (size_t i = 0; i < entries.size(); i++) {
+        entries[i].pathOffset = offset = align(offset);
+        offset += entries[i].pathSize;
+        entries[i].dataOffset = offset = align(offset);
+        offset += entries[i].dataSize;
+    }
+
+    std::error_code error;
+    fs::create_directories(dataCacheDir, error);
+    char name[64];
+    sprintf_s(name, "data_%016llx.mdc", (unsigned long long)dataTreeHash);
+    fs::path path = fs::path(dataCacheDir) / name;
+    fs::path partPath = path;
+    partPath += ".tmp";
+    FILE *out = fopen(partPath.string().c_str(), "wb");
+    bool ok = out != nullptr;
+    if (ok) {
+        DataCacheHeader header = {};
+        memcpy(header.magic, kDataCacheMagic, sizeof(kDataCacheMagic));
+        header.version = kDataCacheVersion;
+        header.treeHash = dataTreeHash;
+        header.count = entries.size();
+        ok = fwrite(&header, sizeof(header), 1, out) == 1 &&
+             fwrite(entries.data(), sizeof(DataCacheEntry), entries.size(), out) ==
+                 entries.size();
+        uint64_t written = sizeof(header) + entries.size() * sizeof(DataCacheEntry);
+        static const char kPadding[8] = {};
+        for (const auto &[data, size] : blobs) {
+            size_t padding = (size_t)(align(written) - written);
+            ok = ok && fwrite(kPadding, 1, padding, out) == padding &&
+                 fwrite(data, 1, (size_t)size, out) == size;
+            written = align(written) + size;
+        }
+        ok = fclose(out) == 0 && ok;
+    }
+
+    // The new cache replaces the others (one still mapped here can only go on some platforms;
+    // it is removed next time)
+    if (ok) {
+        for (fs::directory_iterator it(dataCacheDir, error), end; !error && it != end;
+             it.increment(error)) {
+            std::string file = it->path().filename().string();
+            if (file.rfind("data_", 0) == 0 && it->path().extension() == ".mdc")
+                fs::remove(it->path(), error);
+        }
+        error.clear();
+        fs::rename(partPath, path, error);
+        ok = !error;
+    }
+    if (!ok) {
+        fs::remove(partPath, error);
+        sprintf_s(text, "ERROR: Cannot write Merlin data cache %s\n", path.string().c_str());
+        wi::backlog::post(text);
+        return;
+    }
+    sprintf_s(text, "Merlin data cache written to %s (%zu files, %.1f MB)\n",
+              path.string().c_str(), entries.size(), offset / (1024.0 * 1024.0));
+    wi::backlog::post(text);
+}
+
+void MerlinLua::CloseDataCache() {
+    UnmapFile(dataCacheView, dataCacheViewSize, dataCacheMapping);
+    compiledSources.clear();
+    dataSources.clear();
+    dataSourceIndex.clear();
+    dataCacheTreeHash = 0;
+}
+
+// ---------------------------------------------------------------------------
+// Terrain heightfield
+// ---------------------------------------------------------------------------
+
+// Heightfield file: this header, then width x depth float heights, row-major along x
+static constexpr char kHeightfieldMagic[4] = {'M', 'H', 'F', 'D'};
+static constexpr uint32_t kHeightfieldVersion = 1;
+static constexpr float kHeightfieldSpacing = 2.0f;  // meters between baked samples
+static constexpr int32_t kMaxHeightfieldSide = 8192; // wider terrain is baked coarser
+struct HeightfieldHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t treeHash; // data tree the heights were baked from
+    int32_t width;
+    int32_t depth;
+    float originX;
+    float originZ;
+    float spacing;
+    uint32_t reserved;
+};
+
+// Map heightfieldPath if it holds heights baked for this data tree
+bool MerlinLua::MapHeightfield() {
+    const char *view = static_cast<const char *>(
+        MapFileReadOnly(heightfieldPath, heightfieldViewSize, heightfieldMapping));
+    uint64_t size = heightfieldViewSize;
+    heightfieldView = view;
+    HeightfieldHeader header = {};
+    if (view && size >= sizeof(header))
+        memcpy(&header, view, sizeof(header));
+    bool valid = view && memcmp(header.magic, kHeightfieldMagic, sizeof(kHeightfieldMagic)) == 0 &&
+                 header.version == kHeightfieldVersion && header.treeHash == dataTreeHash &&
+                 header.width >= 2 && header.width <= kMaxHeightfieldSide && header.depth >= 2 &&
+                 header.depth <= kMaxHeightfieldSide && header.spacing > 0.0f &&
+                 (uint64_t)header.width * header.depth <= (size - sizeof(header)) / sizeof(float);
+    if (!valid) {
+        UnmapFile(heightfieldView, heightfieldViewSize, heightfieldMapping);
+        return false;
+    }
+    heightfield.heights = reinterpret_cast<const float *>(view + sizeof(header));
+    heightfield.width = header.width;
+    heightfield.depth = header.depth;
+    heightfield.originX = header.originX;
+    heightfield.originZ = header.originZ;
+    heightfield.spacing = header.spacing;
+    return true;
+}
+
+// Map the heightfield baked for this data tree and hand it to Merlin before it starts
+void MerlinLua::OpenHeightfield() {
+    char text[512];
+    std::error_code error;
+    if (!std::filesystem::exists(heightfieldPath, error)) {
+        sprintf_s(text, "Terrain heightfield: none yet (%s), baking one once Merlin has started\n",
+                  heightfieldPath.c_str());
+        wi::backlog::post(text);
+        return;
+    }
+    if (!MapHeightfield()) {
+        sprintf_s(text, "Terrain heightfield: %s is unreadable or stale, baking a new one\n",
+                  heightfieldPath.c_str());
+        wi::backlog::post(text);
+        return;
+    }
+    if (useHeightfield)
+        useHeightfield(&heightfield);
+    sprintf_s(text, "Terrain heightfield %s: %d x %d samples %.1f m apart (%.1f MB), %s\n",
+              heightfieldPath.c_str(), heightfield.width, heightfield.depth, heightfield.spacing,
+              heightfieldViewSize / (1024.0 * 1024.0),
+              useHeightfield ? "shared with Merlin" : "Merlin loads its own terrain");
+    wi::backlog::post(text);
+}
+
+// Sample Merlin's terrain over the bounds of its world sectors into a new heightfield file, and
+// map it for the game's ground queries (Merlin has already built its world from its own terrain)
+void MerlinLua::BakeHeightfield() {
+    namespace fs = std::filesystem;
+    char text[512];
+    if (!terrainElevations || !worldSectors) {
+        wi::backlog::post("Terrain heightfield: this Merlin build can't bake one (no "
+                          "terrainElevations/worldSectors)\n");
+        return;
+    }
+    double startMs = SteadyNowMs();
+    MerlinSectorArray sectors = worldSectors();
+    if (sectors.size <= 0 || !sectors.minCoords || !sectors.maxCoords) {
+        wi::backlog::post("Terrain heightfield: Merlin's world has no sectors to bake\n");
+        return;
+    }
+    float minX = sectors.minCoords[0].floats[0], maxX = sectors.maxCoords[0].floats[0];
+    float minZ = sectors.minCoords[0].floats[2], maxZ = sectors.maxCoords[0].floats[2];
+    for (int i = 1; i < sectors.size; i++) {
+        minX = std::min(minX, sectors.minCoords[i].floats[0]);
+        maxX = std::max(maxX, sectors.maxCoords[i].floats[0]);
+        minZ = std::min(minZ, sectors.minCoords[i].floats[2]);
+        maxZ = std::max(maxZ, sectors.maxCoords[i].floats[2]);
+    }
+    float extent = std::max(maxX - minX, maxZ - minZ);
+    float spacing = std::max(kHeightfieldSpacing, extent / (kMaxHeightfieldSide - 1));
+    int32_t width = std::max(2, (int32_t)std::ceil((maxX - minX) / spacing) + 1);
+    int32_t depth = std::max(2, (int32_t)std::ceil((maxZ - minZ) / spacing) + 1);
+
+    // A row per call, as (wx, wy) pairs
+    std::vector<float> heights((size_t)width * depth);
+    std::vector<float> ground((size_t)width * 2);
+    for (int32_t row = 0; row < depth; row++) {
+        for (int32_t column = 0; column < width; column++) {
+            ground[column * 2] = minX + column * spacing;
+            ground[column * 2 + 1] = minZ + row * spacing;
+        }
+        terrainElevations(ground.data(), heights.data() + (size_t)row * width, width);
+    }
+
+    std::error_code error;
+    fs::path path(heightfieldPath);
+    if (path.has_parent_path())
+        fs::create_directories(path.parent_path(), error);
+    fs::path partPath = path;
+    partPath += ".tmp";
+    FILE *out = fopen(partPath.string().c_str(), "wb");
+    bool ok = out != nullptr;
+    if (ok) {
+        HeightfieldHeader header = {};
+        memcpy(header.magic, kHeightfieldMagic, sizeof(kHeightfieldMagic));
+        header.version = kHeightfieldVersion;
+        header.treeHash = dataTreeHash;
+        header.width = width;
+        header.depth = depth;
+        header.originX = minX;
+        header.originZ = minZ;
+        header.spacing = spacing;
+        ok = fwrite(&header, sizeof(header), 1, out) == 1 &&
+             fwrite(heights.data(), sizeof(float), heights.size(), out) == heights.size();
+        ok = fclose(out) == 0 && ok;
+    }
+    if (ok) {
+        fs::rename(partPath, path, error);
+        ok = !error;
+    }
+    if (!ok || !MapHeightfield()) {
+        fs::remove(partPath, error);
+        sprintf_s(text, "ERROR: Cannot write terrain heightfield %s\n", heightfieldPath.c_str());
+        wi::backlog::post(text);
+        return;
+    }
+    sprintf_s(text, "Terrain heightfield baked to %s: %d x %d samples %.1f m apart in %.0f ms\n",
+              heightfieldPath.c_str(), width, depth, spacing, SteadyNowMs() - startMs);
+    wi::backlog::post(text);
+}
+
+void MerlinLua::CloseHeightfield() {
+    UnmapFile(heightfieldView, heightfieldViewSize, heightfieldMapping);
+    heightfield = {};
+}
+
+bool MerlinLua::TerrainElevations(const float *xs, const float *zs, float *out,
+                                  size_t count) const {
+    const MerlinHeightfield &field = heightfield;
+    if (!field.heights)
+        return false;
+    // Positions in samples, clamped to the grid. The cell is clamped to the last one, so a
+    // position on the far edge takes that cell's far corners.
+    const float scale = 1.0f / field.spacing;
+    const float maxColumn = (float)(field.width - 1), maxRow = (float)(field.depth - 1);
+    const float lastColumn = maxColumn - 1.0f, lastRow = maxRow - 1.0f;
+    const size_t stride = (size_t)field.width;
+    size_t i = 0;
+#if defined(_M_X64) || defined(__SSE2__)
+    // NaN positions come out of max_ps as 0, like the scalar comparisons below
+    const __m128 originX = _mm_set1_ps(field.originX), originZ = _mm_set1_ps(field.originZ);
+    const __m128 scales = _mm_set1_ps(scale), zero = _mm_setzero_ps();
+    const __m128 maxColumns = _mm_set1_ps(maxColumn), maxRows = _mm_set1_ps(maxRow);
+    const __m128 lastColumns = _mm_set1_ps(lastColumn), lastRows = _mm_set1_ps(lastRow);
+    for (; i + 4 <= count; i += 4) {
+        __m128 u = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(xs + i), originX), scales);
+        __m128 v = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(zs + i), originZ), scales);
+        u = _mm_min_ps(_mm_max_ps(u, zero), maxColumns);
+        v = _mm_min_ps(_mm_max_ps(v, zero), maxRows);
+        __m128i column = _mm_cvttps_epi32(_mm_min_ps(u, lastColumns));
+        __m128i row = _mm_cvttps_epi32(_mm_min_ps(v, lastRows));
+        __m128 fu = _mm_sub_ps(u, _mm_cvtepi32_ps(column));
+        __m128 fv = _mm_sub_ps(v, _mm_cvtepi32_ps(row));
+
+        // SSE2 has no gather: fetch the four corners of each cell
+        alignas(16) int32_t columns[4], rows[4];
+        alignas(16) float corners[4][4]; // near-left, near-right, far-left, far-right
+        _mm_store_si128(reinterpret_cast<__m128i *>(columns), column);
+        _mm_store_si128(reinterpret_cast<__m128i *>(rows), row);
+        for (int k = 0; k < 4; k++) {
+            const float *cell = field.heights + rows[k] * stride + columns[k];
+            corners[0][k] = cell[0];
+            corners[1][k] = cell[1];
+            corners[2][k] = cell[stride];
+            corners[3][k] = cell[stride + 1];
+        }
+        __m128 nearLeft = _mm_load_ps(corners[0]), farLeft = _mm_load_ps(corners[2]);
+        __m128 nearEdge =
+            _mm_add_ps(nearLeft, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(corners[1]), nearLeft), fu));
+        __m128 farEdge =
+            _mm_add_ps(farLeft, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(corners[3]), farLeft), fu));
+        _mm_storeu_ps(out + i, _mm_add_ps(nearEdge, _mm_mul_ps(_mm_sub_ps(farEdge, nearEdge), fv)));
+    }
+#endif
+    for (; i < count; i++) {
+        float u = (xs[i] - field.originX) * scale, v = (zs[i] - field.originZ) * scale;
+        u = u > 0.0f ? u : 0.0f;
+        v = v > 0.0f ? v : 0.0f;
+        u = u < maxColumn ? u : maxColumn;
+        v = v < maxRow ? v : maxRow;
+        int32_t column = (int32_t)(u < lastColumn ? u : lastColumn);
+        int32_t row = (int32_t)(v < lastRow ? v : lastRow);
+        float fu = u - (float)column, fv = v - (float)row;
+        const float *cell = field.heights + row * stride + column;
+        float nearEdge = cell[0] + (cell[1] - cell[0]) * fu;
+        float farEdge = cell[stride] + (cell[stride + 1] - cell[stride]) * fu;
+        out[i] = nearEdge + (farEdge - nearEdge) * fv;
+    }
+    return true;
+}
+
+bool MerlinLua::SnapToTerrain(std::vector<XMFLOAT3> &points) const {
+    if (!HasHeightfield())
+        return false;
+    std::vector<float> xs(points.size()), zs(points.size()), ground(points.size());
+    for (size_t i = 0; i < points.size(); i++) {
+        xs[i] = points[i].x;
+        zs[i] = points[i].z;
+    }
+    TerrainElevations(xs.data(), zs.data(), ground.data(), points.size());
+    for (size_t i = 0; i < points.size(); i++)
+        points[i].y = std::max(points[i].y, ground[i]);
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Bridge recording and replay
+// ---------------------------------------------------------------------------
+
+bool MerlinLua::StartRecording(const std::string &path) {
+    if (!L || IsAsyncSimulation() || recordFile) {
+        wi::backlog::post("ERROR: Merlin bridge recording must start right after Initialize\n");
+        return false;
+    }
+    if (warmStarted) {
+        // The recording couldn't rebuild the world: its setup calls never reached Merlin
+        wi::backlog::post("ERROR: Merlin bridge recording can't start in a warm-started session\n");
+        return false;
+    }
+    recordFile = fopen(path.c_str(), "wb");
+    if (!recordFile) {
+        char buffer[512];
+        sprintf_s(buffer, "ERROR: Cannot write Merlin bridge recording %s\n", path.c_str());
+        wi::backlog::post(buffer);
+        return false;
+    }
+    setvbuf(recordFile, nullptr, _IOFBF, 1 << 20);
+    fwrite(kRecordMagic, sizeof(kRecordMagic), 1, recordFile);
+    fwrite(&kRecordVersion, sizeof(kRecordVersion), 1, recordFile);
+    stateHash = kStateHashSeed;
+
+    RecordValue(recordEvent, (uint32_t)npcSyncCapacity);
+    RecordString(recordEvent, bootCheckpointPath);
+    WriteRecordEvent(REC_INIT);
+
+    // Buffers the game has already registered
+    for (const auto &[merlinId, slot] : actionBuffers) {
+        RecordValue(recordEvent, merlinId);
+        RecordValue(recordEvent, *slot.gameBuffer);
+        WriteRecordEvent(REC_REGISTER_ACTIONS);
+    }
+
+    char buffer[512];
+    sprintf_s(buffer, "Recording Merlin bridge inputs to %s\n", path.c_str());
+    wi::backlog::post(buffer);
+    return true;
+}
+
+void MerlinLua::StopRecording() {
+    if (!recordFile)
+        return;
+    // The worker writes events during a tick: let the one in flight finish (only this thread
+    // starts ticks, so no other starts meanwhile)
+    while (simTickInFlight.load(std::memory_order_acquire))
+        std::this_thread::yield();
+    fclose(recordFile);
+    recordFile = nullptr;
+    recordEvent.clear();
+    recordedTiers.clear();
+    wi::backlog::post("Merlin bridge recording closed\n");
+}
+
+void MerlinLua::WriteRecordEvent(uint8_t type) {
+    uint32_t size = (uint32_t)recordEvent.size();
+    fwrite(&type, sizeof(type), 1, recordFile);
+    fwrite(&size, sizeof(size), 1, recordFile);
+    if (size > 0)
+        fwrite(recordEvent.data(), 1, size, recordFile);
+    recordEvent.clear();
+}
+
+void MerlinLua::RecordSimTiers() {
+    // The game resends every tier in a stable order, so a commit usually moves a few NPCs; only
+    // the entries that changed since the last recorded commit are written
+    int count = simTierBuffer.count;
+    bool resized = count != (int)recordedTiers.size();
+    uint32_t changed = 0;
+    RecordValue(recordEvent, count);
+    RecordValue(recordEvent, changed);
+    recordedTiers.resize(count);
+    for (int i = 0; i < count; i++) {
+        const SimTierEntry &entry = simTierBuffer.entries[i];
+        SimTierEntry &recorded = recordedTiers[i];
+        if (recorded.merlinId == entry.merlinId && recorded.tier == entry.tier)
+            continue;
+        recorded = entry;
+        RecordValue(recordEvent, (uint32_t)i);
+        RecordValue(recordEvent, entry.merlinId);
+        RecordValue(recordEvent, entry.tier);
+        changed++;
+    }
+    if (changed == 0 && !resized) {
+        recordEvent.clear();
+        return;
+    }
+    memcpy(recordEvent.data() + sizeof(count), &changed, sizeof(changed));
+    WriteRecordEvent(REC_SIM_TIERS);
+}
+
+void MerlinLua::RecordActionOutcomes() {
+    // Outcomes the game has written, as Merlin will find them in the coming tick (Merlin clears
+    // an outcome when it issues a new command, so only pending ones are listed)
+    uint32_t count = 0;
+    RecordValue(recordEvent, count);
+    for (const auto &[merlinId, slot] : actionBuffers) {
+        const ForeignActionCommandBuffer *buffer =
+            slot.simBuffer ? slot.simBuffer : slot.gameBuffer;
+        if (!buffer)
+            continue;
+        for (int motor = 0; motor < ForeignActionCommandBuffer::NUM_MOTORS; motor++) {
+            int outcome = buffer->commands[motor].outcome;
+            if (outcome == ACTION_OUTCOME_NONE)
+                continue;
+            RecordValue(recordEvent, merlinId);
+            RecordValue(recordEvent, (uint8_t)motor);
+            RecordValue(recordEvent, outcome);
+            count++;
+        }
+    }
+    if (count == 0) {
+        recordEvent.clear();
+        return;
+    }
+    memcpy(recordEvent.data(), &count, sizeof(count));
+    WriteRecordEvent(REC_ACTION_OUTCOMES);
+}
+
+void MerlinLua::RegisterWithMerlin(uint64_t merlinId, ForeignActionCommandBuffer *buffer) {
+    if (recordFile) {
+        RecordValue(recordEvent, merlinId);
+        RecordValue(recordEvent, *buffer);
+        WriteRecordEvent(REC_REGISTER_ACTIONS);
+    }
+    registerForeignActionCommandBuffer(merlinId, buffer);
+}
+
+void MerlinLua::UnregisterWithMerlin(uint64_t merlinId) {
+    if (recordFile) {
+        RecordValue(recordEvent, merlinId);
+        WriteRecordEvent(REC_UNREGISTER_ACTIONS);
+    }
+    unregisterForeignActionCommandBuffer(merlinId);
+}
+
+bool MerlinLua::Replay(const std::string &merlin_path, const std::string &recordingPath,
+                       MerlinReplayReport &report) {
+    report = MerlinReplayReport();
+    if (L) {
+        wi::backlog::post("ERROR: Merlin replay needs an uninitialized MerlinLua\n");
+        return false;
+    }
+
+    FILE *file = fopen(recordingPath.c_str(), "rb");
+    char buffer[512];
+    if (!file) {
+        sprintf_s(buffer, "ERROR: Cannot open Merlin bridge recording %s\n", recordingPath.c_str());
+        wi::backlog::post(buffer);
+        return false;
+    }
+    std::unique_ptr<FILE, decltype(&fclose)> closeFile(file, &fclose);
+
+    char magic[4] = {};
+    uint32_t version = 0;
+    if (fread(magic, sizeof(magic), 1, file) != 1 || memcmp(magic, kRecordMagic, 4) != 0 ||
+        fread(&version, sizeof(version), 1, file) != 1 || version != kRecordVersion) {
+        sprintf_s(buffer, "ERROR: %s is not a Merlin bridge recording (version %u)\n",
+                  recordingPath.c_str(), kRecordVersion);
+        wi::backlog::post(buffer);
+        return false;
+    }
+
+    // Action buffers stand in for the game's: Merlin writes commands, the recording outcomes
+    std::unordered_map<uint64_t, std::unique_ptr<ForeignActionCommandBuffer>> replayBuffers;
+    std::vector<uint8_t> payload;
+    stateHash = kStateHashSeed;
+    replaying = true;
+
+    for (;;) {
+        uint8_t type = 0;
+        uint32_t size = 0;
+        if (fread(&type, sizeof(type), 1, file) != 1)
+            break;
+        if (fread(&size, sizeof(size), 1, file) != 1) {
+            report.truncated = true;
+            break;
+        }
+        payload.resize(size);
+        if (size > 0 && fread(payload.data(), size, 1, file) != 1) {
+            report.truncated = true;
+            break;
+        }
+        RecordReader in{payload.data(), payload.data() + size};
+
+        if (type != REC_INIT && !L)
+            break;
+
+        switch (type) {
+        case REC_INIT: {
+            int syncCapacity = (int)in.Get<uint32_t>();
+            std::string bootCheckpoint = in.GetString();
+            if (!in.ok || L || !Initialize(merlin_path, bootCheckpoint, syncCapacity)) {
+                replaying = false;
+                return false;
+            }
+            break;
+        }
+        case REC_TICK_RATE: {
+            float ticksPerSecond = in.Get<float>();
+            SetSimTickRate(ticksPerSecond, in.Get<int>());
+            break;
+        }
+        case REC_SIM_LOD: {
+            int ringInterval = in.Get<int>();
+            SetSimLodIntervals(ringInterval, in.Get<int>());
+            break;
+        }
+        case REC_GC_BUDGET:
+            SetGcBudget(in.Get<float>());
+            break;
+        case REC_CREATE_PLAYER:
+            CreatePlayer(in.Get<XMFLOAT3>());
+            break;
+        case REC_CREATE_NPCS: {
+            std::vector<XMFLOAT3> spawnPoints = in.GetPositions();
+            std::vector<std::string> modelPaths(in.Get<uint32_t>());
+            for (std::string &modelPath : modelPaths)
+                modelPath = in.GetString();
+            std::vector<XMFLOAT3> waypoints = in.GetPositions();
+            if (in.ok)
+                CreateNpcs(spawnPoints, modelPaths, waypoints);
+            break;
+        }
+        case REC_ASYNC_START:
+            report.asyncRecording = true;
+            break;
+        case REC_PLAYER_POS:
+            CallUpdatePlayerPos(in.Get<XMFLOAT3>());
+            break;
+        case REC_POS_FEEDBACK: {
+            int count = std::clamp(in.Get<int>(), 0, kMaxSyncCapacity);
+            posFeedbackBuffer.Reserve(count);
+            posFeedbackBuffer.count = 0;
+            for (int i = 0; i < count && in.ok; i++) {
+                EntitySyncEntry &entry = posFeedbackBuffer.entries[posFeedbackBuffer.count++];
+                entry.merlinId = in.Get<uint64_t>();
+                XMFLOAT3 position = in.Get<XMFLOAT3>();
+                entry.x = position.x;
+                entry.y = position.y;
+                entry.z = position.z;
+            }
+            WritePosFeedback();
+            break;
+        }
+        case REC_SIM_TIERS: {
+            int count = std::clamp(in.Get<int>(), 0, kMaxSyncCapacity);
+            uint32_t changed = in.Get<uint32_t>();
+            // Entries past the previous count are always among the changed ones
+            simTierBuffer.Reserve(count);
+            simTierBuffer.count = count;
+            for (uint32_t i = 0; i < changed && in.ok; i++) {
+                uint32_t index = in.Get<uint32_t>();
+                uint64_t merlinId = in.Get<uint64_t>();
+                int32_t tier = in.Get<int32_t>();
+                if (index < (uint32_t)count)
+                    simTierBuffer.entries[index] = {merlinId, tier};
+            }
+            simTierBuffer.version++;
+            break;
+        }
+        case REC_REGISTER_ACTIONS: {
+            uint64_t merlinId = in.Get<uint64_t>();
+            auto &actionBuffer = replayBuffers[merlinId];
+            actionBuffer = std::make_unique<ForeignActionCommandBuffer>(
+                in.Get<ForeignActionCommandBuffer>());
+            registerForeignActionCommandBuffer(merlinId, actionBuffer.get());
+            break;
+        }
+        case REC_UNREGISTER_ACTIONS: {
+            uint64_t merlinId = in.Get<uint64_t>();
+            unregisterForeignActionCommandBuffer(merlinId);
+            replayBuffers.erase(merlinId);
+            break;
+        }
+        case REC_ACTION_OUTCOMES: {
+            uint32_t count = in.Get<uint32_t>();
+            for (uint32_t i = 0; i < count && in.ok; i++) {
+                uint64_t merlinId = in.Get<uint64_t>();
+                int motor = in.Get<uint8_t>();
+                int outcome = in.Get<int>();
+                auto it = replayBuffers.find(merlinId);
+                if (it != replayBuffers.end() && motor < ForeignActionCommandBuffer::NUM_MOTORS)
+                    it->second->commands[motor].outcome = outcome;
+            }
+            break;
+        }
+        case REC_UPDATE: {
+            float dt = in.Get<float>();
+            frameBudgetMs = in.Get<float>();
+            report.maxFrameBudgetMs = std::max(report.maxFrameBudgetMs, frameBudgetMs);
+            auto startTime = std::chrono::high_resolution_clock::now();
+            CallUpdate(dt);
+            StepGarbageCollector();
+            MerlinReplayFrame frame;
+            frame.simMs = std::chrono::duration<double, std::milli>(
+                              std::chrono::high_resolution_clock::now() - startTime)
+                              .count();
+            frame.stateHash = stateHash;
+            report.frames.push_back(frame);
+            break;
+        }
+        case REC_NPC_STATES: {
+            bool fullSync = in.Get<uint8_t>() != 0;
+            report.recordedHash = in.Get<uint64_t>();
+            if (ReadNpcStates(npcStateBuffer, fullSync))
+                ApplyNpcDeltas(npcStateBuffer);
+            if (!report.frames.empty())
+                report.frames.back().stateHash = stateHash;
+            if (stateHash != report.recordedHash && report.firstDivergentFrame < 0)
+                report.firstDivergentFrame = std::max<int64_t>(0, report.frames.size() - 1);
+            break;
+        }
+        default:
+            // Unknown event from a newer build: skip it
+            break;
+        }
+        if (!in.ok) {
+            report.truncated = true;
+            break;
+        }
+    }
+
+    replaying = false;
+    report.stateHash = stateHash;
+    for (const auto &[merlinId, actionBuffer] : replayBuffers)
+        unregisterForeignActionCommandBuffer(merlinId);
+    return L != nullptr;
+}
+
+// ---------------------------------------------------------------------------
+// Async simulation
+// ---------------------------------------------------------------------------
+
+static bool IsSameActionCommand(const ForeignActionCommand &a, const ForeignActionCommand &b) {
+    return a.active && b.active && a.actionLabelHstr == b.actionLabelHstr && a.target == b.target;
+}
+
+void MerlinLua::StartAsyncSimulation() {
+    if (!L || IsAsyncSimulation())
+        return;
+
+    // From here on the recording holds the inputs of each tick, as the worker receives them
+    if (recordFile)
+        WriteRecordEvent(REC_ASYNC_START);
+
+    // Seed the first snapshot synchronously with everything the mirror hasn't seen yet, so
+    // GetNpcStates has data before the first tick
+    ReadNpcStates(npcStateSnapshots[2], npcResyncRequested);
+    npcResyncRequested = false;
+    readySnapshot.store(2 | kSnapshotFresh, std::memory_order_relaxed);
+    frontSnapshot = 0;
+    backSnapshot = 1;
+
+    // Move every registered action buffer behind a shadow buffer that Merlin writes to
+    for (auto &[merlinId, slot] : actionBuffers) {
+        UnregisterWithMerlin(merlinId);
+        slot.simBuffer = new ForeignActionCommandBuffer(*slot.gameBuffer);
+        RegisterWithMerlin(merlinId, slot.simBuffer);
+    }
+
+    pendingDt = 0.0f;
+    hasStagedPlayerPos = false;
+    posFeedbackStaging.count = 0;
+    simTierStaging.CopyEntries(simTierBuffer);
+    simTierStaging.version = simTierBuffer.version;
+    simTickRequested = false;
+    simStopRequested = false;
+    simTickInFlight.store(false, std::memory_order_relaxed);
+    simThread = std::thread(&MerlinLua::SimThreadMain, this);
+
+    wi::backlog::post("Merlin simulation running on worker thread\n");
+}
+
+void MerlinLua::StopAsyncSimulation() {
+    if (!IsAsyncSimulation())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(simMutex);
+        simStopRequested = true;
+    }
+    simWake.notify_one();
+    simThread.join();
+
+    // Hand the last tick's commands to the game and put the game buffers back in front of Merlin
+    for (auto it = actionBuffers.begin(); it != actionBuffers.end();) {
+        uint64_t merlinId = it->first;
+        ActionBufferSlot &slot = it->second;
+        if (slot.simBuffer) {
+            UnregisterWithMerlin(merlinId);
+            if (slot.gameBuffer)
+                *slot.gameBuffer = *slot.simBuffer;
+            delete slot.simBuffer;
+            slot.simBuffer = nullptr;
+        }
+        if (!slot.gameBuffer) {
+            it = actionBuffers.erase(it);
+            continue;
+        }
+        RegisterWithMerlin(merlinId, slot.gameBuffer);
+        ++it;
+    }
+    syncedTargetPositions.clear();
+
+    wi::backlog::post("Merlin simulation returned to main thread\n");
+}
+
+void MerlinLua::AsyncSyncPoint() {
+    // Called on the main thread while the worker is idle, so Merlin and the Lua state can be
+    // touched here without racing the simulation.
+
+    // 0. Apply the finished tick's NPC deltas before the next tick can publish over them
+    ConsumeNpcSnapshot();
+
+    // 1. Exchange action commands. A command Merlin is still issuing keeps the outcome the game
+    //    has written for it; anything new from Merlin replaces the game-side command.
+    syncedTargetPositions.clear();
+    for (auto it = actionBuffers.begin(); it != actionBuffers.end();) {
+        uint64_t merlinId = it->first;
+        ActionBufferSlot &slot = it->second;
+        if (!slot.gameBuffer) {
+            // Unregistered since the last sync point
+            UnregisterWithMerlin(merlinId);
+            delete slot.simBuffer;
+            it = actionBuffers.erase(it);
+            continue;
+        }
+        ++it;
+        if (!slot.simBuffer) {
+            // Registered since the last sync point
+            slot.simBuffer = new ForeignActionCommandBuffer(*slot.gameBuffer);
+            RegisterWithMerlin(merlinId, slot.simBuffer);
+            continue;
+        }
+        for (int motor = 0; motor < ForeignActionCommandBuffer::NUM_MOTORS; motor++) {
+            ForeignActionCommand &simCmd = slot.simBuffer->commands[motor];
+            ForeignActionCommand &gameCmd = slot.gameBuffer->commands[motor];
+            if (IsSameActionCommand(simCmd, gameCmd)) {
+                simCmd.outcome = gameCmd.outcome;
+            } else {
+                gameCmd = simCmd;
+            }
+            // Capture target positions while it is safe to query Merlin
+            if (gameCmd.active && !syncedTargetPositions.contains(gameCmd.target)) {
+                MerlinFloat3 pos = worldPos(gameCmd.target);
+                syncedTargetPositions[gameCmd.target] =
+                    XMFLOAT3(pos.floats[0], pos.floats[1], pos.floats[2]);
+            }
+        }
+    }
+
+    if (recordFile)
+        RecordActionOutcomes();
+    if (aiProfileIntervalMs > 0.0f)
+        CountActionTraffic();
+
+    // 2. Publish the finished tick's budget and sync accounting, and any new AI profile sample
+    syncedBudgetStats = budgetStats;
+    syncedSyncStats = syncStats;
+    syncedBridgeStats = bridgeStats;
+    syncedGcStats = gcStats;
+    CollectAiProfile();
+
+    // 3. Hand staged inputs to the worker
+    posFeedbackBuffer.CopyEntries(posFeedbackStaging);
+    if (simTierStaging.version != simTierBuffer.version) {
+        simTierBuffer.CopyEntries(simTierStaging);
+        simTierBuffer.version = simTierStaging.version;
+        if (recordFile)
+            RecordSimTiers();
+    }
+    aiProfileBuffer.intervalMs = aiProfileIntervalMs;
+    tickFullSync = npcResyncRequested;
+    npcResyncRequested = false;
+    tickDt = pendingDt;
+    tickHasPlayerPos = hasStagedPlayerPos;
+    tickPlayerPos = stagedPlayerPos;
+    pendingDt = 0.0f;
+    hasStagedPlayerPos = false;
+
+    // 4. Kick off the next tick
+    simTickInFlight.store(true, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(simMutex);
+        simTickRequested = true;
+    }
+    simWake.notify_one();
+}
+
+void MerlinLua::SimThreadMain() {
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(simMutex);
+            simWake.wait(lock, [this] { return simTickRequested || simStopRequested; });
+            if (simStopRequested)
+                return;
+            simTickRequested = false;
+        }
+
+        // Same order as the synchronous frame: feedback, player, sim, then read back states
+        if (posFeedbackBuffer.count > 0)
+            WritePosFeedback();
+        if (tickHasPlayerPos)
+            CallUpdatePlayerPos(tickPlayerPos);
+        CallUpdate(tickDt);
+        PublishNpcSnapshot();
+        StepGarbageCollector();
+
+        simTickInFlight.store(false, std::memory_order_release);
+    }
+}
+
+void MerlinLua::PublishNpcSnapshot() {
+    if (!ReadNpcStates(npcStateSnapshots[backSnapshot], tickFullSync))
+        return;
+    int previous = readySnapshot.exchange(backSnapshot | kSnapshotFresh, std::memory_order_acq_rel);
+    backSnapshot = previous & ~kSnapshotFresh;
+}
+
+void MerlinLua::RegisterActionBuffer(uint64_t merlinId, ForeignActionCommandBuffer *buffer) {
+    ActionBufferSlot &slot = actionBuffers[merlinId];
+    slot.gameBuffer = buffer;
+    // In async mode the shadow buffer is created and registered at the next sync point
+    if (!IsAsyncSimulation())
+        RegisterWithMerlin(merlinId, buffer);
+}
+
+void MerlinLua::UnregisterActionBuffer(uint64_t merlinId) {
+    auto it = actionBuffers.find(merlinId);
+    if (it == actionBuffers.end())
+        return;
+
+    if (!IsAsyncSimulation()) {
+        UnregisterWithMerlin(merlinId);
+        actionBuffers.erase(it);
+    } else if (it->second.simBuffer) {
+        // Merlin may be writing the shadow buffer right now. Drop the game buffer (the caller is
+        // about to free it) and unregister the shadow at the next sync point.
+        it->second.gameBuffer = nullptr;
+    } else {
+        actionBuffers.erase(it);
+    }
+}
+
+XMFLOAT3 MerlinLua::ResolveWorldPos(uint64_t symbol) {
+    if (IsAsyncSimulation()) {
+        auto it = syncedTargetPositions.find(symbol);
+        return it != syncedTargetPositions.end() ? it->second : XMFLOAT3(0, 0, 0);
+    }
+    MerlinFloat3 pos = worldPos(symbol);
+    return XMFLOAT3(pos.floats[0], pos.floats[1], pos.floats[2]);
+}
+
+void MerlinLua::BenchmarkSyncPaths(int iterations) {
+    if (!L || IsAsyncSimulation() || iterations <= 0)
+        return;
+    if (recordFile) {
+        wi::backlog::post("Merlin sync benchmark skipped while recording bridge inputs\n");
+        return;
+    }
+
+    auto buffer = std::make_unique<EntitySyncStorage>();
+    buffer->Reserve(npcSyncCapacity);
+    auto timeNs = [iterations](auto &&fn) {
+        auto startTime = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < iterations; i++)
+            fn();
+        auto endTime = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double, std::nano>(endTime - startTime).count();
+    };
+
+    // Feed back the positions just read so Merlin's world is left unchanged. Every fill is a full
+    // sync (the cost of the old rewrite-everything protocol); the mirror is resynced afterwards.
+    if (!CallGetNpcStates(*buffer, true) || buffer->count == 0) {
+        wi::backlog::post("Merlin sync benchmark: no NPCs to measure\n");
+        return;
+    }
+    int count = buffer->count;
+    posFeedbackBuffer.CopyEntries(*buffer);
+
+    double perNpc = double(iterations) * count;
+    double luaStatesNs = timeNs([&] { CallGetNpcStates(*buffer, true); }) / perNpc;
+    double luaFeedbackNs = timeNs([&] { CallApplyPosFeedback(); }) / perNpc;
+
+    char text[512];
+    if (HasBatchSync()) {
+        double nativeStatesNs = timeNs([&] { ReadNpcStatesNative(*buffer, true); }) / perNpc;
+        double nativeFeedbackNs = timeNs([&] { WritePosFeedbackNative(); }) / perNpc;
+        sprintf_s(text,
+                  "Merlin sync benchmark (%d NPCs x %d): states Lua %.0f ns/NPC, native %.0f "
+                  "ns/NPC; feedback Lua %.0f ns/NPC, native %.0f ns/NPC\n",
+                  count, iterations, luaStatesNs, nativeStatesNs, luaFeedbackNs,
+                  nativeFeedbackNs);
+    } else {
+        sprintf_s(text,
+                  "Merlin sync benchmark (%d NPCs x %d): states Lua %.0f ns/NPC; feedback Lua "
+                  "%.0f ns/NPC (native path unavailable)\n",
+                  count, iterations, luaStatesNs, luaFeedbackNs);
+    }
+    wi::backlog::post(text);
+
+    // Same Lua functions with and without the JIT, plus the callback re-entry check
+    npcStateBuffer.Reserve(npcSyncCapacity);
+    if (PushBridge(BRIDGE_BENCHMARK_JIT)) {
+        lua_pushinteger(L, iterations);
+        CallBridge(BRIDGE_BENCHMARK_JIT, 1, 0);
+    }
+    if (PushBridge(BRIDGE_BENCHMARK_INTROSPECTION)) {
+        lua_pushinteger(L, iterations);
+        CallBridge(BRIDGE_BENCHMARK_INTROSPECTION, 1, 0);
+    }
+
+    posFeedbackBuffer.count = 0;
+    npcResyncRequested = true;
+}
+
+void MerlinLua::Shutdown() {
+    if (!L) {
+        return;
+    }
+
+    // The worker owns the Lua state while running; take it back before shutting down
+    StopAsyncSimulation();
+    StopRecording();
+    ReportPoolStats(); // while Merlin is still running
+
+    if (frameBudgetMs > 0.0f) {
+        char buffer[512];
+        sprintf_s(buffer,
+                  "Merlin frame budget %.2f ms: %llu frames, %llu overruns (worst +%.2f ms), "
+                  "%llu suspended, %llu cycles, max frame %.2f ms\n",
+                  frameBudgetMs, (unsigned long long)budgetStats.frames,
+                  (unsigned long long)budgetStats.overruns, budgetStats.worstOverrunMs,
+                  (unsigned long long)budgetStats.framesSuspended,
+                  (unsigned long long)budgetStats.cyclesCompleted, budgetStats.maxFrameMs);
+        wi::backlog::post(buffer);
+    }
+    if (budgetStats.ticksDropped > 0) {
+        char buffer[256];
+        sprintf_s(buffer, "Merlin dropped %llu sim ticks to stay within the catch-up cap\n",
+                  (unsigned long long)budgetStats.ticksDropped);
+        wi::backlog::post(buffer);
+    }
+    if (syncStats.npcOverflowFills > 0 || syncEntriesDropped > 0) {
+        char buffer[256];
+        sprintf_s(buffer,
+                  "Merlin sync buffers: %llu NPC fills overflowed (%llu changes deferred, capacity "
+                  "now %d), %llu feedback/tier entries dropped\n",
+                  (unsigned long long)syncStats.npcOverflowFills,
+                  (unsigned long long)syncStats.npcEntriesDeferred, syncStats.npcCapacity,
+                  (unsigned long long)syncEntriesDropped);
+        wi::backlog::post(buffer);
+    }
+
+    if (gcStats.frames > 0) {
+        char buffer[256];
+        sprintf_s(buffer,
+                  "Merlin Lua GC: %llu frames, %llu cycles, avg %.3f ms, max %.3f ms, %llu over "
+                  "budget to bound the heap (%.0f KB)\n",
+                  (unsigned long long)gcStats.frames, (unsigned long long)gcStats.cycles,
+                  gcStats.totalMs / gcStats.frames, gcStats.maxMs,
+                  (unsigned long long)gcStats.forcedFrames, gcStats.heapKb);
+        wi::backlog::post(buffer);
+    }
+    if (aiProfile.samples > 0) {
+        // The rules that cost the most over the session, for when the panel wasn't watched
+        char buffer[256];
+        sprintf_s(buffer, "Merlin AI profile: %llu samples, most expensive rules:\n",
+                  (unsigned long long)aiProfile.samples);
+        wi::backlog::post(buffer);
+        for (size_t i = 0; i < aiProfile.rules.size() && i < 5; i++) {
+            const MerlinAiRuleStats &rule = aiProfile.rules[i];
+            sprintf_s(buffer, "  %-40s %.3f ms/sample, %.1f fires/sample\n", rule.name.c_str(),
+                      rule.ms / aiProfile.samples, (double)rule.fires / aiProfile.samples);
+            wi::backlog::post(buffer);
+        }
+    }
+
+    // Call merlinShutdown() to cleanly stop the simulation
+    if (PushBridge(BRIDGE_SHUTDOWN))
+        CallBridge(BRIDGE_SHUTDOWN, 0, 0);
+
+    // Close Lua state (the registry refs go with it)
+    lua_close(L);
+    L = nullptr;
+    ReleaseBridge();
+    UnmapWarmStart(); // Merlin has stopped using the snapshot, the data cache and the heights
+    warmStarted = false;
+    CloseDataCache();
+    CloseHeightfield();
+    npcMirror.clear();
+    npcMotion.clear();
+    npcMirrorIndex.clear();
+    mirrorSweepPending = false;
+    nativeSentNpcs.clear();
+    nativeModelIndex.clear();
+    roster.clear();
+    rosterValid = false;
+    modelPathTable.count = 0;
+    aiProfileBuffer = {};
+    aiProfile = MerlinAiProfile();
+    aiRuleIndex.clear();
+
+    wi::backlog::post("Merlin Lua subsystem shut down\n");
+}
+
+uint16_t MerlinLua::QueryHstr(const char *str) {
+    if (!queryHstr) {
+        wi::backlog::post("ERROR: queryHstr function not loaded from Merlin.dll\n");
+        return 0;
+    }
+    return queryHstr(str);
+}
+
+std::vector<uint64_t> MerlinLua::GetWaypointSymbols() {
+    std::vector<uint64_t> symbols;
+    if (!L)
+        return symbols;
+
+    // waypointBuffer is already filled by createRootNpcs (via FFI)
+    symbols.reserve(waypointBuffer.count);
+    for (int i = 0; i < waypointBuffer.count; i++) {
+        symbols.push_back(waypointBuffer.entries[i].merlinId);
+    }
+
+    return symbols;
+}
+
+// Entry point exported by the Merlin library already loaded by mx.lua (nullptr if missing)
+static void *MerlinSymbol(const char *name) {
+#ifdef _WIN32
+    HMODULE merlinDll = GetModuleHandleA("Merlin.dll");
+    return merlinDll ? (void *)GetProcAddress(merlinDll, name) : nullptr;
+#else
+    // RTLD_NOLOAD: only look the library up; mx.lua's ffi.load keeps it loaded
+    std::string exe_dir = wi::helper::GetDirectoryFromPath(wi::helper::GetExecutablePath());
+    void *merlinLib = dlopen((exe_dir + "libmerlin.so").c_str(), RTLD_NOW | RTLD_NOLOAD);
+    if (!merlinLib)
+        return nullptr;
+    void *symbol = dlsym(merlinLib, name);
+    dlclose(merlinLib);
+    return symbol;
+#endif
+}
+
+bool MerlinLua::LoadMerlinCInterface() {
+    // Merlin should already be loaded by Lua (mx.lua)
+    if (!MerlinSymbol("start")) {
+        wi::backlog::post("ERROR: Merlin library not loaded\n");
+        return false;
+    }
+
+    // Load CInterface functions
+    worldPos = (WorldPosFn)MerlinSymbol("worldPos");
+    queryHstr = (QueryHstrFn)MerlinSymbol("queryHstr");
+    registerForeignActionCommandBuffer =
+        (RegisterBufferFn)MerlinSymbol("registerForeignActionCommandBuffer");
+    unregisterForeignActionCommandBuffer =
+        (UnregisterBufferFn)MerlinSymbol("unregisterForeignActionCommandBuffer");
 
     if (!worldPos || !queryHstr || !registerForeignActionCommandBuffer ||
         !unregisterForeignActionCommandBuffer) {
@@ -490,6 +2888,25 @@ bool MerlinLua::LoadMerlinCInterface() {
         return false;
     }
 
+    // Optional batched sync entry points; without them NPC sync goes through Lua
+    npcs = (NpcsFn)MerlinSymbol("npcs");
+    attrSymbol = (AttrSymbolFn)MerlinSymbol("attrSymbol");
+    toString = (ToStringFn)MerlinSymbol("toString");
+    worldPositions = (WorldPositionsFn)MerlinSymbol("worldPositions");
+    setWorldPositions = (SetWorldPositionsFn)MerlinSymbol("setWorldPositions");
+    rosterVersion = (RosterVersionFn)MerlinSymbol("rosterVersion");
+    rosterNpcs = (RosterNpcsFn)MerlinSymbol("rosterNpcs");
+    poolStats = (PoolStatsFn)MerlinSymbol("poolStats");
+    useCompiledSources = (UseCompiledSourcesFn)MerlinSymbol("useCompiledSources");
+    useHeightfield = (UseHeightfieldFn)MerlinSymbol("useHeightfield");
+    terrainElevations = (TerrainElevationsFn)MerlinSymbol("terrainElevations");
+    worldSectors = (WorldSectorsFn)MerlinSymbol("worldSectors");
+
     wi::backlog::post("Merlin CInterface functions loaded successfully\n");
+    wi::backlog::post(HasBatchSync() ? "Merlin NPC sync: batched native path\n"
+                                     : "Merlin NPC sync: Lua path (no batch entry points)\n");
+    wi::backlog::post(HasVersionedRoster()
+                          ? "Merlin NPC roster: cached, rebuilt on roster version changes\n"
+                          : "Merlin NPC roster: copied from npcs() every frame (256 NPC cap)\n");
     return true;
 }
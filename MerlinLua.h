@@ -1,33 +1,147 @@
 #pragma once
 
 #include "GrymEngine.h"
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <span>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 struct lua_State;
+struct ForeignActionCommandBuffer;
 
-// ---------------------------------------------------------------------------
-// Shared C structs for Merlin <-> GRYM entity sync via LuaJIT FFI.
-// Layout MUST match the ffi.cdef in main.lua exactly.
-// uint64 entity symbols flow through these buffers raw — no double conversion.
-// ---------------------------------------------------------------------------
-struct EntitySyncEntry {
-    uint64_t merlinId;   // Merlin entity symbol (raw uint64, never converted)
-    float x, y, z;       // Position in meters
-    char modelPath[260]; // Model file path for GRYM rendering (MAX_PATH)
-};
+// Shared C structs for Merlin <-> GRYM entity sync via LuaJIT FFI, defined once in
+// sync_layout.h (main.lua feeds the same file to ffi.cdef)
+#include "Merlin/Game/Scripts/sync_layout.h"
+static_assert(sizeof(EntitySyncEntry) == 24, "EntitySyncEntry layout changed");
+
+// Owner of a shared buffer's entry array; the buffer header (the base) is what Lua sees.
+// Reserve may move the entries, so only the thread currently filling the buffer calls it.
+template <typename Buffer, typename Entry> struct SyncBufferStorage : Buffer {
+    std::vector<Entry> storage;
+
+    SyncBufferStorage() : Buffer{} {}
+    SyncBufferStorage(const SyncBufferStorage &) = delete;
+    SyncBufferStorage &operator=(const SyncBufferStorage &) = delete;
 
-struct EntitySyncBuffer {
-    static constexpr int CAPACITY = 256;
-    EntitySyncEntry entries[CAPACITY];
-    int count = 0;
+    void Reserve(int capacity) {
+        if (capacity <= this->capacity)
+            return;
+        storage.resize(capacity);
+        this->entries = storage.data();
+        this->capacity = capacity;
+    }
+
+    // Copy another buffer's entries (not its header fields) into this one
+    void CopyEntries(const Buffer &from) {
+        Reserve(from.count);
+        if (from.count > 0)
+            memcpy(this->entries, from.entries, sizeof(Entry) * from.count);
+        this->count = from.count;
+    }
 };
+using EntitySyncStorage = SyncBufferStorage<EntitySyncBuffer, EntitySyncEntry>;
+using SimTierStorage = SyncBufferStorage<SimTierBuffer, SimTierEntry>;
 
 // C++ convenience view of one NPC's state (read from npcStateBuffer)
 struct NpcState {
-    uint64_t merlinId = 0; // Merlin entity symbol (raw uint64)
-    float x, y, z;         // Position in meters
-    std::string modelPath; // Path to GRYM model file for rendering
+    uint64_t merlinId = 0;         // Merlin entity symbol (raw uint64)
+    float x, y, z;                 // Position in meters
+    uint16_t version = 0;          // bumped whenever Merlin reports a change
+    uint8_t modelIndex = NO_MODEL; // see MerlinLua::GetModelPath
+};
+
+// Per-frame AI cost accounting for frame-budgeted simulation (see MerlinLua::SetFrameBudget)
+struct MerlinBudgetStats {
+    uint64_t frames = 0;          // frames that ran simulation work
+    uint64_t overruns = 0;        // frames whose Merlin time exceeded the budget
+    uint64_t cyclesCompleted = 0; // Merlin cycles finished
+    uint64_t framesSuspended = 0; // frames that ended with a cycle suspended (resumed next frame)
+    uint64_t ticksDropped = 0;    // fixed-rate ticks discarded by the catch-up cap
+    float lastFrameMs = 0.0f;     // Merlin time spent in the last frame
+    float maxFrameMs = 0.0f;      // worst Merlin time in a single frame
+    float worstOverrunMs = 0.0f;  // worst amount by which a frame exceeded the budget
+};
+
+// Sync buffer capacity and overflow accounting (see sync_layout.h)
+struct MerlinSyncStats {
+    int npcCapacity = 0;             // entries the NPC state buffers currently hold
+    uint64_t npcOverflowFills = 0;   // NPC state fills that couldn't send every change
+    uint64_t npcEntriesDeferred = 0; // changes those fills left for a later fill
+    uint64_t entriesDropped = 0;     // feedback/tier entries dropped at the capacity limit
+};
+
+// Cost of one Lua entry point called by MerlinLua (see MerlinLua::GetBridgeStats)
+struct MerlinBridgeStats {
+    const char *name = ""; // Lua function, also the wi::profiler range name
+    uint64_t calls = 0;
+    uint64_t errors = 0;
+    double totalMs = 0.0;
+    double maxMs = 0.0;
+    double lastMs = 0.0;
+};
+
+// Lua heap and garbage collector pacing (see MerlinLua::SetGcBudget)
+struct MerlinGcStats {
+    double heapKb = 0.0;           // Lua heap after the last step
+    double heapAfterCycleKb = 0.0; // heap left when the last collection cycle finished
+    uint64_t frames = 0;           // frames that stepped the collector
+    uint64_t cycles = 0;           // collection cycles finished
+    uint64_t forcedFrames = 0;     // frames that ignored the budget to keep the heap bounded
+    double lastMs = 0.0;           // collector time in the last frame
+    double maxMs = 0.0;
+    double totalMs = 0.0;
+};
+
+// One behaviour rule, summed over every AI profile sample so far (see MerlinLua::SetAiProfiling)
+struct MerlinAiRuleStats {
+    std::string name;
+    uint64_t fires = 0;   // minds the rule fired in
+    double ms = 0.0;      // deliberation time attributed to the rule
+    uint64_t samples = 0; // samples it fired in
+};
+
+// AI profiler results (see MerlinLua::SetAiProfiling)
+struct MerlinAiProfile {
+    uint64_t samples = 0;
+    AiProfileBuffer last = {};            // latest sample, as Lua wrote it
+    std::vector<MerlinAiRuleStats> rules; // totals over all samples, most expensive first
+    // Action buffer traffic, per second over the last sample interval
+    float commandsPerSec = 0.0f; // new commands Merlin issued
+    float outcomesPerSec = 0.0f; // outcomes the game reported back
+    float failuresPerSec = 0.0f; // of which anything but success
+    int activeCommands = 0;      // commands active when the sample was taken
+    int actionBuffers = 0;       // registered action buffers
+};
+
+// Compiled data cache use at start-up (see MerlinLua::SetDataCache)
+struct MerlinDataCacheStats {
+    int sources = 0;      // files in the Merlin data tree
+    int reused = 0;       // compiled forms still valid in the cache
+    int compiled = 0;     // files (re)compiled this launch because they were new or changed
+    double hashMs = 0.0;  // hashing the data tree
+    double parseMs = 0.0; // mx.start plus the trait tables (0 after a warm start)
+};
+
+// Outcome of replaying a bridge recording (see MerlinLua::Replay)
+struct MerlinReplayFrame {
+    double simMs = 0.0;     // merlinUpdate plus the GC step (one tick in async recordings)
+    uint64_t stateHash = 0; // running hash of every NPC delta Merlin has reported so far
+};
+struct MerlinReplayReport {
+    std::vector<MerlinReplayFrame> frames;
+    bool asyncRecording = false;      // recorded with the worker thread (frames are ticks)
+    float maxFrameBudgetMs = 0.0f;    // hashes only reproduce without a frame budget
+    int64_t firstDivergentFrame = -1; // first frame whose NPC deltas differ from the recording
+    uint64_t recordedHash = 0;        // final state hash in the recording
+    uint64_t stateHash = 0;           // final state hash of the replay
+    bool truncated = false;           // the recording ends mid-event (the game didn't shut down)
 };
 
 class MerlinLua {
@@ -35,8 +149,17 @@ class MerlinLua {
     MerlinLua() = default;
     ~MerlinLua() = default;
 
-    // Initialize Merlin Lua subsystem with path to Merlin data directory
-    bool Initialize(const std::string &merlin_path);
+    // Initialize Merlin Lua subsystem with path to Merlin data directory.
+    // bootCheckpoint (optional) is a history checkpoint manifest written by
+    // Game/Scripts/fastforward.lua, absolute or relative to merlin_path. When it loads, the world
+    // and its NPC population come from the checkpoint instead of starting fresh in 1720.
+    // syncCapacity is the initial number of entries in each sync buffer; Lua reads it from the
+    // buffers, and they grow (up to kMaxSyncCapacity) when a fill doesn't fit.
+    bool Initialize(const std::string &merlin_path, const std::string &bootCheckpoint = "",
+                    int syncCapacity = kDefaultSyncCapacity);
+
+    static constexpr int kDefaultSyncCapacity = 256;
+    static constexpr int kMaxSyncCapacity = 16384;
 
     // Create player entity in Merlin environment
     void CreatePlayer(const XMFLOAT3 &position);
@@ -52,8 +175,18 @@ class MerlinLua {
                     const std::vector<std::string> &npcModelPaths = {},
                     const std::vector<XMFLOAT3> &waypointPositions = {});
 
-    // Get all Merlin NPC states (triggers Lua to fill shared buffer, reads it back)
-    std::vector<NpcState> GetNpcStates();
+    // Get all Merlin NPC states. Merlin only reports NPCs that spawned, moved or were removed;
+    // these deltas are applied to a persistent mirror, which is viewed by the returned span
+    // (valid until the next call; nothing is allocated per frame). Positions are interpolated
+    // between the last two sim ticks by the tick's elapsed fraction, so NPCs move smoothly even
+    // when Merlin ticks slower than the render frame rate.
+    std::span<const NpcState> GetNpcStates();
+
+    // NPCs removed from the mirror by the last GetNpcStates call (tombstones)
+    std::span<const uint64_t> GetRemovedNpcs() const { return removedNpcs; }
+
+    // Model path for an NpcState::modelIndex, or nullptr for NO_MODEL
+    const char *GetModelPath(uint8_t modelIndex) const;
 
     // Position feedback: feed GRYM physics-resolved positions back to Merlin.
     // Call BeginPositionFeedback(), then AddPositionFeedback() for each entity,
@@ -62,9 +195,156 @@ class MerlinLua {
     void AddPositionFeedback(uint64_t merlinId, const XMFLOAT3 &position);
     void ApplyPositionFeedback();
 
-    // Update Merlin simulation each frame
+    // Simulation LOD: BeginSimTiers(), AddSimTier() for each NPC, then CommitSimTiers().
+    // Merlin uses the tiers from the next tick on; NPCs without a tier simulate at full rate.
+    // Resending unchanged tiers each frame is cheap: the commit is dropped.
+    // Lower tiers need Merlin's resumable cycle entry points (see SetFrameBudget).
+    void BeginSimTiers();
+    void AddSimTier(uint64_t merlinId, int tier);
+    void CommitSimTiers();
+
+    // Ticks between deliberations for NPCs in the ring and background tiers
+    void SetSimLodIntervals(int ringInterval, int backgroundInterval);
+
+    // Update Merlin simulation each frame.
+    // In async mode this never blocks: if the worker has finished its tick, the frame becomes a
+    // sync point (results are collected, staged inputs handed over, next tick kicked off).
     void Update(float dt);
 
+    // Per-frame millisecond budget for Merlin work (0 = unbounded, one full cycle per frame).
+    // A cycle that doesn't fit is suspended and resumed next frame, processing a bounded slice
+    // of minds per frame. Requires Merlin's resumable cycle entry points (beginCycle/simMinds/
+    // endCycle); older Merlin builds fall back to whole cycles, skipping frames to repay overruns.
+    void SetFrameBudget(float milliseconds) { frameBudgetMs = milliseconds; }
+    float GetFrameBudget() const { return frameBudgetMs; }
+    MerlinBudgetStats GetBudgetStats() const {
+        return IsAsyncSimulation() ? syncedBudgetStats : budgetStats;
+    }
+    MerlinSyncStats GetSyncStats() const;
+
+    // Per-frame millisecond budget for the Lua garbage collector (0 = Lua's own automatic
+    // collector). With a budget the automatic collector is stopped and MerlinLua steps it
+    // incrementally once per frame, right after the simulation step, so collection never lands
+    // in the middle of other Lua work. If garbage outpaces the budget and the heap grows past
+    // twice what the last cycle left, frames keep stepping until that cycle is finished.
+    // Call once loading is done (it starts with a full collection) and before
+    // StartAsyncSimulation.
+    void SetGcBudget(float milliseconds);
+    MerlinGcStats GetGcStats() const { return IsAsyncSimulation() ? syncedGcStats : gcStats; }
+
+    // Call count and timing per Lua entry point (merlinUpdate, merlinGetNpcStates, ...). Each
+    // call is also a wi::profiler range, so Lua glue shows up next to "Merlin Simulation".
+    std::span<const MerlinBridgeStats> GetBridgeStats() const {
+        return IsAsyncSimulation() ? syncedBridgeStats : bridgeStats;
+    }
+
+    // Fixed simulation tick rate in Hz, decoupled from the render frame rate (0 = one tick per
+    // frame). Frame time is accumulated and whole ticks are run; at most maxCatchUpTicks run in a
+    // single frame and any older backlog is dropped, so a long hitch can't snowball.
+    // Call after Initialize and before StartAsyncSimulation.
+    void SetSimTickRate(float ticksPerSecond, int maxCatchUpTicks);
+
+    // AI profiler: every intervalMs (0 = off) Merlin runs one cycle a mind at a time, timing each
+    // mind, and reports the behaviour rules that fired in the most expensive ones. Each mind's
+    // time is split between its rules, giving a per-rule cost. Action buffer traffic is counted
+    // while it is on. Cycles between samples are untouched; the cost of reading a sample back
+    // is reported as AiProfileBuffer::collectMs. Needs Merlin's resumable cycle entry points to
+    // time minds (see SetFrameBudget); without them only rule firing counts are sampled.
+    void SetAiProfiling(float intervalMs) { aiProfileIntervalMs = intervalMs > 0 ? intervalMs : 0; }
+    const MerlinAiProfile &GetAiProfile() const { return aiProfile; }
+
+    // Pool telemetry: at Shutdown, each Merlin memory pool's limits, current and peak occupancy
+    // and growth events are written to a new pools_<date>_<time>.txt in this directory (empty =
+    // off), for limitstuner.lua to merge into a recommended MerlinLimits.txt. Pools that grew are
+    // logged either way. Needs a Merlin build that exports poolStats.
+    void SetPoolTelemetryDir(const std::string &dir) { poolTelemetryDir = dir; }
+    bool WritePoolTelemetry(const std::string &path);
+
+    // Warm start: once CreateNpcs has populated a cold-started world, Merlin's snapshot of it and
+    // the Lua globals that go with it are saved to warm_<key>.mws in dir (empty = off). Later
+    // launches memory-map that file and resume from it in Initialize, skipping the data tree,
+    // trait tables, scene and population setup; CreatePlayer/CreateNpcs then only hand back what
+    // the game needs. The key hashes the Merlin data tree, the Merlin library, the boot
+    // checkpoint, keyFiles (e.g. the level) and keyText (e.g. the NPC models), so changing any of
+    // them cold-starts and replaces the file. Call before Initialize; not used while recording.
+    // Needs a Merlin build that exports saveSnapshot and startFromSnapshot.
+    void SetWarmStart(const std::string &dir, const std::vector<std::string> &keyFiles,
+                      const std::string &keyText);
+    bool IsWarmStarted() const { return warmStarted; }
+
+    // Compiled data cache: every file of the Merlin data tree is hashed at Initialize, and the
+    // compiled forms of the ones whose hash is unchanged are served from a memory-mapped cache
+    // file in dir (empty = off): behaviour, ontology, grammar and systems sources to Merlin,
+    // trait tables to loadAttrTable, the scene layout to scenelayout.lua. Only new or changed
+    // files are parsed, and the cache is rewritten once start-up has compiled them. Parse times
+    // are logged as cold (nothing reused), partial or warm. Call before Initialize. Merlin's
+    // sources need a Merlin build that exports useCompiledSources; the trait tables and the
+    // scene layout are cached either way.
+    void SetDataCache(const std::string &dir) { dataCacheDir = dir; }
+    const MerlinDataCacheStats &GetDataCacheStats() const { return dataCacheStats; }
+
+    // Terrain heightfield: a memory-mapped grid of Merlin's ground heights in the file at path
+    // (empty = off). The game's ground queries (TerrainElevations, SnapToTerrain) sample it
+    // without crossing into Merlin, from any thread. A Merlin build that exports useHeightfield
+    // is also handed it before it starts, and builds its world from these heights rather than
+    // its terrain file; other builds keep their own terrain, which the file was baked from. When
+    // the file is missing or was baked for another data tree, a new one is baked once Merlin has
+    // started, by sampling its world sectors every 2 m in batched terrainElevations calls. GRYM's
+    // rendered terrain is not generated from it, so it can still differ from the heightfield.
+    // Call before Initialize. Baking needs a Merlin build that exports terrainElevations and
+    // worldSectors.
+    void SetHeightfield(const std::string &path) { heightfieldPath = path; }
+    bool HasHeightfield() const { return heightfield.heights != nullptr; }
+
+    // Ground elevation under count (x, z) positions: bilinear between the heightfield samples,
+    // four positions at a time with SSE2, clamped to the heightfield's edge. False (out left
+    // alone) without a heightfield.
+    bool TerrainElevations(const float *xs, const float *zs, float *out, size_t count) const;
+
+    // Raise the points that are below the ground onto it, with one TerrainElevations pass
+    bool SnapToTerrain(std::vector<XMFLOAT3> &points) const;
+
+    // Asynchronous simulation: Merlin ticks on a dedicated worker thread that owns the Lua state.
+    // Call after CreatePlayer/CreateNpcs. While running, UpdatePlayerPosition and position
+    // feedback are queued for the next tick, and GetNpcStates returns the latest finished
+    // snapshot (triple-buffered) without waiting for the worker.
+    void StartAsyncSimulation();
+    void StopAsyncSimulation();
+    bool IsAsyncSimulation() const { return simThread.joinable(); }
+
+    // Action command buffers are registered through MerlinLua (not the raw CInterface) so that
+    // async mode can give Merlin a shadow buffer and exchange commands/outcomes at sync points.
+    void RegisterActionBuffer(uint64_t merlinId, ForeignActionCommandBuffer *buffer);
+    void UnregisterActionBuffer(uint64_t merlinId);
+
+    // World position of a Merlin symbol (entity or OBB). In async mode this is served from the
+    // positions captured at the last sync point, since Merlin may be mid-tick on the worker.
+    XMFLOAT3 ResolveWorldPos(uint64_t symbol);
+
+    // Time both NPC sync paths (Lua per-NPC FFI calls vs. batched native CInterface calls) over
+    // the current population and log the cost per NPC, then have merlinBenchmarkJit time the Lua
+    // marshalling functions compiled vs. interpreted and check callback re-entry, and
+    // merlinBenchmarkIntrospection compare by-value act lists with mxu's cursor paging.
+    // Non-destructive: feeds back the positions it read. Synchronous mode only, not while
+    // recording.
+    void BenchmarkSyncPaths(int iterations);
+
+    // Bridge recording: every input MerlinLua hands to Merlin (setup calls, dt, player position,
+    // position feedback, sim tiers, action buffer registrations and outcomes) is streamed to a
+    // compact binary log in the order Merlin receives it, along with a hash of the NPC deltas
+    // Merlin reports back. Async sessions are recorded tick by tick. Call right after Initialize;
+    // the log is closed by StopRecording or Shutdown.
+    bool StartRecording(const std::string &path);
+    void StopRecording();
+    bool IsRecording() const { return recordFile != nullptr; }
+
+    // Feed a recording back into Merlin without the game: initializes this (not yet initialized)
+    // MerlinLua from the log, replays every input synchronously, times each frame and compares
+    // the NPC state hash with the recorded one. Call Shutdown afterwards. False if the log can't
+    // be read or Merlin doesn't start.
+    bool Replay(const std::string &merlin_path, const std::string &recordingPath,
+                MerlinReplayReport &report);
+
     // Shutdown Merlin and close Lua state
     void Shutdown();
 
@@ -91,14 +371,389 @@ class MerlinLua {
     static RegisterBufferFn registerForeignActionCommandBuffer;
     static UnregisterBufferFn unregisterForeignActionCommandBuffer;
 
+    // Batched NPC sync (optional, newer Merlin builds). With these, GetNpcStates and position
+    // feedback run entirely in C++: one call fills N positions, one call applies N positions.
+    struct MerlinSymbolArray {
+        uint64_t buffer[256];
+        int size;
+    };
+    struct MerlinString {
+        char buffer[512];
+    };
+    typedef MerlinSymbolArray (*NpcsFn)();
+    typedef uint64_t (*AttrSymbolFn)(uint64_t, const char *);
+    typedef MerlinString (*ToStringFn)(uint64_t);
+    typedef void (*WorldPositionsFn)(const uint64_t *, MerlinFloat3 *, int);
+    typedef void (*SetWorldPositionsFn)(const uint64_t *, const MerlinFloat3 *, int);
+    typedef uint32_t (*RosterVersionFn)();
+    typedef int (*RosterNpcsFn)(uint64_t *, int);
+
+    static NpcsFn npcs;
+    static AttrSymbolFn attrSymbol;
+    static ToStringFn toString;
+    static WorldPositionsFn worldPositions;
+    static SetWorldPositionsFn setWorldPositions;
+
+    // Versioned roster (optional): rosterVersion changes whenever minds are created or destroyed,
+    // rosterNpcs copies the whole roster (no 256 cap) and returns its size. Without them the
+    // roster is copied from npcs() every frame.
+    static RosterVersionFn rosterVersion;
+    static RosterNpcsFn rosterNpcs;
+
+    // Pool telemetry (optional): occupancy of each memory pool configured in MerlinLimits.txt.
+    // Per-mind pools (npc.*) have one instance per mind: current is summed over the instances,
+    // peak is the most items any one instance held, growths counts growth events in all of them.
+    struct MerlinPoolStats {
+        char name[64];
+        uint32_t maxItems; // limits from MerlinLimits.txt
+        uint32_t initReserved;
+        uint32_t growthStride;
+        uint32_t instances;
+        uint64_t current;
+        uint32_t peak;
+        uint32_t growths;
+    };
+    typedef int (*PoolStatsFn)(MerlinPoolStats *, int); // fills up to n, returns the pool count
+    static PoolStatsFn poolStats;
+
+    // Compiled sources (optional): before start(), hand Merlin the compiled form of each source
+    // file (path relative to the Merlin data directory, e.g. "Common/Ontology/Human.mon") whose
+    // cached form is still valid. Merlin loads those instead of parsing them, and passes every
+    // file it did parse to sink with its new compiled form. The array and what it points to stay
+    // valid until stop().
+    struct MerlinCompiledSource {
+        const char *path;
+        const void *data;
+        uint64_t size;
+    };
+    typedef void (*CompiledSinkFn)(void *context, const char *path, const void *data,
+                                   uint64_t size);
+    typedef void (*UseCompiledSourcesFn)(const MerlinCompiledSource *, int, CompiledSinkFn,
+                                         void *context);
+    static UseCompiledSourcesFn useCompiledSources;
+
+    // Shared heightfield (optional): before start(), hand Merlin the ground heights to build
+    // makeWorldFromTerrain's world from and to answer its terrain queries with, instead of
+    // loading the terrain file. width x depth samples, row-major along x, spacing meters apart
+    // from (originX, originZ); Merlin's ground position (wx, wy) is the game's (x, z). The
+    // heights stay valid until stop().
+    struct MerlinHeightfield {
+        const float *heights;
+        int32_t width;
+        int32_t depth;
+        float originX;
+        float originZ;
+        float spacing;
+    };
+    typedef void (*UseHeightfieldFn)(const MerlinHeightfield *);
+    static UseHeightfieldFn useHeightfield;
+
+    // Terrain queries (optional): the elevation under count ground positions, (wx, wy) pairs, in
+    // one call, and the world's sectors (their bounds are what a heightfield is baked over)
+    struct MerlinSectorArray {
+        MerlinFloat3 *minCoords;
+        MerlinFloat3 *maxCoords;
+        int size;
+    };
+    typedef void (*TerrainElevationsFn)(const float *, float *, int);
+    typedef MerlinSectorArray (*WorldSectorsFn)();
+    static TerrainElevationsFn terrainElevations;
+    static WorldSectorsFn worldSectors;
+
+    static bool HasVersionedRoster() { return rosterVersion && rosterNpcs; }
+    static bool HasBatchSync() {
+        return (npcs || HasVersionedRoster()) && attrSymbol && toString && worldPositions &&
+               setWorldPositions;
+    }
+
   private:
     lua_State *L = nullptr;
 
+    // Lua entry points, resolved once into registry refs after main.lua has loaded
+    enum BridgeEntry {
+        BRIDGE_INIT,
+        BRIDGE_CREATE_PLAYER,
+        BRIDGE_UPDATE_PLAYER_POS,
+        BRIDGE_CREATE_NPCS,
+        BRIDGE_GET_NPC_STATES,
+        BRIDGE_APPLY_POS_FEEDBACK,
+        BRIDGE_SET_SIM_LOD,
+        BRIDGE_SET_TICK_RATE,
+        BRIDGE_UPDATE,
+        BRIDGE_SHUTDOWN,
+        BRIDGE_BENCHMARK_JIT,
+        BRIDGE_BENCHMARK_INTROSPECTION,
+        BRIDGE_WARM_START,
+        BRIDGE_WARM_STATE,
+        BRIDGE_ENTRY_COUNT
+    };
+    std::array<int, BRIDGE_ENTRY_COUNT> bridgeRefs = {};
+    int tracebackRef = 0; // message handler used by every bridge call
+
+    // Written by whichever thread runs the sim
+    std::array<MerlinBridgeStats, BRIDGE_ENTRY_COUNT> bridgeStats;
+    std::array<MerlinBridgeStats, BRIDGE_ENTRY_COUNT> syncedBridgeStats; // async sync point copy
+
+    void ResolveBridge();
+    void ReleaseBridge();
+
+    // Push an entry point; false (nothing pushed) if main.lua doesn't define it
+    bool PushBridge(BridgeEntry entry);
+
+    // Call the pushed entry point with nargs arguments above it, with a traceback on error.
+    // Pops the function and arguments; on success leaves nresults results on the stack.
+    bool CallBridge(BridgeEntry entry, int nargs, int nresults);
+
     // Shared buffers for Merlin <-> GRYM entity sync.
     // Accessed by Lua via FFI pointers passed during Initialize().
-    EntitySyncBuffer npcStateBuffer;    // Lua fills, C++ reads
-    EntitySyncBuffer posFeedbackBuffer; // C++ fills, Lua reads
-    EntitySyncBuffer waypointBuffer;    // Lua fills, C++ reads (waypoint entity symbols)
+    EntitySyncStorage npcStateBuffer;    // Lua fills, C++ reads
+    EntitySyncStorage posFeedbackBuffer; // C++ fills, Lua reads
+    EntitySyncStorage waypointBuffer;    // Lua fills, C++ reads (waypoint entity symbols)
+    SimTierStorage simTierBuffer;        // C++ fills, Lua reads (simulation LOD tiers)
+    ModelPathTable modelPathTable = {};  // both intern, C++ reads (appended by the sim thread)
+
+    // Tier fill in progress (main thread): entries are compared in place as they are overwritten,
+    // so a commit that resends the same tiers leaves the version (and Lua's lookups) alone
+    int simTiersPrevCount = 0;
+    bool simTiersChanged = false;
+
+    // Capacity NPC state buffers are reserved to before each fill, and overflow accounting.
+    // Written by whichever thread runs the sim; feedback/tier drops only by the main thread.
+    int npcSyncCapacity = kDefaultSyncCapacity;
+    MerlinSyncStats syncStats;
+    MerlinSyncStats syncedSyncStats; // copy taken at the last async sync point
+    uint64_t syncEntriesDropped = 0;
+
+    // Batched native sync path (see HasBatchSync); scratch arrays are only touched by the thread
+    // running the simulation
+    std::vector<uint64_t> batchIds;
+    std::vector<MerlinFloat3> batchPositions;
+
+    // Tick number and elapsed fraction returned by the last merlinUpdate (stamped into snapshots
+    // filled by the native path, which doesn't go through Lua)
+    uint32_t simTick = 0;
+    float simTickAlpha = 1.0f;
+
+    // Frame budget and overrun accounting (written by whichever thread runs the sim)
+    float frameBudgetMs = 0.0f;
+    MerlinBudgetStats budgetStats;
+    MerlinBudgetStats syncedBudgetStats; // copy taken at the last async sync point
+
+    // Incremental GC pacing (see SetGcBudget); stepped by whichever thread runs the sim
+    static constexpr int kGcStepKb = 16;       // work per lua_gc(LUA_GCSTEP) call
+    static constexpr int kGcMinHeapLimitKb = 4096;
+    float gcBudgetMs = 0.0f;
+    MerlinGcStats gcStats;
+    MerlinGcStats syncedGcStats; // copy taken at the last async sync point
+    void StepGarbageCollector();
+
+    // Action buffers registered by the game, keyed by Merlin NPC symbol.
+    // In async mode each one has a shadow buffer that is what Merlin actually writes to.
+    static constexpr int kActionMotors = 4; // ForeignActionCommandBuffer::NUM_MOTORS
+    struct ActionMotorSeen {
+        uint64_t actionLabelHstr = 0;
+        uint64_t target = 0;
+        int active = 0;
+        int outcome = 0;
+    };
+    struct ActionBufferSlot {
+        ForeignActionCommandBuffer *gameBuffer = nullptr; // owned by GameStartup, main thread only
+        ForeignActionCommandBuffer *simBuffer = nullptr;  // owned here, worker thread during ticks
+        std::array<ActionMotorSeen, kActionMotors> seen = {}; // game buffer as last counted
+    };
+    std::unordered_map<uint64_t, ActionBufferSlot> actionBuffers;
+
+    // AI profiler (see SetAiProfiling). The interval is handed to Lua before each tick, and
+    // samples and action traffic are collected on the main thread (after the synchronous
+    // Update, or at the async sync point), so aiProfile is only touched by the main thread.
+    float aiProfileIntervalMs = 0.0f;
+    AiProfileBuffer aiProfileBuffer = {}; // Lua fills, C++ reads (C++ sets intervalMs)
+    MerlinAiProfile aiProfile;
+    std::unordered_map<std::string, size_t> aiRuleIndex; // rule name -> aiProfile.rules index
+    uint64_t actionCommandsIssued = 0;
+    uint64_t actionOutcomesReported = 0;
+    uint64_t actionFailuresReported = 0;
+    int actionCommandsActive = 0;
+    std::array<uint64_t, 3> sampledActionTraffic = {}; // the three counters at the last sample
+    double aiProfileSampleMs = 0.0;                    // wall time of the last sample
+    void CountActionTraffic();
+    void CollectAiProfile();
+
+    // Pool telemetry (see SetPoolTelemetryDir), read at Shutdown once the worker has stopped
+    std::string poolTelemetryDir;
+    std::vector<MerlinPoolStats> ReadPoolStats();
+    void ReportPoolStats();
+
+    // Warm start (see SetWarmStart). The file stays mapped until Merlin has stopped, since Merlin
+    // may keep using the snapshot in place.
+    std::string warmStartDir;
+    std::vector<std::string> warmStartKeyFiles;
+    std::string warmStartKeyText;
+    uint64_t warmStartKey = 0;
+    bool warmStarted = false;
+    const void *warmStartView = nullptr;
+    uint64_t warmStartViewSize = 0;
+    void *warmStartMapping = nullptr; // file mapping handle (Windows)
+    double initStartMs = 0.0;         // when Initialize began, for the start-up time logs
+    uint64_t WarmStartKey(const std::string &merlin_path) const;
+    std::string WarmStartPath() const;
+    bool TryWarmStart(const std::string &merlin_path);
+    void SaveWarmStart();
+    void UnmapWarmStart();
+
+    // Compiled data cache (see SetDataCache). The data tree is hashed whenever the cache or warm
+    // start is on (the warm-start key includes it); the cache file stays mapped until Merlin has
+    // stopped, since Merlin and the trait tables point into it.
+    struct DataSource {
+        std::string path;             // relative to the Merlin data directory, '/' separated
+        uint64_t hash = 0;            // FNV-1a of the contents
+        const char *cached = nullptr; // compiled form in the mapped cache, if still valid
+        uint64_t cachedSize = 0;
+        std::string compiled;         // compiled form produced this launch
+    };
+    std::string dataCacheDir;
+    std::vector<DataSource> dataSources; // sorted by path
+    std::unordered_map<std::string, size_t> dataSourceIndex;
+    uint64_t dataTreeHash = 0;      // over every path and content hash
+    uint64_t dataCacheTreeHash = 0; // data tree the mapped cache was written for
+    std::vector<MerlinCompiledSource> compiledSources; // handed to useCompiledSources
+    const void *dataCacheView = nullptr;
+    uint64_t dataCacheViewSize = 0;
+    void *dataCacheMapping = nullptr; // file mapping handle (Windows)
+    MerlinDataCacheStats dataCacheStats;
+    void HashDataTree(const std::string &merlin_path);
+    void OpenDataCache();
+    void SaveDataCache();
+    void CloseDataCache();
+    static void StoreCompiledSource(void *context, const char *path, const void *data,
+                                    uint64_t size);
+    static int LuaCompiledData(lua_State *L);
+    static int LuaStoreCompiled(lua_State *L);
+
+    // Terrain heightfield (see SetHeightfield). The file stays mapped until Merlin has stopped,
+    // since Merlin samples it in place.
+    std::string heightfieldPath;
+    MerlinHeightfield heightfield = {};
+    const void *heightfieldView = nullptr;
+    uint64_t heightfieldViewSize = 0;
+    void *heightfieldMapping = nullptr; // file mapping handle (Windows)
+    bool MapHeightfield();
+    void OpenHeightfield();
+    void BakeHeightfield();
+    void CloseHeightfield();
+
+    // Bridge recording (see StartRecording). Events are written by whichever thread runs the
+    // sim, and by the main thread only while the worker is idle (sync points).
+    FILE *recordFile = nullptr;
+    std::vector<uint8_t> recordEvent;         // payload of the event being written
+    std::vector<SimTierEntry> recordedTiers; // tier list as of the last recorded commit
+    bool replaying = false;
+    uint64_t stateHash = 0; // running hash of NPC delta fills, while recording or replaying
+    std::string bootCheckpointPath;
+    void WriteRecordEvent(uint8_t type);
+    void RecordSimTiers();
+    void RecordActionOutcomes();
+
+    // Every action buffer (un)registration with Merlin goes through these, so it is recorded
+    void RegisterWithMerlin(uint64_t merlinId, ForeignActionCommandBuffer *buffer);
+    void UnregisterWithMerlin(uint64_t merlinId);
+
+    // ---- Async simulation state ----
+    std::thread simThread;
+    std::mutex simMutex;
+    std::condition_variable simWake;
+    bool simTickRequested = false;             // guarded by simMutex
+    bool simStopRequested = false;             // guarded by simMutex
+    std::atomic<bool> simTickInFlight = false; // set by main at kick, cleared by worker at publish
+
+    // Inputs staged on the main thread, handed to the worker at the next sync point
+    float pendingDt = 0.0f;
+    bool hasStagedPlayerPos = false;
+    XMFLOAT3 stagedPlayerPos = {};
+    EntitySyncStorage posFeedbackStaging;
+    SimTierStorage simTierStaging;
+
+    // Inputs owned by the worker for the tick in flight
+    float tickDt = 0.0f;
+    bool tickHasPlayerPos = false;
+    XMFLOAT3 tickPlayerPos = {};
+
+    // Triple-buffered NPC state snapshots. The worker fills backSnapshot and publishes it by
+    // swapping it into readySnapshot; the main thread swaps readySnapshot into frontSnapshot.
+    static constexpr int kSnapshotFresh = 4;
+    EntitySyncStorage npcStateSnapshots[3];
+    std::atomic<int> readySnapshot = 2;
+    int backSnapshot = 1;  // worker thread only
+    int frontSnapshot = 0; // main thread only
+
+    // World positions of action targets, captured at the last sync point
+    std::unordered_map<uint64_t, XMFLOAT3> syncedTargetPositions;
+
+    // Persistent NPC mirror (main thread), kept up to date from the delta stream.
+    // npcMotion is parallel to npcMirror: positions at the previous and latest tick the NPC moved.
+    struct NpcMotion {
+        XMFLOAT3 previous;
+        XMFLOAT3 latest;
+        uint32_t latestTick = 0;
+        uint32_t generation = 0; // last full sync that listed this NPC
+    };
+    std::vector<NpcState> npcMirror;
+    std::vector<NpcMotion> npcMotion;
+    std::unordered_map<uint64_t, size_t> npcMirrorIndex;
+    std::vector<uint64_t> removedNpcs;        // handed out by GetRemovedNpcs
+    std::vector<uint64_t> pendingRemovedNpcs; // tombstones applied since the last GetNpcStates
+    uint32_t mirrorTick = 0;
+    float mirrorTickAlpha = 1.0f;
+    uint32_t mirrorGeneration = 0;
+    bool mirrorSweepPending = false; // a full sync overflowed; sweep once its remainder arrives
+    bool npcResyncRequested = false; // ask the producer for a FULL_SYNC fill next time
+    bool tickFullSync = false;       // async: resync request handed to the tick in flight
+
+    // Producer state for the native delta path: what was last sent for each NPC
+    struct SentNpc {
+        XMFLOAT3 position;
+        uint16_t version = 0;
+        uint32_t seenStamp = 0;
+    };
+    std::unordered_map<uint64_t, SentNpc> nativeSentNpcs;
+    uint32_t nativeSentStamp = 0;
+
+    // NPC roster for the native path, re-read only when Merlin's roster version changes (see
+    // HasVersionedRoster). Only touched by the thread running the simulation.
+    std::vector<uint64_t> roster;
+    uint32_t rosterSeenVersion = 0;
+    bool rosterValid = false;
+    const std::vector<uint64_t> &Roster();
+    std::unordered_map<uint64_t, uint8_t> nativeModelIndex; // modelPath symbol -> table index
+
+    void SimThreadMain();
+    void AsyncSyncPoint();
+    void PublishNpcSnapshot();
+    EntitySyncStorage &FeedbackBuffer() {
+        return IsAsyncSimulation() ? posFeedbackStaging : posFeedbackBuffer;
+    }
+    SimTierStorage &TierBuffer() { return IsAsyncSimulation() ? simTierStaging : simTierBuffer; }
+
+    // Direct Lua entry-point calls (main thread in sync mode, worker thread in async mode)
+    void CallUpdatePlayerPos(const XMFLOAT3 &position);
+    void CallApplyPosFeedback();
+    void CallUpdate(float dt);
+    bool CallGetNpcStates(EntitySyncBuffer &buffer, bool fullSync);
+
+    // NPC sync through the batched native path when available, otherwise through Lua
+    // (reserving the buffer first and growing npcSyncCapacity if the fill overflowed)
+    bool ReadNpcStates(EntitySyncStorage &buffer, bool fullSync);
+    void WritePosFeedback();
+    void ReadNpcStatesNative(EntitySyncBuffer &buffer, bool fullSync);
+
+    // Apply one filled delta buffer to the NPC mirror
+    void ApplyNpcDeltas(const EntitySyncBuffer &buffer);
+
+    // Index of a path in modelPathTable, appending it if new (NO_MODEL when the table is full)
+    uint8_t InternModelPath(const char *path);
+    void RemoveMirrorNpc(size_t index);
+    void ConsumeNpcSnapshot();
+    void WritePosFeedbackNative();
 
     // Load Merlin CInterface functions from DLL
     bool LoadMerlinCInterface();
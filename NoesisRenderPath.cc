@@ -335,6 +335,160 @@ void NoesisRenderPath::Stop() {
     RenderPath3D::Stop();
 }
 
+void NoesisRenderPath::RenderMerlinBridgeWindow() {
+    // Time spent in each Lua entry point; whatever "Merlin Simulation" spends beyond
+    // merlinUpdate is C++ glue (sync points, native batch sync)
+    ImGui::SetNextWindowSize(ImVec2(520, 0), ImGuiCond_FirstUseEver);
+    if (!ImGui::Begin("Merlin Bridge")) {
+        ImGui::End();
+        return;
+    }
+
+    const ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg;
+    if (ImGui::BeginTable("MerlinBridgeCalls", 6, flags)) {
+        ImGui::TableSetupColumn("Entry point");
+        ImGui::TableSetupColumn("Calls");
+        ImGui::TableSetupColumn("Errors");
+        ImGui::TableSetupColumn("Last ms");
+        ImGui::TableSetupColumn("Avg ms");
+        ImGui::TableSetupColumn("Max ms");
+        ImGui::TableHeadersRow();
+
+        for (const MerlinBridgeStats &stats : gameStartup.merlinLua.GetBridgeStats()) {
+            if (stats.calls == 0)
+                continue;
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(stats.name);
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", (unsigned long long)stats.calls);
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", (unsigned long long)stats.errors);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", stats.lastMs);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", stats.totalMs / stats.calls);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", stats.maxMs);
+        }
+        ImGui::EndTable();
+    }
+
+    MerlinGcStats gc = gameStartup.merlinLua.GetGcStats();
+    if (gc.frames > 0) {
+        ImGui::Text("Lua GC: heap %.0f KB (%.0f KB after last cycle), %llu cycles", gc.heapKb,
+                    gc.heapAfterCycleKb, (unsigned long long)gc.cycles);
+        ImGui::Text("        last %.3f ms, avg %.3f ms, max %.3f ms, %llu frames over budget",
+                    gc.lastMs, gc.totalMs / gc.frames, gc.maxMs,
+                    (unsigned long long)gc.forcedFrames);
+    }
+    ImGui::End();
+}
+
+void NoesisRenderPath::RenderMerlinAiWindow() {
+    ImGui::SetNextWindowSize(ImVec2(560, 0), ImGuiCond_FirstUseEver);
+    if (!ImGui::Begin("Merlin AI")) {
+        ImGui::End();
+        return;
+    }
+
+    const MerlinAiProfile &profile = gameStartup.merlinLua.GetAiProfile();
+    if (profile.samples == 0) {
+        ImGui::Text("Waiting for the first sample (one cycle every %.0f ms)",
+                    gameStartup.GetMerlinAiProfileInterval());
+        ImGui::End();
+        return;
+    }
+
+    const AiProfileBuffer &last = profile.last;
+    ImGui::Text("Sample %llu, cycle %u: %d minds deliberating, %.3f ms",
+                (unsigned long long)profile.samples, last.cycle, last.minds, last.mindsMs);
+    ImGui::Text("endCycle %.3f ms, profiler overhead %.3f ms", last.endCycleMs, last.collectMs);
+    if (last.mindsMs > 0.0f) {
+        ImGui::Text("Rules read from the %d most expensive minds (%.0f%% of mind time)",
+                    last.attributedMinds, 100.0f * last.attributedMs / last.mindsMs);
+    } else {
+        ImGui::TextUnformatted("Minds not timed (Merlin without beginCycle/simMinds/endCycle): "
+                               "firing counts only");
+    }
+    ImGui::Text("Actions: %d buffers, %d active, %.1f commands/s, %.1f outcomes/s (%.1f failed)",
+                profile.actionBuffers, profile.activeCommands, profile.commandsPerSec,
+                profile.outcomesPerSec, profile.failuresPerSec);
+
+    // A mind's time is split evenly between the rules that fired in it
+    const ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg;
+    if (ImGui::CollapsingHeader("Rules, last sample", ImGuiTreeNodeFlags_DefaultOpen) &&
+        ImGui::BeginTable("MerlinAiRules", 3, flags)) {
+        ImGui::TableSetupColumn("Rule");
+        ImGui::TableSetupColumn("Fires");
+        ImGui::TableSetupColumn("Est. ms");
+        ImGui::TableHeadersRow();
+        for (int i = 0; i < last.ruleCount; i++) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(last.rules[i].name);
+            ImGui::TableNextColumn();
+            ImGui::Text("%u", last.rules[i].fires);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", last.rules[i].ms);
+        }
+        ImGui::EndTable();
+        if (last.unlistedRules > 0)
+            ImGui::Text("%d cheaper rules not listed", last.unlistedRules);
+    }
+
+    if (ImGui::CollapsingHeader("Rules, all samples") &&
+        ImGui::BeginTable("MerlinAiRuleTotals", 4, flags)) {
+        ImGui::TableSetupColumn("Rule");
+        ImGui::TableSetupColumn("Fires/sample");
+        ImGui::TableSetupColumn("Est. ms/sample");
+        ImGui::TableSetupColumn("Samples");
+        ImGui::TableHeadersRow();
+        for (const MerlinAiRuleStats &rule : profile.rules) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(rule.name.c_str());
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", (double)rule.fires / profile.samples);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", rule.ms / profile.samples);
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", (unsigned long long)rule.samples);
+        }
+        ImGui::EndTable();
+    }
+
+    if (ImGui::CollapsingHeader("Most expensive minds, last sample",
+                                ImGuiTreeNodeFlags_DefaultOpen) &&
+        ImGui::BeginTable("MerlinAiMinds", 6, flags)) {
+        ImGui::TableSetupColumn("NPC");
+        ImGui::TableSetupColumn("ms");
+        ImGui::TableSetupColumn("Rules");
+        ImGui::TableSetupColumn("Goals");
+        ImGui::TableSetupColumn("Tasks");
+        ImGui::TableSetupColumn("Actions");
+        ImGui::TableHeadersRow();
+        for (int i = 0; i < last.mindCount; i++) {
+            const AiMindSample &mind = last.topMinds[i];
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(mind.name);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", mind.ms);
+            ImGui::TableNextColumn();
+            ImGui::Text("%u", mind.firingRules);
+            ImGui::TableNextColumn();
+            ImGui::Text("%u", mind.currentGoals);
+            ImGui::TableNextColumn();
+            ImGui::Text("%u", mind.runningTasks);
+            ImGui::TableNextColumn();
+            ImGui::Text("%u", mind.runningActions);
+        }
+        ImGui::EndTable();
+    }
+    ImGui::End();
+}
+
 void NoesisRenderPath::Update(float dt) {
     // Start new ImGui frame (for profiler overlay)
     ImGui_ImplWin32_NewFrame();
@@ -342,6 +496,13 @@ void NoesisRenderPath::Update(float dt) {
 
     bool wasProfilerVisible = profilerWnd.IsVisible();
     profilerWnd.Render();
+    bool showMerlinWindows = profilerWnd.IsVisible() && !inMainMenuMode;
+    gameStartup.merlinLua.SetAiProfiling(
+        showMerlinWindows ? gameStartup.GetMerlinAiProfileInterval() : 0.0f);
+    if (showMerlinWindows) {
+        RenderMerlinBridgeWindow();
+        RenderMerlinAiWindow();
+    }
     // Detect if user closed the profiler via the X button
     if (wasProfilerVisible && !profilerWnd.IsVisible()) {
         SetThirdPersonMode(true);
@@ -368,7 +529,9 @@ void NoesisRenderPath::Update(float dt) {
             }
         }
         
-        // 3. Run Merlin simulation (with corrected positions from GRYM)
+        // 3. Run Merlin simulation (with corrected positions from GRYM).
+        //    In async mode this only exchanges data with the worker thread when it has
+        //    finished a tick; steps 1 and 2 are then queued for the next tick.
         {
             ScopedCPUProfiling("Merlin Simulation");
             gameStartup.merlinLua.Update(dt);
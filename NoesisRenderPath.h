@@ -181,6 +181,13 @@ class NoesisRenderPath : public wi::RenderPath3D {
     bool MouseWheel(int x, int y, int delta);
 
   private:
+    // Per-entry-point Lua bridge counters, shown next to the profiler window
+    void RenderMerlinBridgeWindow();
+
+    // Per-rule and per-mind AI cost and action buffer traffic (MerlinLua::SetAiProfiling);
+    // sampling only runs while the profiler window is open
+    void RenderMerlinAiWindow();
+
     // Helper function to find an element by name in the visual tree
     template <typename T>
     Noesis::Ptr<T> FindElementByName(Noesis::FrameworkElement *root, const char *name) {
@@ -0,0 +1,380 @@
+// Headless benchmark of the game <-> Merlin bridge (MerlinLua, the Lua scripts and the sync
+// buffers) at scale, against the stand-in Merlin library in MerlinStub.cc.
+//
+// Each frame does what NoesisRenderPath does for Merlin, in the same order: position feedback
+// for the NPCs near the player, player position, Update, then GetNpcStates with sim LOD tiers
+// by distance. GRYM is absent, so "spawned" NPCs are the ones within spawn range and the
+// positions fed back are the ones Merlin reported.
+//
+//   merlin_bridge_bench --merlin ../Merlin --npcs 10000 --frames 600 [--async]
+//
+// Options:
+//   --merlin <dir>         Merlin data directory (default: Merlin)
+//   --npcs <n>             NPCs to spawn (default: 10000)
+//   --frames <n>           frames to measure (default: 600)
+//   --warmup <n>           frames run before measuring (default: 60)
+//   --dt <seconds>         frame time (default: 1/60)
+//   --tick-rate <hz>       Merlin sim ticks per second (default: 10, 0 = one per frame)
+//   --frame-budget <ms>    per-frame Merlin budget (default: 0 = unbounded)
+//   --gc-budget <ms>       per-frame Lua GC budget (default: 0.5, 0 = automatic)
+//   --no-lod               don't send sim LOD tiers
+//   --async                run Merlin on its worker thread (frames are then paced to --dt, so
+//                          the worker gets the wall-clock time a real frame would give it)
+//   --benchmark-sync       also run MerlinLua::BenchmarkSyncPaths before measuring
+//   --ai-profile <ms>      sample the AI profiler every <ms> and print its rules and minds
+//   --record <file>        record the bridge inputs for merlin_bridge_replay (skips
+//                          --benchmark-sync, which would otherwise be replayed as game traffic)
+//   --pool-telemetry <dir> write Merlin's pool telemetry to <dir> at shutdown (see limitstuner.lua)
+//   --warm-start <dir>     resume from a warm-start snapshot in <dir>, saving one on the first
+//                          run (keyed on --npcs too; not with --record)
+//   --data-cache <dir>     keep the compiled data cache in <dir> (run twice for cold vs. warm)
+//   --heightfield <file>   share a terrain heightfield with Merlin (baked on the first run), and
+//                          snap the spawn points and waypoints to it, timing the batched query
+//                          against one Merlin call per point
+
+#include "MerlinLua.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct BenchOptions {
+    std::string merlinPath = "Merlin";
+    int npcs = 10000;
+    int frames = 600;
+    int warmup = 60;
+    float dt = 1.0f / 60.0f;
+    float tickRate = 10.0f;
+    int maxCatchUpTicks = 3;
+    float frameBudgetMs = 0.0f;
+    float gcBudgetMs = 0.5f;
+    float aiProfileMs = 0.0f;
+    bool lod = true;
+    bool async = false;
+    bool benchmarkSync = false;
+    std::string recordPath;
+    std::string poolTelemetryDir;
+    std::string warmStartDir;
+    std::string dataCacheDir;
+    std::string heightfieldPath;
+};
+
+// Same ranges as GameStartup's defaults
+constexpr float kSpawnRange = 100.0f;
+constexpr float kLodRingRange = 300.0f;
+constexpr int kLodRingInterval = 4;
+constexpr int kLodBackgroundInterval = 20;
+
+bool ParseOptions(int argc, char **argv, BenchOptions &options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (arg == "--async") {
+            options.async = true;
+        } else if (arg == "--no-lod") {
+            options.lod = false;
+        } else if (arg == "--benchmark-sync") {
+            options.benchmarkSync = true;
+        } else if (value && arg == "--merlin") {
+            options.merlinPath = value, i++;
+        } else if (value && arg == "--record") {
+            options.recordPath = value, i++;
+        } else if (value && arg == "--pool-telemetry") {
+            options.poolTelemetryDir = value, i++;
+        } else if (value && arg == "--warm-start") {
+            options.warmStartDir = value, i++;
+        } else if (value && arg == "--data-cache") {
+            options.dataCacheDir = value, i++;
+        } else if (value && arg == "--heightfield") {
+            options.heightfieldPath = value, i++;
+        } else if (value && arg == "--npcs") {
+            options.npcs = std::atoi(value), i++;
+        } else if (value && arg == "--frames") {
+            options.frames = std::atoi(value), i++;
+        } else if (value && arg == "--warmup") {
+            options.warmup = std::atoi(value), i++;
+        } else if (value && arg == "--dt") {
+            options.dt = (float)std::atof(value), i++;
+        } else if (value && arg == "--tick-rate") {
+            options.tickRate = (float)std::atof(value), i++;
+        } else if (value && arg == "--frame-budget") {
+            options.frameBudgetMs = (float)std::atof(value), i++;
+        } else if (value && arg == "--gc-budget") {
+            options.gcBudgetMs = (float)std::atof(value), i++;
+        } else if (value && arg == "--ai-profile") {
+            options.aiProfileMs = (float)std::atof(value), i++;
+        } else {
+            fprintf(stderr, "Unknown or incomplete option: %s\n", arg.c_str());
+            return false;
+        }
+    }
+    return options.npcs > 0 && options.frames > 0;
+}
+
+// Spawn points on a square grid 4 m apart, nearest to the origin first (so the NPCs the sync
+// sees first are the ones around the player)
+std::vector<XMFLOAT3> GridSpawnPoints(int count) {
+    std::vector<XMFLOAT3> points;
+    points.reserve(count);
+    int side = (int)std::ceil(std::sqrt((double)count));
+    float half = (side - 1) * 4.0f * 0.5f;
+    for (int i = 0; i < count; i++) {
+        points.emplace_back((i % side) * 4.0f - half, 0.0f, (i / side) * 4.0f - half);
+    }
+    std::stable_sort(points.begin(), points.end(), [](const XMFLOAT3 &a, const XMFLOAT3 &b) {
+        return a.x * a.x + a.z * a.z < b.x * b.x + b.z * b.z;
+    });
+    return points;
+}
+
+// 16 waypoints on a ring around the origin, 150 m out
+std::vector<XMFLOAT3> RingWaypoints() {
+    std::vector<XMFLOAT3> points;
+    for (int i = 0; i < 16; i++) {
+        float angle = i * 6.2831853f / 16;
+        points.emplace_back(std::cos(angle) * 150.0f, 0.0f, std::sin(angle) * 150.0f);
+    }
+    return points;
+}
+
+// The player walks a circle 60 m out at 1.4 m/s, so NPCs keep entering and leaving spawn range
+XMFLOAT3 PlayerPosition(int frame, float dt) {
+    float angle = frame * dt * 1.4f / 60.0f;
+    return XMFLOAT3(std::cos(angle) * 60.0f, 0.0f, std::sin(angle) * 60.0f);
+}
+
+float Distance(const XMFLOAT3 &a, float x, float y, float z) {
+    float dx = a.x - x, dy = a.y - y, dz = a.z - z;
+    return std::sqrt(dx * dx + dy * dy + dz * dz);
+}
+
+double Percentile(std::vector<double> sorted, double fraction) {
+    if (sorted.empty())
+        return 0.0;
+    std::sort(sorted.begin(), sorted.end());
+    size_t index = std::min(sorted.size() - 1, (size_t)(fraction * (sorted.size() - 1) + 0.5));
+    return sorted[index];
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    BenchOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        fprintf(stderr, "Options are listed at the top of Tools/MerlinStub/BridgeBench.cc\n");
+        return 2;
+    }
+
+    MerlinLua merlinLua;
+    int syncCapacity = std::clamp(options.npcs, MerlinLua::kDefaultSyncCapacity,
+                                  MerlinLua::kMaxSyncCapacity);
+    if (!options.warmStartDir.empty() && options.recordPath.empty()) {
+        merlinLua.SetWarmStart(options.warmStartDir, {},
+                               "bench npcs=" + std::to_string(options.npcs));
+    }
+    if (!options.dataCacheDir.empty())
+        merlinLua.SetDataCache(options.dataCacheDir);
+    if (!options.heightfieldPath.empty())
+        merlinLua.SetHeightfield(options.heightfieldPath);
+    auto initStart = std::chrono::high_resolution_clock::now();
+    if (!merlinLua.Initialize(options.merlinPath, "", syncCapacity)) {
+        fprintf(stderr, "MerlinLua::Initialize failed (is --merlin the Merlin data directory?)\n");
+        return 1;
+    }
+    if (!options.recordPath.empty() && !merlinLua.StartRecording(options.recordPath)) {
+        fprintf(stderr, "Cannot record to %s\n", options.recordPath.c_str());
+        return 1;
+    }
+    merlinLua.SetFrameBudget(options.frameBudgetMs);
+    merlinLua.SetSimTickRate(options.tickRate, options.maxCatchUpTicks);
+    merlinLua.SetSimLodIntervals(kLodRingInterval, kLodBackgroundInterval);
+
+    // Ground snapping as GameStartup does it, then the same points one Merlin call each
+    std::vector<XMFLOAT3> spawnPoints = GridSpawnPoints(options.npcs);
+    std::vector<XMFLOAT3> waypoints = RingWaypoints();
+    double snapMs = 0.0, perPointMs = 0.0;
+    if (merlinLua.HasHeightfield()) {
+        auto snapStart = std::chrono::high_resolution_clock::now();
+        merlinLua.SnapToTerrain(spawnPoints);
+        merlinLua.SnapToTerrain(waypoints);
+        auto snapEnd = std::chrono::high_resolution_clock::now();
+        snapMs = std::chrono::duration<double, std::milli>(snapEnd - snapStart).count();
+        if (MerlinLua::terrainElevations) {
+            float mismatch = 0.0f;
+            for (const XMFLOAT3 &point : spawnPoints) {
+                float ground[2] = {point.x, point.z}, elevation = 0.0f;
+                MerlinLua::terrainElevations(ground, &elevation, 1);
+                mismatch = std::max(mismatch, std::fabs(std::max(elevation, 0.0f) - point.y));
+            }
+            perPointMs = std::chrono::duration<double, std::milli>(
+                             std::chrono::high_resolution_clock::now() - snapEnd)
+                             .count();
+            printf("Heightfield vs. Merlin terrain: up to %.3f m apart at the spawn points\n",
+                   mismatch);
+        }
+    }
+
+    auto loadStart = std::chrono::high_resolution_clock::now();
+    merlinLua.CreatePlayer(PlayerPosition(0, options.dt));
+    merlinLua.CreateNpcs(spawnPoints, {"Models/npc.grs"}, waypoints);
+    double loadMs = std::chrono::duration<double, std::milli>(
+                        std::chrono::high_resolution_clock::now() - loadStart)
+                        .count();
+    double startupMs = std::chrono::duration<double, std::milli>(
+                           std::chrono::high_resolution_clock::now() - initStart)
+                           .count();
+
+    if (options.benchmarkSync) {
+        merlinLua.BenchmarkSyncPaths(100);
+    }
+    merlinLua.SetGcBudget(options.gcBudgetMs);
+    merlinLua.SetAiProfiling(options.aiProfileMs);
+    merlinLua.SetPoolTelemetryDir(options.poolTelemetryDir);
+    if (options.async) {
+        merlinLua.StartAsyncSimulation();
+    }
+
+    std::vector<double> frameMs;
+    frameMs.reserve(options.frames);
+    size_t visibleNpcs = 0;
+    size_t nearNpcs = 0;
+    uint64_t removedNpcs = 0;
+    std::vector<XMFLOAT3> feedbackPositions;
+    std::vector<uint64_t> feedbackIds;
+
+    for (int frame = 0; frame < options.warmup + options.frames; frame++) {
+        auto frameStart = std::chrono::high_resolution_clock::now();
+        XMFLOAT3 playerPos = PlayerPosition(frame, options.dt);
+
+        // 1. Position feedback for the NPCs that would have a GRYM entity
+        merlinLua.BeginPositionFeedback();
+        for (size_t i = 0; i < feedbackIds.size(); i++) {
+            merlinLua.AddPositionFeedback(feedbackIds[i], feedbackPositions[i]);
+        }
+        merlinLua.ApplyPositionFeedback();
+
+        // 2-3. Player position, simulation
+        merlinLua.UpdatePlayerPosition(playerPos);
+        merlinLua.Update(options.dt);
+
+        // 5. NPC states and sim LOD tiers
+        std::span<const NpcState> npcStates = merlinLua.GetNpcStates();
+        feedbackIds.clear();
+        feedbackPositions.clear();
+        if (options.lod)
+            merlinLua.BeginSimTiers();
+        for (const NpcState &npcState : npcStates) {
+            float distance = Distance(playerPos, npcState.x, npcState.y, npcState.z);
+            if (distance <= kSpawnRange) {
+                feedbackIds.push_back(npcState.merlinId);
+                feedbackPositions.emplace_back(npcState.x, npcState.y, npcState.z);
+            }
+            if (options.lod) {
+                int tier = distance <= kSpawnRange   ? SIM_TIER_FULL
+                           : distance <= kLodRingRange ? SIM_TIER_RING
+                                                       : SIM_TIER_BACKGROUND;
+                merlinLua.AddSimTier(npcState.merlinId, tier);
+            }
+        }
+        if (options.lod)
+            merlinLua.CommitSimTiers();
+
+        double elapsedMs = std::chrono::duration<double, std::milli>(
+                               std::chrono::high_resolution_clock::now() - frameStart)
+                               .count();
+        if (options.async && elapsedMs < options.dt * 1000.0) {
+            std::this_thread::sleep_for(
+                std::chrono::duration<double, std::milli>(options.dt * 1000.0 - elapsedMs));
+        }
+
+        if (frame < options.warmup)
+            continue;
+        frameMs.push_back(elapsedMs);
+        visibleNpcs = npcStates.size();
+        nearNpcs = std::max(nearNpcs, feedbackIds.size());
+        removedNpcs += merlinLua.GetRemovedNpcs().size();
+    }
+
+    if (options.async) {
+        merlinLua.StopAsyncSimulation();
+    }
+
+    double totalMs = 0.0;
+    for (double ms : frameMs)
+        totalMs += ms;
+    printf("\n=== Merlin bridge benchmark (%s) ===\n", options.async ? "async" : "sync");
+    printf("NPCs: %d spawned, %zu visible to sync, up to %zu in spawn range, %llu removed\n",
+           options.npcs, visibleNpcs, nearNpcs, (unsigned long long)removedNpcs);
+    printf("Load: %.1f ms (start-up including Initialize: %.1f ms, %s start)\n", loadMs,
+           startupMs, merlinLua.IsWarmStarted() ? "warm" : "cold");
+    if (!options.dataCacheDir.empty()) {
+        const MerlinDataCacheStats &cache = merlinLua.GetDataCacheStats();
+        printf("Data parse: %.1f ms, %d of %d files reused, %d compiled (hashing %.1f ms)\n",
+               cache.parseMs, cache.reused, cache.sources, cache.compiled, cache.hashMs);
+    }
+    if (merlinLua.HasHeightfield()) {
+        printf("Terrain: %zu points snapped in %.3f ms batched, %.3f ms at one Merlin call each\n",
+               spawnPoints.size() + waypoints.size(), snapMs, perPointMs);
+    }
+    printf("Frame: avg %.3f ms, p50 %.3f ms, p99 %.3f ms, max %.3f ms over %d frames\n",
+           totalMs / frameMs.size(), Percentile(frameMs, 0.5), Percentile(frameMs, 0.99),
+           Percentile(frameMs, 1.0), options.frames);
+
+    printf("\n%-28s %10s %8s %12s %10s %10s\n", "Bridge entry", "calls", "errors", "total ms",
+           "avg ms", "max ms");
+    for (const MerlinBridgeStats &stats : merlinLua.GetBridgeStats()) {
+        if (stats.calls == 0)
+            continue;
+        printf("%-28s %10llu %8llu %12.2f %10.4f %10.4f\n", stats.name,
+               (unsigned long long)stats.calls, (unsigned long long)stats.errors, stats.totalMs,
+               stats.totalMs / stats.calls, stats.maxMs);
+    }
+
+    MerlinSyncStats sync = merlinLua.GetSyncStats();
+    printf("\nSync: capacity %d, %llu overflow fills, %llu entries deferred, %llu dropped\n",
+           sync.npcCapacity, (unsigned long long)sync.npcOverflowFills,
+           (unsigned long long)sync.npcEntriesDeferred, (unsigned long long)sync.entriesDropped);
+
+    MerlinBudgetStats budget = merlinLua.GetBudgetStats();
+    printf("Budget: %llu cycles, %llu overruns, %llu ticks dropped, max frame %.3f ms\n",
+           (unsigned long long)budget.cyclesCompleted, (unsigned long long)budget.overruns,
+           (unsigned long long)budget.ticksDropped, budget.maxFrameMs);
+
+    MerlinGcStats gc = merlinLua.GetGcStats();
+    printf("Lua GC: heap %.0f KB, %llu cycles, %llu forced frames, avg %.3f ms, max %.3f ms\n",
+           gc.heapKb, (unsigned long long)gc.cycles, (unsigned long long)gc.forcedFrames,
+           gc.frames ? gc.totalMs / gc.frames : 0.0, gc.maxMs);
+
+    const MerlinAiProfile &profile = merlinLua.GetAiProfile();
+    if (profile.samples > 0) {
+        const AiProfileBuffer &last = profile.last;
+        printf("\nAI profile: %llu samples; last: %d minds, %.3f ms deliberating, endCycle "
+               "%.3f ms, profiler %.3f ms\n",
+               (unsigned long long)profile.samples, last.minds, last.mindsMs, last.endCycleMs,
+               last.collectMs);
+        printf("Actions: %d buffers, %.1f commands/s, %.1f outcomes/s\n", profile.actionBuffers,
+               profile.commandsPerSec, profile.outcomesPerSec);
+        printf("%-40s %14s %14s\n", "Rule", "fires/sample", "ms/sample");
+        for (const MerlinAiRuleStats &rule : profile.rules) {
+            printf("%-40s %14.1f %14.3f\n", rule.name.c_str(),
+                   (double)rule.fires / profile.samples, rule.ms / profile.samples);
+        }
+        printf("%-40s %10s %6s %6s\n", "Most expensive minds (last sample)", "ms", "rules",
+               "goals");
+        for (int i = 0; i < last.mindCount; i++) {
+            printf("%-40.40s %10.4f %6u %6u\n", last.topMinds[i].name, last.topMinds[i].ms,
+                   last.topMinds[i].firingRules, last.topMinds[i].currentGoals);
+        }
+    }
+
+    merlinLua.Shutdown();
+    return 0;
+}
@@ -0,0 +1,109 @@
+// Replays a Merlin bridge recording (written by the game with [merlin] bridge_recording, or by
+// merlin_bridge_bench --record) into Merlin without the game, then reports the simulation time
+// per frame and whether the NPC state hash matches the recording.
+//
+//   merlin_bridge_replay --merlin ../Merlin session.mbr [--csv frames.csv]
+//
+// Replays against whichever Merlin library sits next to the executable: the stand-in from
+// MerlinStub.cc, or a real Merlin build for recordings of real play sessions.
+//
+// Exit code: 0 when the replay reproduces the recorded state, 1 when it diverges, 2 when the
+// recording can't be replayed.
+
+#include "MerlinLua.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace {
+
+double Percentile(std::vector<double> sorted, double fraction) {
+    if (sorted.empty())
+        return 0.0;
+    std::sort(sorted.begin(), sorted.end());
+    size_t index = std::min(sorted.size() - 1, (size_t)(fraction * (sorted.size() - 1) + 0.5));
+    return sorted[index];
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::string merlinPath = "Merlin";
+    std::string recordingPath;
+    std::string csvPath;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--merlin" && i + 1 < argc) {
+            merlinPath = argv[++i];
+        } else if (arg == "--csv" && i + 1 < argc) {
+            csvPath = argv[++i];
+        } else if (recordingPath.empty() && arg.rfind("--", 0) != 0) {
+            recordingPath = arg;
+        } else {
+            fprintf(stderr, "Unknown or incomplete option: %s\n", arg.c_str());
+            return 2;
+        }
+    }
+    if (recordingPath.empty()) {
+        fprintf(stderr, "Usage: merlin_bridge_replay [--merlin <dir>] [--csv <file>] <recording>\n");
+        return 2;
+    }
+
+    MerlinLua merlinLua;
+    MerlinReplayReport report;
+    if (!merlinLua.Replay(merlinPath, recordingPath, report)) {
+        fprintf(stderr, "Replay of %s failed\n", recordingPath.c_str());
+        return 2;
+    }
+
+    std::vector<double> frameMs;
+    frameMs.reserve(report.frames.size());
+    double totalMs = 0.0;
+    for (const MerlinReplayFrame &frame : report.frames) {
+        frameMs.push_back(frame.simMs);
+        totalMs += frame.simMs;
+    }
+
+    if (!csvPath.empty()) {
+        FILE *csv = fopen(csvPath.c_str(), "w");
+        if (csv) {
+            fprintf(csv, "frame,sim_ms,state_hash\n");
+            for (size_t i = 0; i < report.frames.size(); i++) {
+                fprintf(csv, "%zu,%.4f,%016llx\n", i, report.frames[i].simMs,
+                        (unsigned long long)report.frames[i].stateHash);
+            }
+            fclose(csv);
+        } else {
+            fprintf(stderr, "Cannot write %s\n", csvPath.c_str());
+        }
+    }
+
+    size_t frames = report.frames.size();
+    printf("\n=== Merlin bridge replay: %s ===\n", recordingPath.c_str());
+    printf("Frames: %zu (%s)%s\n", frames, report.asyncRecording ? "async, one per tick" : "sync",
+           report.truncated ? ", recording truncated" : "");
+    printf("Sim: total %.1f ms, avg %.3f ms, p50 %.3f ms, p99 %.3f ms, max %.3f ms\n", totalMs,
+           frames ? totalMs / frames : 0.0, Percentile(frameMs, 0.5), Percentile(frameMs, 0.99),
+           Percentile(frameMs, 1.0));
+    printf("State hash: %016llx (recorded %016llx)\n", (unsigned long long)report.stateHash,
+           (unsigned long long)report.recordedHash);
+
+    int exitCode = 0;
+    if (report.firstDivergentFrame >= 0) {
+        printf("DIVERGED at frame %lld\n", (long long)report.firstDivergentFrame);
+        exitCode = 1;
+    } else {
+        printf("Reproduced the recorded state\n");
+    }
+    if (report.maxFrameBudgetMs > 0.0f) {
+        printf("Note: recorded with a %.2f ms frame budget; budgeted cycles split on wall-clock "
+               "time, so hashes may differ between runs\n",
+               report.maxFrameBudgetMs);
+    }
+
+    merlinLua.Shutdown();
+    return exitCode;
+}
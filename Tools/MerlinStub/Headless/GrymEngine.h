@@ -0,0 +1,63 @@
+#pragma once
+
+// The few GRYM engine pieces MerlinLua uses, for building it outside the engine
+// (merlin_bridge_bench). Logging goes to stdout; profiler ranges are no-ops.
+
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+
+struct XMFLOAT3 {
+    float x, y, z;
+    XMFLOAT3() = default;
+    XMFLOAT3(float x, float y, float z) : x(x), y(y), z(z) {}
+};
+
+#ifndef _WIN32
+#define _TRUNCATE ((size_t)-1)
+
+template <size_t N> inline int sprintf_s(char (&buffer)[N], const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(buffer, N, format, args);
+    va_end(args);
+    return written;
+}
+
+template <size_t N> inline int strncpy_s(char (&dest)[N], const char *src, size_t) {
+    snprintf(dest, N, "%s", src);
+    return 0;
+}
+#endif
+
+namespace wi {
+namespace backlog {
+inline void post(const std::string &text) { fputs(text.c_str(), stdout); }
+} // namespace backlog
+
+namespace helper {
+inline std::string GetExecutablePath() {
+#ifdef _WIN32
+    return std::filesystem::current_path().string() + "/";
+#else
+    return std::filesystem::read_symlink("/proc/self/exe").string();
+#endif
+}
+
+// Directory part of a path, including the trailing separator
+inline std::string GetDirectoryFromPath(const std::string &path) {
+    size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
+} // namespace helper
+
+namespace profiler {
+using range_id = size_t;
+enum PROFILER_DOMAIN { DOMAIN_CPU, DOMAIN_GPU };
+inline range_id BeginRange(const char *, PROFILER_DOMAIN) { return 0; }
+inline void EndRange(range_id) {}
+} // namespace profiler
+} // namespace wi
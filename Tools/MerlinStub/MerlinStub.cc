@@ -0,0 +1,1772 @@
+// Stand-in Merlin shared library for headless benchmarking of the game <-> Merlin bridge.
+//
+// Implements the C interface declared in Merlin/Game/Scripts/mx.lua plus the entry points
+// MerlinLua loads natively (worldPos, queryHstr, action buffer registration, batched sync, pool
+// telemetry, terrain), with a trivial world model: entities are bounds plus an attribute map, and
+// NPCs walk between the scene's waypoints (or around their spawn point) a fixed distance per
+// cycle. The terrain is a made-up island of hills (or the heightfield MerlinLua shares), which
+// only answers queries: NPCs walk on their own heights. There are no minds, rules or language;
+// pattern functions just hand out fresh symbols.
+//
+// Built as libmerlin.so / merlin.dll by Tools/MerlinStub/CMakeLists.txt. Not thread-safe, like
+// the real library: one thread drives it at a time.
+//
+// Environment:
+//   MERLIN_STUB_BIRTH_EVERY   cycles between calls of the registered "giveBirth" callback
+//                             (0 = never, the default); exercises Lua re-entry from sim()
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#define MERLIN_STUB_API extern "C" __declspec(dllexport)
+#else
+#define MERLIN_STUB_API extern "C" __attribute__((visibility("default")))
+#endif
+
+// ---------------------------------------------------------------------------
+// C interface types (must match the cdef in mx.lua)
+// ---------------------------------------------------------------------------
+
+enum { kAttrCapacityPerSystem = 64 };
+enum { kVarBindingsCapacity = 64, kSymbolArrayCapacity = 256, kStringCapacity = 512 };
+
+struct CountsTable {
+    char *attrNames[kAttrCapacityPerSystem];
+    int counts[kAttrCapacityPerSystem];
+    int size;
+};
+
+struct ValueTable {
+    char *valueNames[kAttrCapacityPerSystem];
+    double freqs[kAttrCapacityPerSystem];
+    int size;
+};
+
+struct AttrTable {
+    char *attrNames[kAttrCapacityPerSystem];
+    ValueTable valueTables[kAttrCapacityPerSystem];
+    int counts[kAttrCapacityPerSystem];
+    int size;
+};
+
+struct MerlinVarBindings {
+    const char *varNames[kVarBindingsCapacity];
+    uint64_t values[kVarBindingsCapacity];
+    int numBindings;
+};
+
+struct MerlinSymbolArray {
+    uint64_t buffer[kSymbolArrayCapacity];
+    int size;
+};
+
+struct MerlinActArray {
+    uint64_t acts[kSymbolArrayCapacity];
+    int numCauses[kSymbolArrayCapacity];
+    uint64_t causes[kSymbolArrayCapacity][64];
+    uint64_t outcompetedBy[kSymbolArrayCapacity];
+    float util[kSymbolArrayCapacity];
+    int size;
+};
+
+struct MerlinString {
+    char buffer[kStringCapacity];
+};
+
+enum {
+    MERLIN_ACTS_PROPOSED_TASKS = 1,
+    MERLIN_ACTS_RUNNING_TASKS = 2,
+    MERLIN_ACTS_PROPOSED_ACTIONS = 4,
+    MERLIN_ACTS_RUNNING_ACTIONS = 8,
+};
+
+struct MerlinPoolStats {
+    char name[64];
+    uint32_t maxItems;
+    uint32_t initReserved;
+    uint32_t growthStride;
+    uint32_t instances;
+    uint64_t current;
+    uint32_t peak;
+    uint32_t growths;
+};
+
+struct MerlinActFilter {
+    uint32_t kinds;
+    float minUtil;
+    int32_t maxCausesPerAct;
+};
+
+struct MerlinActRow {
+    uint64_t act;
+    uint64_t outcompetedBy;
+    float util;
+    uint16_t kind;
+    uint16_t numCauses;
+    int32_t firstCause;
+};
+
+struct MerlinFloat3 {
+    float floats[3];
+};
+
+struct MerlinQuat {
+    float floats[4];
+};
+
+struct MerlinObb {
+    float floats[10]; // position, scale, rotation quaternion
+};
+
+struct MerlinSectorArray {
+    MerlinFloat3 *minCoords;
+    MerlinFloat3 *maxCoords;
+    int size;
+};
+
+struct MerlinCompiledSource {
+    const char *path;
+    const void *data;
+    uint64_t size;
+};
+typedef void (*CompiledSink)(void *, const char *, const void *, uint64_t);
+
+struct MerlinHeightfield {
+    const float *heights; // width x depth, row-major along x
+    int32_t width;
+    int32_t depth;
+    float originX;
+    float originZ;
+    float spacing;
+};
+
+struct MerlinLayoutObject {
+    MerlinObb bounds;
+    uint32_t kind; // string table offsets
+    uint32_t name;
+    int32_t parent; // earlier object of the same call, -1 for a root
+};
+
+typedef uint64_t (*MerlinCallback)(uint64_t, uint64_t, uint64_t, uint64_t);
+typedef void (*SoundCallback)(uint64_t);
+
+struct ForeignActionCommandBuffer; // opaque here: registered buffers are only counted
+
+// ---------------------------------------------------------------------------
+// World model
+// ---------------------------------------------------------------------------
+
+namespace {
+
+// Symbols carry their kind in the top byte and an index in the rest. 0 is @nothing.
+enum SymbolTag : uint64_t {
+    TAG_HSTR = 1,
+    TAG_ENTITY = 2,
+    TAG_OBB = 3, // the bounds attribute of an entity
+    TAG_FLOAT = 4,
+    TAG_LIST = 5,
+    TAG_SENTENCE = 6,
+    TAG_KNOWLEDGE = 7, // a shared knowledge set (makeKnowledge)
+};
+
+uint64_t MakeSymbol(SymbolTag tag, uint64_t index) { return (uint64_t(tag) << 56) | index; }
+SymbolTag TagOf(uint64_t symbol) { return SymbolTag(symbol >> 56); }
+uint64_t IndexOf(uint64_t symbol) { return symbol & ((uint64_t(1) << 56) - 1); }
+
+constexpr float kCycleSeconds = 0.1f; // sim time one cycle represents
+constexpr float kWalkSpeed = 1.4f;    // m/s
+constexpr float kWanderRadius = 30.0f;
+
+struct Entity {
+    std::string system;
+    std::string kind;
+    MerlinObb obb = {};
+    uint64_t parent = 0;
+    std::unordered_map<std::string, uint64_t> attrs;
+    // NPC locomotion
+    bool npc = false;
+    float home[3] = {};
+    float target[3] = {};
+    std::vector<uint64_t> firingRules; // rules that "fired" in its last deliberation
+    std::vector<uint32_t> knowledge;   // shared knowledge sets it believes (never revised here)
+};
+
+// A MerlinLimits.txt pool. The stand-in has no pools of its own, so a few are modelled on its
+// containers (see TrackPools); per-mind pools grow together, since every NPC holds the same.
+struct Pool {
+    std::string name;
+    uint32_t maxItems = 0;
+    uint32_t initReserved = 0;
+    uint32_t growthStride = 1;
+    uint32_t capacity = 0; // per instance: initReserved plus whole growth strides
+    uint32_t instances = 0;
+    uint64_t current = 0;
+    uint32_t peak = 0;
+    uint32_t growths = 0;
+};
+
+struct World {
+    std::string rootPath;
+    std::string basePath;
+    std::mt19937 rng{42};
+
+    std::deque<std::string> hstrs; // stable storage: c_str() pointers are handed out
+    std::unordered_map<std::string, uint64_t> hstrIndex;
+    std::vector<float> floats;
+    std::vector<std::vector<uint64_t>> lists;
+    uint64_t sentences = 0;
+    // Shared knowledge sets: the beliefs each instantiated. Kept for the world's lifetime, since
+    // minds share them.
+    std::vector<std::vector<uint64_t>> knowledge;
+
+    std::vector<Entity> entities;
+    std::vector<uint64_t> npcs;
+    std::vector<uint64_t> waypoints;
+    // makeWorldFromTerrain's sectors (ground along x and z, elevation range along y)
+    std::vector<MerlinFloat3> sectorMins;
+    std::vector<MerlinFloat3> sectorMaxs;
+
+    std::unordered_map<std::string, MerlinCallback> callbacks;
+    SoundCallback soundCallback = nullptr;
+    std::unordered_map<uint64_t, ForeignActionCommandBuffer *> actionBuffers;
+
+    uint64_t seconds = 0;
+    uint32_t cycle = 0;
+    int birthEvery = 0;
+    uint64_t goToWaypointRule = 0;
+    uint64_t goTask = 0;     // what every NPC intends: walk to its target
+    uint64_t idleTask = 0;   // the proposal go outcompetes
+    uint64_t walkAction = 0;
+    uint64_t mind = 0; // entered mind (@nothing = absolute)
+    std::vector<Pool> pools;
+    // Strings of worlds replaced by loadSnapshot, whose c_str() pointers callers may still hold
+    std::vector<std::deque<std::string>> retiredHstrs;
+};
+
+World *world = nullptr;
+// Bumped whenever the NPC roster changes. Outlives the world, so a restarted world never reports
+// a version a cache has already seen.
+uint32_t rosterVersionCounter = 0;
+
+// Compiled sources for the next start() (see useCompiledSources), by path relative to the data
+// directory
+std::unordered_map<std::string, std::string_view> compiledSources;
+CompiledSink compiledSink = nullptr;
+void *compiledSinkContext = nullptr;
+
+// Heightfield handed over by useHeightfield, used until stop() (heights == nullptr: the island)
+MerlinHeightfield sharedHeightfield = {};
+
+World &W() {
+    if (!world)
+        world = new World();
+    return *world;
+}
+
+uint64_t Hstr(const std::string &str) {
+    World &w = W();
+    auto it = w.hstrIndex.find(str);
+    if (it != w.hstrIndex.end())
+        return it->second;
+    uint64_t symbol = MakeSymbol(TAG_HSTR, w.hstrs.size() + 1);
+    w.hstrs.push_back(str);
+    w.hstrIndex.emplace(str, symbol);
+    return symbol;
+}
+
+const std::string *HstrString(uint64_t symbol) {
+    World &w = W();
+    uint64_t index = IndexOf(symbol);
+    if (TagOf(symbol) != TAG_HSTR || index == 0 || index > w.hstrs.size())
+        return nullptr;
+    return &w.hstrs[index - 1];
+}
+
+Entity *EntityOf(uint64_t symbol) {
+    World &w = W();
+    SymbolTag tag = TagOf(symbol);
+    uint64_t index = IndexOf(symbol);
+    if ((tag != TAG_ENTITY && tag != TAG_OBB) || index == 0 || index > w.entities.size())
+        return nullptr;
+    return &w.entities[index - 1];
+}
+
+float Random01() { return std::uniform_real_distribution<float>(0.0f, 1.0f)(W().rng); }
+
+void PickTarget(Entity &npc) {
+    World &w = W();
+    if (!w.waypoints.empty()) {
+        uint64_t waypoint = w.waypoints[W().rng() % w.waypoints.size()];
+        const Entity *wp = EntityOf(waypoint);
+        std::copy(wp->obb.floats, wp->obb.floats + 3, npc.target);
+        return;
+    }
+    float angle = Random01() * 6.2831853f;
+    float radius = Random01() * kWanderRadius;
+    npc.target[0] = npc.home[0] + std::cos(angle) * radius;
+    npc.target[1] = npc.home[1];
+    npc.target[2] = npc.home[2] + std::sin(angle) * radius;
+}
+
+void StepNpc(Entity &npc) {
+    float *pos = npc.obb.floats;
+    float dx = npc.target[0] - pos[0];
+    float dz = npc.target[2] - pos[2];
+    float distance = std::sqrt(dx * dx + dz * dz);
+    float step = kWalkSpeed * kCycleSeconds;
+    // Walking to a waypoint is Npc.mc's go-to-waypoint rule, reported to the AI profiler
+    npc.firingRules.assign(1, W().goToWaypointRule);
+    if (distance <= step) {
+        pos[0] = npc.target[0];
+        pos[2] = npc.target[2];
+        PickTarget(npc);
+        return;
+    }
+    pos[0] += dx / distance * step;
+    pos[2] += dz / distance * step;
+}
+
+uint64_t MakeEntity(const char *systemName, const char *kindStr, const MerlinObb &obb,
+                    uint64_t parent) {
+    World &w = W();
+    Entity entity;
+    entity.system = systemName ? systemName : "";
+    entity.kind = kindStr ? kindStr : "";
+    entity.obb = obb;
+    entity.parent = parent;
+    entity.attrs["isa"] = Hstr(entity.kind);
+    w.entities.push_back(std::move(entity));
+    uint64_t symbol = MakeSymbol(TAG_ENTITY, w.entities.size());
+
+    Entity &added = w.entities.back();
+    if (added.system == "human_npc") {
+        added.npc = true;
+        std::copy(obb.floats, obb.floats + 3, added.home);
+        std::copy(obb.floats, obb.floats + 3, added.target);
+        w.npcs.push_back(symbol);
+        rosterVersionCounter++;
+    } else if (added.system == "waypoint") {
+        w.waypoints.push_back(symbol);
+    }
+    return symbol;
+}
+
+uint64_t MakeList(std::vector<uint64_t> symbols) {
+    World &w = W();
+    w.lists.push_back(std::move(symbols));
+    return MakeSymbol(TAG_LIST, w.lists.size());
+}
+
+MerlinSymbolArray ToArray(const std::vector<uint64_t> &symbols) {
+    MerlinSymbolArray array = {};
+    array.size = (int)std::min<size_t>(symbols.size(), kSymbolArrayCapacity);
+    std::copy_n(symbols.begin(), array.size, array.buffer);
+    return array;
+}
+
+std::string SymbolString(uint64_t symbol) {
+    World &w = W();
+    if (symbol == 0)
+        return "@nothing";
+    char text[64];
+    switch (TagOf(symbol)) {
+    case TAG_HSTR:
+        if (const std::string *str = HstrString(symbol))
+            return *str;
+        break;
+    case TAG_ENTITY:
+    case TAG_OBB:
+        if (const Entity *entity = EntityOf(symbol)) {
+            snprintf(text, sizeof(text), "%s%s#%llu", TagOf(symbol) == TAG_OBB ? "obb:" : "",
+                     entity->system.c_str(), (unsigned long long)IndexOf(symbol));
+            return text;
+        }
+        break;
+    case TAG_FLOAT:
+        if (IndexOf(symbol) > 0 && IndexOf(symbol) <= w.floats.size()) {
+            snprintf(text, sizeof(text), "%g", w.floats[IndexOf(symbol) - 1]);
+            return text;
+        }
+        break;
+    case TAG_LIST:
+        if (IndexOf(symbol) > 0 && IndexOf(symbol) <= w.lists.size()) {
+            std::string out = "[";
+            for (uint64_t item : w.lists[IndexOf(symbol) - 1]) {
+                if (out.size() > 1)
+                    out += " ";
+                out += SymbolString(item);
+            }
+            return out + "]";
+        }
+        break;
+    case TAG_SENTENCE:
+        snprintf(text, sizeof(text), "sentence#%llu", (unsigned long long)IndexOf(symbol));
+        return text;
+    case TAG_KNOWLEDGE:
+        snprintf(text, sizeof(text), "knowledge#%llu", (unsigned long long)IndexOf(symbol));
+        return text;
+    }
+    snprintf(text, sizeof(text), "#%016llx", (unsigned long long)symbol);
+    return text;
+}
+
+MerlinString ToMerlinString(const std::string &str) {
+    MerlinString out = {};
+    snprintf(out.buffer, sizeof(out.buffer), "%s", str.c_str());
+    return out;
+}
+
+std::filesystem::path DataPath(const char *path) {
+    std::filesystem::path p(path ? path : "");
+    if (p.is_relative() && !std::filesystem::exists(p))
+        p = std::filesystem::path(W().rootPath) / p;
+    return p;
+}
+
+// "name weight" lines, as in Game/NpcTraitTables/*.txt
+std::vector<std::pair<std::string, double>> ReadWeights(const char *path) {
+    std::vector<std::pair<std::string, double>> rows;
+    std::ifstream file(DataPath(path));
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        std::string name;
+        double weight = 0.0;
+        if (fields >> name >> weight)
+            rows.emplace_back(name, weight);
+    }
+    return rows;
+}
+
+char *InternedCString(const std::string &str) {
+    return const_cast<char *>(HstrString(Hstr(str))->c_str());
+}
+
+// Walker's alias method over an attribute's values: one draw picks a column, a second keeps it or
+// takes its alias, so a sample is O(1) however many values the table has
+struct AliasTable {
+    int count = 1; // distinct values each NPC holds (more than one for plural traits)
+    std::vector<uint64_t> symbols;
+    std::vector<double> keep;
+    std::vector<uint32_t> alias;
+};
+
+AliasTable MakeAliasTable(const ValueTable &values, int count) {
+    AliasTable table;
+    int size = values.size;
+    double total = 0.0;
+    int weighted = 0;
+    for (int i = 0; i < size; i++) {
+        total += std::max(values.freqs[i], 0.0);
+        weighted += values.freqs[i] > 0.0;
+    }
+    if (size == 0 || total <= 0.0) {
+        table.symbols.assign(1, Hstr(size ? values.valueNames[0] : "@nothing"));
+        table.keep.assign(1, 1.0);
+        table.alias.assign(1, 0);
+        return table;
+    }
+    // Zero-weight values are never drawn, so they can't make up a plural trait's count
+    table.count = std::clamp(count, 1, weighted);
+    table.symbols.resize(size);
+    table.keep.assign(size, 1.0);
+    table.alias.resize(size);
+    std::vector<double> scaled(size);
+    std::vector<uint32_t> small, large;
+    for (int i = 0; i < size; i++) {
+        table.symbols[i] = Hstr(values.valueNames[i]);
+        table.alias[i] = i;
+        scaled[i] = std::max(values.freqs[i], 0.0) * size / total;
+        (scaled[i] < 1.0 ? small : large).push_back(i);
+    }
+    while (!small.empty() && !large.empty()) {
+        uint32_t under = small.back();
+        uint32_t over = large.back();
+        small.pop_back();
+        table.keep[under] = scaled[under];
+        table.alias[under] = over;
+        scaled[over] -= 1.0 - scaled[under];
+        if (scaled[over] < 1.0) {
+            large.pop_back();
+            small.push_back(over);
+        }
+    }
+    return table; // columns left in either list (rounding) keep themselves
+}
+
+// SplitMix64, one per NPC: cheap to seed, and samples don't depend on how NPCs are split across
+// threads
+struct NpcRandom {
+    uint64_t state;
+
+    uint64_t Next() {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+    double Uniform() { return (Next() >> 11) * 0x1.0p-53; }
+    uint32_t Below(uint32_t n) { return (uint32_t)(Uniform() * n); }
+};
+
+uint32_t SampleAlias(const AliasTable &table, NpcRandom &random) {
+    uint32_t column = random.Below((uint32_t)table.keep.size());
+    return random.Uniform() < table.keep[column] ? column : table.alias[column];
+}
+
+void SimMind(uint64_t mind) {
+    if (Entity *npc = EntityOf(mind); npc && npc->npc)
+        StepNpc(*npc);
+}
+
+// Pools from <root>/MerlinLimits.txt ("name = max init-reserved growth-stride") that TrackPools
+// models
+void LoadPools(World &w) {
+    std::ifstream limits(w.rootPath + "/MerlinLimits.txt");
+    std::string line;
+    while (std::getline(limits, line)) {
+        std::istringstream fields(line);
+        Pool pool;
+        std::string equals;
+        if (!(fields >> pool.name >> equals >> pool.maxItems >> pool.initReserved >>
+              pool.growthStride) ||
+            equals != "=")
+            continue;
+        if (pool.name != "env.entityIds64.pool" && pool.name != "abs.listSymbols.pool" &&
+            pool.name != "npc.rules.pool")
+            continue;
+        pool.growthStride = std::max(pool.growthStride, 1u);
+        pool.capacity = pool.initReserved;
+        w.pools.push_back(pool);
+    }
+}
+
+// Occupancy at the end of a cycle: entities, the symbols in all lists, and each NPC's firing
+// rules
+void TrackPools(World &w) {
+    for (Pool &pool : w.pools) {
+        uint32_t perInstance = 0;
+        pool.instances = 1;
+        if (pool.name == "env.entityIds64.pool") {
+            perInstance = (uint32_t)w.entities.size();
+        } else if (pool.name == "abs.listSymbols.pool") {
+            for (const std::vector<uint64_t> &list : w.lists)
+                perInstance += (uint32_t)list.size();
+        } else {
+            pool.instances = (uint32_t)w.npcs.size();
+            for (uint64_t npc : w.npcs)
+                perInstance = std::max(perInstance, (uint32_t)EntityOf(npc)->firingRules.size());
+        }
+        pool.current = (uint64_t)perInstance * pool.instances;
+        pool.peak = std::max(pool.peak, perInstance);
+        while (pool.capacity < perInstance) {
+            pool.capacity += pool.growthStride;
+            pool.growths += pool.instances;
+        }
+    }
+}
+
+// The stand-in's "parse" of the behaviour, ontology, grammar and systems sources: each file is
+// split into words and punctuation, which are interned like the real parser's symbols. The
+// token list, NUL-separated, is the compiled form handed to useCompiledSources' sink and reused
+// from its sources instead of reading the file.
+std::string TokenizeSource(const std::string &text) {
+    std::string tokens;
+    for (size_t i = 0; i < text.size();) {
+        unsigned char c = (unsigned char)text[i];
+        size_t length = 1;
+        if (std::isspace(c)) {
+            i++;
+            continue;
+        }
+        if (std::isalnum(c) || c == '_') {
+            while (i + length < text.size() &&
+                   (std::isalnum((unsigned char)text[i + length]) || text[i + length] == '_'))
+                length++;
+        }
+        tokens.append(text, i, length);
+        tokens += '\0';
+        i += length;
+    }
+    return tokens;
+}
+
+void LoadSources(World &w) {
+    namespace fs = std::filesystem;
+    std::vector<fs::path> files;
+    std::error_code error;
+    for (const std::string &dir : {w.basePath, w.rootPath}) {
+        fs::recursive_directory_iterator it(dir, error), end;
+        for (; !error && it != end; it.increment(error)) {
+            fs::path extension = it->path().extension();
+            if (extension == ".mc" || extension == ".mon" || extension == ".mgr" ||
+                extension == ".env")
+                files.push_back(it->path());
+        }
+    }
+    std::sort(files.begin(), files.end());
+    fs::path dataDir = fs::path(w.rootPath).parent_path();
+    for (const fs::path &file : files) {
+        std::string path = fs::relative(file, dataDir, error).generic_string();
+        std::string parsed;
+        std::string_view tokens;
+        if (auto it = compiledSources.find(path); it != compiledSources.end()) {
+            tokens = it->second;
+        } else {
+            std::ifstream in(file, std::ios::binary);
+            parsed = TokenizeSource(std::string((std::istreambuf_iterator<char>(in)),
+                                                std::istreambuf_iterator<char>()));
+            if (compiledSink)
+                compiledSink(compiledSinkContext, path.c_str(), parsed.data(), parsed.size());
+            tokens = parsed;
+        }
+        for (size_t at = 0, end; at < tokens.size(); at = end + 1) {
+            end = tokens.find('\0', at);
+            if (end == std::string_view::npos)
+                end = tokens.size();
+            Hstr(std::string(tokens.substr(at, end - at)));
+        }
+    }
+    compiledSources.clear();
+    compiledSink = nullptr;
+}
+
+// A fresh, empty world (start() then loads the sources, startFromSnapshot a snapshot)
+void StartWorld(const char *merlinRootPath, const char *baseModulePath) {
+    delete world;
+    world = nullptr;
+    rosterVersionCounter++;
+    World &w = W();
+    w.rootPath = merlinRootPath ? merlinRootPath : "";
+    w.basePath = baseModulePath ? baseModulePath : "";
+    if (const char *birthEvery = std::getenv("MERLIN_STUB_BIRTH_EVERY"))
+        w.birthEvery = std::max(0, std::atoi(birthEvery));
+    w.goToWaypointRule = Hstr("go-to-waypoint");
+    w.goTask = Hstr("go");
+    w.idleTask = Hstr("idle");
+    w.walkAction = Hstr("walk");
+    LoadPools(w);
+}
+
+// World snapshots (saveSnapshot, loadSnapshot, startFromSnapshot): the world's containers in
+// field order, as raw native-endian values. Callbacks, action buffers and pools belong to the
+// session and aren't saved.
+constexpr char kSnapshotMagic[8] = {'M', 'S', 'T', 'U', 'B', 'W', 'L', '3'};
+
+struct SnapshotWriter {
+    std::string bytes;
+
+    template <typename T> void Put(const T &value) {
+        bytes.append(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+    void PutString(const std::string &str) {
+        Put<uint64_t>(str.size());
+        bytes += str;
+    }
+    template <typename T> void PutVector(const std::vector<T> &items) {
+        Put<uint64_t>(items.size());
+        bytes.append(reinterpret_cast<const char *>(items.data()), items.size() * sizeof(T));
+    }
+};
+
+// Reads straight from the snapshot's memory; any read past the end leaves ok false
+struct SnapshotReader {
+    const char *at;
+    const char *end;
+    bool ok = true;
+
+    template <typename T> T Get() {
+        T value = {};
+        if (!ok || end - at < (ptrdiff_t)sizeof(T)) {
+            ok = false;
+            return value;
+        }
+        memcpy(&value, at, sizeof(T));
+        at += sizeof(T);
+        return value;
+    }
+    uint64_t GetCount(size_t itemSize) {
+        uint64_t count = Get<uint64_t>();
+        if (ok && count > (uint64_t)(end - at) / itemSize)
+            ok = false;
+        return ok ? count : 0;
+    }
+    std::string GetString() {
+        uint64_t size = GetCount(1);
+        std::string str(at, size);
+        at += size;
+        return str;
+    }
+    template <typename T> std::vector<T> GetVector() {
+        std::vector<T> items(GetCount(sizeof(T)));
+        memcpy(items.data(), at, items.size() * sizeof(T));
+        at += items.size() * sizeof(T);
+        return items;
+    }
+};
+
+std::string SaveWorld(const World &w) {
+    SnapshotWriter out;
+    out.Put(kSnapshotMagic);
+    std::ostringstream rng;
+    rng << w.rng;
+    out.PutString(rng.str());
+    out.Put<uint64_t>(w.hstrs.size());
+    for (const std::string &str : w.hstrs)
+        out.PutString(str);
+    out.PutVector(w.floats);
+    out.Put<uint64_t>(w.lists.size());
+    for (const std::vector<uint64_t> &list : w.lists)
+        out.PutVector(list);
+    out.Put(w.sentences);
+    out.Put<uint64_t>(w.knowledge.size());
+    for (const std::vector<uint64_t> &beliefs : w.knowledge)
+        out.PutVector(beliefs);
+    out.Put<uint64_t>(w.entities.size());
+    for (const Entity &entity : w.entities) {
+        out.PutString(entity.system);
+        out.PutString(entity.kind);
+        out.Put(entity.obb);
+        out.Put(entity.parent);
+        out.Put<uint64_t>(entity.attrs.size());
+        for (const auto &[name, value] : entity.attrs) {
+            out.PutString(name);
+            out.Put(value);
+        }
+        out.Put<uint8_t>(entity.npc);
+        out.Put(entity.home);
+        out.Put(entity.target);
+        out.PutVector(entity.firingRules);
+        out.PutVector(entity.knowledge);
+    }
+    out.PutVector(w.npcs);
+    out.PutVector(w.waypoints);
+    out.PutVector(w.sectorMins);
+    out.PutVector(w.sectorMaxs);
+    out.Put(w.seconds);
+    out.Put(w.cycle);
+    out.Put(w.goToWaypointRule);
+    out.Put(w.goTask);
+    out.Put(w.idleTask);
+    out.Put(w.walkAction);
+    out.Put(w.mind);
+    return out.bytes;
+}
+
+// Replace w's saved state with a snapshot's; false (w partly loaded) if it doesn't parse
+bool LoadWorld(World &w, const char *data, uint64_t size) {
+    SnapshotReader in{data, data + size};
+    char magic[sizeof(kSnapshotMagic)];
+    for (char &c : magic)
+        c = in.Get<char>();
+    if (!in.ok || memcmp(magic, kSnapshotMagic, sizeof(magic)) != 0)
+        return false;
+    std::istringstream rng(in.GetString());
+    rng >> w.rng;
+    w.hstrs.clear();
+    w.hstrIndex.clear();
+    for (uint64_t i = 0, count = in.GetCount(8); i < count && in.ok; i++) {
+        w.hstrs.push_back(in.GetString());
+        w.hstrIndex.emplace(w.hstrs.back(), MakeSymbol(TAG_HSTR, i + 1));
+    }
+    w.floats = in.GetVector<float>();
+    w.lists.clear();
+    for (uint64_t i = 0, count = in.GetCount(8); i < count && in.ok; i++)
+        w.lists.push_back(in.GetVector<uint64_t>());
+    w.sentences = in.Get<uint64_t>();
+    w.knowledge.clear();
+    for (uint64_t i = 0, count = in.GetCount(8); i < count && in.ok; i++)
+        w.knowledge.push_back(in.GetVector<uint64_t>());
+    w.entities.clear();
+    for (uint64_t i = 0, count = in.GetCount(8); i < count && in.ok; i++) {
+        Entity entity;
+        entity.system = in.GetString();
+        entity.kind = in.GetString();
+        entity.obb = in.Get<MerlinObb>();
+        entity.parent = in.Get<uint64_t>();
+        for (uint64_t j = 0, attrs = in.GetCount(8); j < attrs && in.ok; j++) {
+            std::string name = in.GetString();
+            entity.attrs[name] = in.Get<uint64_t>();
+        }
+        entity.npc = in.Get<uint8_t>() != 0;
+        std::copy_n(in.Get<std::array<float, 3>>().data(), 3, entity.home);
+        std::copy_n(in.Get<std::array<float, 3>>().data(), 3, entity.target);
+        entity.firingRules = in.GetVector<uint64_t>();
+        entity.knowledge = in.GetVector<uint32_t>();
+        w.entities.push_back(std::move(entity));
+    }
+    w.npcs = in.GetVector<uint64_t>();
+    w.waypoints = in.GetVector<uint64_t>();
+    w.sectorMins = in.GetVector<MerlinFloat3>();
+    w.sectorMaxs = in.GetVector<MerlinFloat3>();
+    w.seconds = in.Get<uint64_t>();
+    w.cycle = in.Get<uint32_t>();
+    w.goToWaypointRule = in.Get<uint64_t>();
+    w.goTask = in.Get<uint64_t>();
+    w.idleTask = in.Get<uint64_t>();
+    w.walkAction = in.Get<uint64_t>();
+    w.mind = in.Get<uint64_t>();
+    return in.ok;
+}
+
+// Terrain: the shared heightfield if there is one, else a 2 km island of rolling hills
+constexpr float kIslandHalfSize = 1000.0f;
+
+float IslandElevation(float x, float z) {
+    return 12.0f + 10.0f * std::sin(x * 0.011f) * std::cos(z * 0.009f) +
+           4.0f * std::sin((x - z) * 0.037f);
+}
+
+// Bilinear, clamped to the edge (NaN to the origin), as MerlinLua samples it
+float HeightfieldElevation(const MerlinHeightfield &field, float x, float z) {
+    float u = (x - field.originX) / field.spacing, v = (z - field.originZ) / field.spacing;
+    u = std::min(u > 0.0f ? u : 0.0f, field.width - 1.0f);
+    v = std::min(v > 0.0f ? v : 0.0f, field.depth - 1.0f);
+    int column = std::min((int)u, field.width - 2), row = std::min((int)v, field.depth - 2);
+    float fu = u - column, fv = v - row;
+    const float *cell = field.heights + (size_t)row * field.width + column;
+    float nearEdge = cell[0] + (cell[1] - cell[0]) * fu;
+    float farEdge = cell[field.width] + (cell[field.width + 1] - cell[field.width]) * fu;
+    return nearEdge + (farEdge - nearEdge) * fv;
+}
+
+float GroundElevation(float x, float z) {
+    return sharedHeightfield.heights ? HeightfieldElevation(sharedHeightfield, x, z)
+                                     : IslandElevation(x, z);
+}
+
+// The stand-in has no ontology, so a layout kind's ancestor is guessed from its last word:
+// spaces, structures, or neither (the kind table's "*")
+const char *LayoutKindCategory(const char *kind) {
+    const char *last = strrchr(kind, ' ');
+    std::string word = last ? last + 1 : kind;
+    for (const char *space : {"area", "room", "bedroom", "stage", "auditorium", "hall", "street",
+                              "space"}) {
+        if (word == space)
+            return "space";
+    }
+    for (const char *structure : {"cottage", "manor", "terrace", "house", "theatre", "building",
+                                  "structure"}) {
+        if (word == structure)
+            return "structure";
+    }
+    return "*";
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// Lifecycle, callbacks, logging
+// ---------------------------------------------------------------------------
+
+MERLIN_STUB_API void registerCallback(const char *funcName, MerlinCallback func) {
+    W().callbacks[funcName ? funcName : ""] = func;
+}
+
+MERLIN_STUB_API void registerSoundCallback(SoundCallback func) { W().soundCallback = func; }
+
+MERLIN_STUB_API void useCompiledSources(const MerlinCompiledSource *sources, int count,
+                                        CompiledSink sink, void *context) {
+    compiledSources.clear();
+    for (int i = 0; i < count; i++) {
+        compiledSources[sources[i].path] =
+            std::string_view(static_cast<const char *>(sources[i].data), sources[i].size);
+    }
+    compiledSink = sink;
+    compiledSinkContext = context;
+}
+
+// Nothing is copied: the heights are sampled in place until stop()
+MERLIN_STUB_API void useHeightfield(const MerlinHeightfield *field) {
+    sharedHeightfield = field ? *field : MerlinHeightfield{};
+}
+
+MERLIN_STUB_API void start(const char *merlinRootPath, const char *baseModulePath) {
+    StartWorld(merlinRootPath, baseModulePath);
+    LoadSources(W());
+}
+
+MERLIN_STUB_API void stop() {
+    delete world;
+    world = nullptr;
+    rosterVersionCounter++;
+    sharedHeightfield = {};
+}
+
+MERLIN_STUB_API bool saveSnapshot(const char *path) {
+    std::string bytes = SaveWorld(W());
+    std::ofstream file(path ? path : "", std::ios::binary);
+    return file.write(bytes.data(), (std::streamsize)bytes.size()).good();
+}
+
+MERLIN_STUB_API bool loadSnapshot(const char *path) {
+    std::ifstream file(path ? path : "", std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (!file.good() && !file.eof())
+        return false;
+    // Parse into a new world so a bad file leaves the running one alone; the session carries over
+    World &w = W();
+    World loaded;
+    if (!LoadWorld(loaded, bytes.data(), bytes.size()))
+        return false;
+    loaded.rootPath = w.rootPath;
+    loaded.basePath = w.basePath;
+    loaded.callbacks = w.callbacks;
+    loaded.soundCallback = w.soundCallback;
+    loaded.actionBuffers = w.actionBuffers;
+    loaded.birthEvery = w.birthEvery;
+    loaded.pools = w.pools;
+    loaded.retiredHstrs = std::move(w.retiredHstrs);
+    loaded.retiredHstrs.push_back(std::move(w.hstrs)); // moving a deque keeps its elements
+    w = std::move(loaded);
+    rosterVersionCounter++;
+    return true;
+}
+
+// The snapshot is parsed where it lies; the stand-in copies everything it keeps
+MERLIN_STUB_API bool startFromSnapshot(const char *merlinRootPath, const char *baseModulePath,
+                                       const void *snapshot, uint64_t size) {
+    StartWorld(merlinRootPath, baseModulePath);
+    if (!snapshot || !LoadWorld(W(), static_cast<const char *>(snapshot), size)) {
+        stop();
+        return false;
+    }
+    return true;
+}
+
+MERLIN_STUB_API void setRandomSeed(uint32_t seed) { W().rng.seed(seed); }
+MERLIN_STUB_API void toggleChannel(const char *, const char *) {}
+MERLIN_STUB_API void startTrace(uint64_t) {}
+MERLIN_STUB_API void stopTrace(uint64_t) {}
+MERLIN_STUB_API void traceEvent(const char *) {}
+MERLIN_STUB_API void logDebug(const char *text) { fprintf(stderr, "%s\n", text ? text : ""); }
+MERLIN_STUB_API void dumpSelfKnowledge() {}
+MERLIN_STUB_API void allDumpSelfKnowledge() {}
+
+// ---------------------------------------------------------------------------
+// Queries
+// ---------------------------------------------------------------------------
+
+MERLIN_STUB_API MerlinSymbolArray mentalObjectsOfKind(const char *) { return {}; }
+MERLIN_STUB_API MerlinSymbolArray every(const char *) { return {}; }
+MERLIN_STUB_API uint64_t anyPresentTensePossessiveBeliefTarget(uint64_t, uint64_t) { return 0; }
+MERLIN_STUB_API MerlinSymbolArray everyPresentTensePossessiveBeliefTargets(uint64_t, uint64_t) {
+    return {};
+}
+
+MERLIN_STUB_API MerlinSymbolArray ls(const char *pathStr, const char *extStr) {
+    std::vector<std::string> names;
+    std::error_code error;
+    std::string ext = std::string(".") + (extStr ? extStr : "");
+    for (const auto &file : std::filesystem::directory_iterator(DataPath(pathStr), error)) {
+        if (file.path().extension() == ext)
+            names.push_back(file.path().filename().string());
+    }
+    std::sort(names.begin(), names.end());
+    std::vector<uint64_t> symbols;
+    for (const std::string &name : names)
+        symbols.push_back(Hstr(name));
+    return ToArray(symbols);
+}
+
+MERLIN_STUB_API void import(const char *) {}
+
+// ---------------------------------------------------------------------------
+// Attribute tables
+// ---------------------------------------------------------------------------
+
+MERLIN_STUB_API void makeCountsTable(CountsTable *outTable, const char *path) {
+    *outTable = {};
+    for (const auto &[name, count] : ReadWeights(path)) {
+        if (outTable->size == kAttrCapacityPerSystem)
+            break;
+        outTable->attrNames[outTable->size] = InternedCString(name);
+        outTable->counts[outTable->size] = (int)count;
+        outTable->size++;
+    }
+}
+
+MERLIN_STUB_API void makeValueTable(ValueTable *outTable, const char *path) {
+    *outTable = {};
+    for (const auto &[name, freq] : ReadWeights(path)) {
+        if (outTable->size == kAttrCapacityPerSystem)
+            break;
+        outTable->valueNames[outTable->size] = InternedCString(name);
+        outTable->freqs[outTable->size] = freq;
+        outTable->size++;
+    }
+}
+
+static int FindAttr(const AttrTable *table, const char *attrNameStr) {
+    for (int i = 0; i < table->size; i++) {
+        if (std::strcmp(table->attrNames[i], attrNameStr) == 0)
+            return i;
+    }
+    return -1;
+}
+
+MERLIN_STUB_API void updateAttrTable(AttrTable *outTable, const char *attrNameStr,
+                                     ValueTable *valueTable, CountsTable *countsTable) {
+    int index = FindAttr(outTable, attrNameStr);
+    if (index < 0) {
+        if (outTable->size == kAttrCapacityPerSystem)
+            return;
+        index = outTable->size++;
+        outTable->attrNames[index] = InternedCString(attrNameStr);
+    }
+    outTable->valueTables[index] = *valueTable;
+    outTable->counts[index] = 1;
+    for (int i = 0; countsTable && i < countsTable->size; i++) {
+        if (std::strcmp(countsTable->attrNames[i], attrNameStr) == 0)
+            outTable->counts[index] = countsTable->counts[i];
+    }
+}
+
+MERLIN_STUB_API int numAttrTableValues(AttrTable *outTable, const char *attrNameStr) {
+    int index = FindAttr(outTable, attrNameStr);
+    return index < 0 ? 0 : outTable->counts[index];
+}
+
+MERLIN_STUB_API char *sampleAttrTable(AttrTable *outTable, const char *attrNameStr) {
+    int index = FindAttr(outTable, attrNameStr);
+    if (index < 0 || outTable->valueTables[index].size == 0)
+        return InternedCString("@nothing");
+    const ValueTable &values = outTable->valueTables[index];
+    double total = 0.0;
+    for (int i = 0; i < values.size; i++)
+        total += values.freqs[i];
+    double pick = Random01() * total;
+    for (int i = 0; i < values.size; i++) {
+        pick -= values.freqs[i];
+        if (pick <= 0.0)
+            return values.valueNames[i];
+    }
+    return values.valueNames[values.size - 1];
+}
+
+// ---------------------------------------------------------------------------
+// World and entities
+// ---------------------------------------------------------------------------
+
+MERLIN_STUB_API void makeFlatWorld(const float *, const float *, float, float) {}
+// Square sectors sectorRadius wide (as scene.lua uses it) over the heightfield or the island;
+// the terrain file itself is never read
+MERLIN_STUB_API void makeWorldFromTerrain(const char *, float sectorRadius) {
+    World &w = W();
+    float minX = -kIslandHalfSize, minZ = -kIslandHalfSize;
+    float maxX = kIslandHalfSize, maxZ = kIslandHalfSize;
+    if (const MerlinHeightfield &field = sharedHeightfield; field.heights) {
+        minX = field.originX, maxX = field.originX + (field.width - 1) * field.spacing;
+        minZ = field.originZ, maxZ = field.originZ + (field.depth - 1) * field.spacing;
+    }
+    float size = std::max(sectorRadius, 10.0f);
+    w.sectorMins.clear();
+    w.sectorMaxs.clear();
+    for (float z = minZ; z < maxZ; z += size) {
+        for (float x = minX; x < maxX; x += size) {
+            MerlinFloat3 lo = {{x, 1e30f, z}};
+            MerlinFloat3 hi = {{std::min(x + size, maxX), -1e30f, std::min(z + size, maxZ)}};
+            // Elevation range from samples 10 m apart
+            for (float sz = lo.floats[2]; sz <= hi.floats[2]; sz += 10.0f) {
+                for (float sx = lo.floats[0]; sx <= hi.floats[0]; sx += 10.0f) {
+                    float y = GroundElevation(sx, sz);
+                    lo.floats[1] = std::min(lo.floats[1], y);
+                    hi.floats[1] = std::max(hi.floats[1], y);
+                }
+            }
+            w.sectorMins.push_back(lo);
+            w.sectorMaxs.push_back(hi);
+        }
+    }
+}
+
+MERLIN_STUB_API float terrainElevation(float wx, float wy) { return GroundElevation(wx, wy); }
+
+MERLIN_STUB_API void terrainElevations(const float *ground, float *outElevations, int count) {
+    for (int i = 0; i < count; i++)
+        outElevations[i] = GroundElevation(ground[i * 2], ground[i * 2 + 1]);
+}
+MERLIN_STUB_API void loadSceneLayout(const char *, const char **, int) {}
+
+MERLIN_STUB_API int makeLayoutEntities(const MerlinLayoutObject *objects, int count,
+                                       const char *strings, const char **rawKindToSystemTable,
+                                       int tableSize, uint64_t *outEntities) {
+    for (int i = 0; i < count; i++) {
+        const MerlinLayoutObject &object = objects[i];
+        const char *kind = strings + object.kind;
+        const char *category = LayoutKindCategory(kind);
+        const char *system = "";
+        for (int k = 0; k < tableSize; k++) {
+            if (strcmp(rawKindToSystemTable[k * 2], category) == 0 ||
+                strcmp(rawKindToSystemTable[k * 2], "*") == 0) {
+                system = rawKindToSystemTable[k * 2 + 1];
+                break;
+            }
+        }
+        uint64_t parent = object.parent >= 0 && object.parent < i ? outEntities[object.parent] : 0;
+        outEntities[i] = MakeEntity(system, kind, object.bounds, parent);
+        W().entities.back().attrs["name"] = Hstr(strings + object.name);
+    }
+    return count;
+}
+
+MERLIN_STUB_API void setNpcLocomotionMode(const char *) {}
+
+MERLIN_STUB_API uint64_t makeRootEntityNow(const char *systemName, const char *kindStr,
+                                           MerlinObb obb) {
+    return MakeEntity(systemName, kindStr, obb, 0);
+}
+
+MERLIN_STUB_API uint64_t makeSubEntityNow(const char *systemName, const char *kindStr,
+                                          MerlinObb obb, uint64_t rawParentAbsObject) {
+    return MakeEntity(systemName, kindStr, obb, rawParentAbsObject);
+}
+
+MERLIN_STUB_API uint64_t makeRootEntityAtTime(const char *systemName, const char *kindStr,
+                                              uint64_t, MerlinObb obb) {
+    return MakeEntity(systemName, kindStr, obb, 0);
+}
+
+MERLIN_STUB_API uint64_t makeSubEntityAtTime(const char *systemName, const char *kindStr,
+                                             uint64_t, MerlinObb obb, uint64_t rawParentAbsObject) {
+    return MakeEntity(systemName, kindStr, obb, rawParentAbsObject);
+}
+
+MERLIN_STUB_API void addSymbol(MerlinSymbolArray *array, uint64_t rawSymbol) {
+    if (array->size < kSymbolArrayCapacity)
+        array->buffer[array->size++] = rawSymbol;
+}
+
+MERLIN_STUB_API void removeSymbolByValue(MerlinSymbolArray *array, uint64_t rawSymbol) {
+    for (int i = 0; i < array->size; i++) {
+        if (array->buffer[i] == rawSymbol) {
+            std::copy(array->buffer + i + 1, array->buffer + array->size, array->buffer + i);
+            array->size--;
+            return;
+        }
+    }
+}
+
+MERLIN_STUB_API void removeSymbolByIndex(MerlinSymbolArray *array, int index) {
+    if (index < 0 || index >= array->size)
+        return;
+    std::copy(array->buffer + index + 1, array->buffer + array->size, array->buffer + index);
+    array->size--;
+}
+
+MERLIN_STUB_API void addString(MerlinSymbolArray *array, const char *str) {
+    addSymbol(array, Hstr(str ? str : ""));
+}
+
+// Only the first kSymbolArrayCapacity NPCs fit, as with the real library
+MERLIN_STUB_API MerlinSymbolArray npcs() { return ToArray(W().npcs); }
+
+MERLIN_STUB_API uint32_t rosterVersion() { return rosterVersionCounter; }
+
+MERLIN_STUB_API int rosterNpcs(uint64_t *rawNpcs, int capacity) {
+    const std::vector<uint64_t> &npcs = W().npcs;
+    if (rawNpcs)
+        std::copy_n(npcs.begin(), std::min((size_t)std::max(capacity, 0), npcs.size()), rawNpcs);
+    return (int)npcs.size();
+}
+
+MERLIN_STUB_API uint64_t findEntityByName(const char *, uint64_t rawFirstName, uint64_t rawSurname) {
+    for (uint64_t npc : W().npcs) {
+        const Entity *entity = EntityOf(npc);
+        auto name = entity->attrs.find("name");
+        if (name != entity->attrs.end() &&
+            SymbolString(name->second) ==
+                SymbolString(rawFirstName) + " " + SymbolString(rawSurname))
+            return npc;
+    }
+    return 0;
+}
+
+MERLIN_STUB_API MerlinSymbolArray findEntitiesOfKind(const char *systemNameStr,
+                                                     const char *kindStr) {
+    World &w = W();
+    std::vector<uint64_t> found;
+    for (size_t i = 0; i < w.entities.size(); i++) {
+        if (w.entities[i].system == systemNameStr && w.entities[i].kind == kindStr)
+            found.push_back(MakeSymbol(TAG_ENTITY, i + 1));
+    }
+    return ToArray(found);
+}
+
+MERLIN_STUB_API uint64_t instantiateEntity(const char *, const char *instSystemName,
+                                           uint64_t rawKind) {
+    MerlinObb obb = {};
+    obb.floats[9] = 1.0f;
+    return MakeEntity(instSystemName, SymbolString(rawKind).c_str(), obb, 0);
+}
+
+MERLIN_STUB_API uint64_t attrSymbol(uint64_t rawEntity, const char *attrName) {
+    Entity *entity = EntityOf(rawEntity);
+    if (!entity || !attrName)
+        return 0;
+    if (std::strcmp(attrName, "obb") == 0)
+        return MakeSymbol(TAG_OBB, IndexOf(rawEntity));
+    auto it = entity->attrs.find(attrName);
+    return it == entity->attrs.end() ? 0 : it->second;
+}
+
+MERLIN_STUB_API MerlinSymbolArray attrSymbolArray(uint64_t rawEntity, const char *attrName) {
+    uint64_t value = attrSymbol(rawEntity, attrName);
+    if (TagOf(value) == TAG_LIST)
+        return ToArray(W().lists[IndexOf(value) - 1]);
+    return value ? ToArray({value}) : MerlinSymbolArray{};
+}
+
+MERLIN_STUB_API void setSymbolAttr(uint64_t rawEntity, const char *attrName, uint64_t rawSymbol) {
+    if (Entity *entity = EntityOf(rawEntity); entity && attrName)
+        entity->attrs[attrName] = rawSymbol;
+}
+
+MERLIN_STUB_API void setSymbolArrayAttr(uint64_t rawEntity, const char *attrName,
+                                        MerlinSymbolArray *array) {
+    setSymbolAttr(rawEntity, attrName,
+                  MakeList(std::vector<uint64_t>(array->buffer, array->buffer + array->size)));
+}
+
+MERLIN_STUB_API void addSymbolAttr(uint64_t rawEntity, const char *attrName, uint64_t rawSymbol) {
+    Entity *entity = EntityOf(rawEntity);
+    if (!entity || !attrName)
+        return;
+    std::vector<uint64_t> items;
+    uint64_t current = attrSymbol(rawEntity, attrName);
+    if (TagOf(current) == TAG_LIST)
+        items = W().lists[IndexOf(current) - 1];
+    else if (current)
+        items.push_back(current);
+    items.push_back(rawSymbol);
+    entity->attrs[attrName] = MakeList(std::move(items));
+}
+
+MERLIN_STUB_API void setLocalBoundsAttr(uint64_t rawEntity, const char *, MerlinObb inObb) {
+    if (Entity *entity = EntityOf(rawEntity))
+        entity->obb = inObb;
+}
+
+MERLIN_STUB_API void setOccluder(uint64_t, int) {}
+
+// ---------------------------------------------------------------------------
+// Minds and knowledge (no reasoning: every pattern yields a fresh sentence symbol)
+// ---------------------------------------------------------------------------
+
+MERLIN_STUB_API void enterMind(uint64_t rawEntity) { W().mind = rawEntity; }
+MERLIN_STUB_API void enterAbsMind() { W().mind = 0; }
+MERLIN_STUB_API void addMotor(const char *, const char *) {}
+MERLIN_STUB_API void removeMotor(const char *, const char *) {}
+MERLIN_STUB_API uint64_t observe(uint64_t rawEntity) { return rawEntity; }
+MERLIN_STUB_API uint64_t learnAllAbout(uint64_t rawEntity) { return rawEntity; }
+MERLIN_STUB_API uint64_t evalSymbol(uint64_t rawSymbol) { return rawSymbol; }
+MERLIN_STUB_API uint64_t evalPattern(const char *, MerlinVarBindings *) { return 0; }
+
+MERLIN_STUB_API uint64_t learn(const char *, MerlinVarBindings *) {
+    return MakeSymbol(TAG_SENTENCE, ++W().sentences);
+}
+
+MERLIN_STUB_API uint64_t believe(const char *, MerlinVarBindings *) {
+    return MakeSymbol(TAG_SENTENCE, ++W().sentences);
+}
+
+MERLIN_STUB_API uint64_t imagine(const char *) {
+    return MakeSymbol(TAG_SENTENCE, ++W().sentences);
+}
+
+MERLIN_STUB_API void readMsg(uint64_t) {}
+
+// Shared knowledge: each pattern is "parsed" (interned) once, and instantiated once per row
+MERLIN_STUB_API uint64_t makeKnowledge(const char **patterns, int numPatterns,
+                                       const MerlinVarBindings *rows, int numRows) {
+    World &w = W();
+    std::vector<uint64_t> beliefs;
+    beliefs.reserve((size_t)std::max(numPatterns, 0) * std::max(numRows, 0));
+    for (int i = 0; i < numPatterns; i++) {
+        Hstr(patterns[i] ? patterns[i] : "");
+        for (int row = 0; row < numRows && rows; row++)
+            beliefs.push_back(MakeSymbol(TAG_SENTENCE, ++w.sentences));
+    }
+    w.knowledge.push_back(std::move(beliefs));
+    return MakeSymbol(TAG_KNOWLEDGE, w.knowledge.size());
+}
+
+MERLIN_STUB_API void believeKnowledge(uint64_t rawKnowledge, const uint64_t *rawMinds,
+                                      int numMinds) {
+    uint64_t index = IndexOf(rawKnowledge);
+    if (TagOf(rawKnowledge) != TAG_KNOWLEDGE || index == 0 || index > W().knowledge.size())
+        return;
+    for (int i = 0; i < numMinds; i++) {
+        if (Entity *mind = EntityOf(rawMinds[i]))
+            mind->knowledge.push_back((uint32_t)index - 1);
+    }
+}
+
+MERLIN_STUB_API void freeKnowledge(uint64_t) {}
+
+MERLIN_STUB_API uint64_t hstrSymbol(const char *str) { return Hstr(str ? str : ""); }
+MERLIN_STUB_API uint64_t queryHstr(const char *str) { return IndexOf(Hstr(str ? str : "")); }
+
+MERLIN_STUB_API uint64_t floatSymbol(float flt) {
+    World &w = W();
+    w.floats.push_back(flt);
+    return MakeSymbol(TAG_FLOAT, w.floats.size());
+}
+
+MERLIN_STUB_API uint64_t absObjectFromSymbol(uint64_t rawSymbol) { return rawSymbol; }
+MERLIN_STUB_API uint64_t absObjectFromEntitySystem(const char *, int) { return 0; }
+
+MERLIN_STUB_API uint64_t list(MerlinSymbolArray symbols) {
+    return MakeList(std::vector<uint64_t>(symbols.buffer, symbols.buffer + symbols.size));
+}
+
+MERLIN_STUB_API MerlinString toString(uint64_t rawSymbol) {
+    return ToMerlinString(SymbolString(rawSymbol));
+}
+
+MERLIN_STUB_API MerlinString toNlString(uint64_t rawSymbol) {
+    return ToMerlinString(SymbolString(rawSymbol));
+}
+
+MERLIN_STUB_API const char *nlMsg(uint64_t) { return ""; }
+
+// ---------------------------------------------------------------------------
+// Simulation
+// ---------------------------------------------------------------------------
+
+MERLIN_STUB_API void allPerceive() {}
+MERLIN_STUB_API void allSleep() {}
+
+MERLIN_STUB_API void beginCycle() {
+    World &w = W();
+    w.cycle++;
+    w.seconds += (uint64_t)kCycleSeconds;
+}
+
+MERLIN_STUB_API void simMinds(const uint64_t *rawMinds, int numMinds) {
+    for (int i = 0; i < numMinds; i++)
+        SimMind(rawMinds[i]);
+}
+
+MERLIN_STUB_API void endCycle() {
+    World &w = W();
+    TrackPools(w);
+    if (w.birthEvery <= 0 || w.cycle % w.birthEvery != 0 || w.npcs.empty())
+        return;
+    auto it = w.callbacks.find("giveBirth");
+    if (it != w.callbacks.end() && it->second)
+        it->second(w.npcs[w.rng() % w.npcs.size()], 0, 0, 0);
+}
+
+MERLIN_STUB_API void sim(int cycles) {
+    for (int c = 0; c < cycles; c++) {
+        beginCycle();
+        // Copy: a birth callback may add NPCs
+        std::vector<uint64_t> minds = W().npcs;
+        simMinds(minds.data(), (int)minds.size());
+        endCycle();
+    }
+}
+
+MERLIN_STUB_API int poolStats(MerlinPoolStats *stats, int capacity) {
+    const std::vector<Pool> &pools = W().pools;
+    for (int i = 0; i < capacity && i < (int)pools.size(); i++) {
+        const Pool &pool = pools[i];
+        MerlinPoolStats &out = stats[i];
+        out = {};
+        snprintf(out.name, sizeof(out.name), "%s", pool.name.c_str());
+        out.maxItems = pool.maxItems;
+        out.initReserved = pool.initReserved;
+        out.growthStride = pool.growthStride;
+        out.instances = pool.instances;
+        out.current = pool.current;
+        out.peak = pool.peak;
+        out.growths = pool.growths;
+    }
+    return (int)pools.size();
+}
+
+// ---------------------------------------------------------------------------
+// Bounds and positions
+// ---------------------------------------------------------------------------
+
+MERLIN_STUB_API MerlinObb composeBounds(MerlinFloat3 pos, MerlinFloat3 scale, MerlinQuat quat) {
+    MerlinObb obb;
+    std::copy(pos.floats, pos.floats + 3, obb.floats);
+    std::copy(scale.floats, scale.floats + 3, obb.floats + 3);
+    std::copy(quat.floats, quat.floats + 4, obb.floats + 6);
+    return obb;
+}
+
+MERLIN_STUB_API MerlinObb worldBounds(uint64_t rawSymbol) {
+    const Entity *entity = EntityOf(rawSymbol);
+    return entity ? entity->obb : MerlinObb{};
+}
+
+MERLIN_STUB_API MerlinObb mentalBounds(uint64_t, uint64_t rawSymbol) {
+    return worldBounds(rawSymbol);
+}
+
+MERLIN_STUB_API MerlinFloat3 worldPos(uint64_t rawSymbol) {
+    MerlinFloat3 pos = {};
+    if (const Entity *entity = EntityOf(rawSymbol))
+        std::copy(entity->obb.floats, entity->obb.floats + 3, pos.floats);
+    return pos;
+}
+
+MERLIN_STUB_API void worldPositions(const uint64_t *rawSymbols, MerlinFloat3 *outPositions,
+                                    int count) {
+    for (int i = 0; i < count; i++)
+        outPositions[i] = worldPos(rawSymbols[i]);
+}
+
+MERLIN_STUB_API void setWorldPositions(const uint64_t *rawSymbols, const MerlinFloat3 *positions,
+                                       int count) {
+    for (int i = 0; i < count; i++) {
+        if (Entity *entity = EntityOf(rawSymbols[i]))
+            std::copy(positions[i].floats, positions[i].floats + 3, entity->obb.floats);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Time
+// ---------------------------------------------------------------------------
+
+static uint64_t SecondsOf(uint32_t year, uint32_t month, uint32_t day, uint32_t hour,
+                          uint32_t minute, uint32_t second) {
+    // Calendar detail doesn't matter here: 12 months of 30 days
+    return ((((uint64_t(year) * 12 + month) * 30 + day) * 24 + hour) * 60 + minute) * 60 + second;
+}
+
+MERLIN_STUB_API uint64_t seconds() { return W().seconds; }
+MERLIN_STUB_API uint64_t secondsSymbol() { return floatSymbol((float)W().seconds); }
+
+MERLIN_STUB_API uint64_t makeSeconds(uint32_t year, uint32_t month, uint32_t day, uint32_t hour,
+                                     uint32_t minute, uint32_t second) {
+    return SecondsOf(year, month, day, hour, minute, second);
+}
+
+MERLIN_STUB_API uint64_t dateSymbol() { return floatSymbol((float)(W().seconds / 86400)); }
+MERLIN_STUB_API uint32_t cycle() { return W().cycle; }
+
+MERLIN_STUB_API void setDate(int year, int month, int day) {
+    World &w = W();
+    w.seconds = SecondsOf(year, month, day, 0, 0, 0) + w.seconds % 86400;
+}
+
+MERLIN_STUB_API void setTime(uint32_t hour, uint32_t minute, uint32_t second) {
+    World &w = W();
+    w.seconds = w.seconds - w.seconds % 86400 + (uint64_t(hour) * 60 + minute) * 60 + second;
+}
+
+MERLIN_STUB_API void setDateAndTime(int year, int month, int day, uint32_t hour, uint32_t minute,
+                                    uint32_t second) {
+    W().seconds = SecondsOf(year, month, day, hour, minute, second);
+}
+
+// ---------------------------------------------------------------------------
+// Kinds and names
+// ---------------------------------------------------------------------------
+
+MERLIN_STUB_API bool isAStr(uint64_t rawEntity, const char *kindStr) {
+    const Entity *entity = EntityOf(rawEntity);
+    return entity && kindStr && entity->kind == kindStr;
+}
+
+MERLIN_STUB_API bool isASymbol(uint64_t rawEntity, uint64_t rawKindSymbol) {
+    return isAStr(rawEntity, SymbolString(rawKindSymbol).c_str());
+}
+
+MERLIN_STUB_API uint64_t kindSymbol(int kindId) { return Hstr("kind" + std::to_string(kindId)); }
+
+MERLIN_STUB_API uint64_t assembleName(uint64_t rawFirstName, uint64_t rawSurname) {
+    return Hstr(SymbolString(rawFirstName) + " " + SymbolString(rawSurname));
+}
+
+MERLIN_STUB_API uint64_t assembleRandomName(const char *, const char *firstNameKindStr,
+                                            uint64_t rawSurname) {
+    std::string first = std::string(firstNameKindStr ? firstNameKindStr : "name") +
+                        std::to_string(W().rng() % 100);
+    std::string surname = SymbolString(rawSurname);
+    surname = surname.substr(surname.find_last_of(' ') + 1);
+    return Hstr(first + " " + surname);
+}
+
+MERLIN_STUB_API uint64_t assembleRandomFullName(const char *, const char *firstNameKindStr,
+                                                const char *surnameKindStr) {
+    World &w = W();
+    return Hstr(std::string(firstNameKindStr ? firstNameKindStr : "name") +
+                std::to_string(w.rng() % 100) + " " +
+                (surnameKindStr ? surnameKindStr : "surname") + std::to_string(w.rng() % 100));
+}
+
+// ---------------------------------------------------------------------------
+// Populations (birthRootNpcs: what npc.lua's birthRootNpc does, for many NPCs in one call)
+// ---------------------------------------------------------------------------
+
+struct MerlinNpcSpec {
+    MerlinFloat3 pos;
+    const char *gender;
+    const char *socialClass;
+    const char *modelPath;
+};
+
+MERLIN_STUB_API int birthRootNpcs(const AttrTable *traitTable, const AttrTable *nonTraitTable,
+                                  const MerlinNpcSpec *specs, int numNpcs, uint64_t,
+                                  const char *rules, uint32_t seed, uint64_t *outNpcs) {
+    if (!traitTable || !specs || numNpcs <= 0)
+        return 0;
+    World &w = W();
+    // The alias tables: slot 0 is nationality, then one per trait
+    std::vector<AliasTable> tables;
+    int nationality = nonTraitTable ? FindAttr(nonTraitTable, "nationality") : -1;
+    tables.push_back(nationality >= 0 ? MakeAliasTable(nonTraitTable->valueTables[nationality], 1)
+                                      : MakeAliasTable(ValueTable{}, 1));
+    for (int i = 0; i < traitTable->size; i++)
+        tables.push_back(MakeAliasTable(traitTable->valueTables[i], traitTable->counts[i]));
+    size_t stride = 2; // first name and surname numbers
+    for (const AliasTable &table : tables)
+        stride += table.count;
+
+    // Everything an NPC draws is independent of the others, so it's sampled in parallel: value
+    // indices per table (plural traits without repeats), the name numbers, then two floats
+    std::vector<uint32_t> picks(stride * numNpcs);
+    std::vector<float> floats(2 * (size_t)numNpcs);
+    auto sampleRange = [&](int begin, int end) {
+        for (int npc = begin; npc < end; npc++) {
+            NpcRandom random{((uint64_t)seed << 32) ^ (uint64_t)npc};
+            uint32_t *out = &picks[stride * npc];
+            for (const AliasTable &table : tables) {
+                for (int k = 0; k < table.count; k++) {
+                    uint32_t pick = SampleAlias(table, random);
+                    while (std::find(out, out + k, pick) != out + k)
+                        pick = SampleAlias(table, random);
+                    out[k] = pick;
+                }
+                out += table.count;
+            }
+            out[0] = random.Below(100);
+            out[1] = random.Below(100);
+            floats[2 * npc] = (float)random.Uniform();
+            floats[2 * npc + 1] = (float)random.Uniform();
+        }
+    };
+    int threads = (int)std::clamp(std::thread::hardware_concurrency(), 1u, 8u);
+    threads = std::min(threads, (numNpcs + 255) / 256);
+    std::vector<std::thread> workers;
+    for (int t = 1; t < threads; t++)
+        workers.emplace_back(sampleRange, numNpcs * t / threads, numNpcs * (t + 1) / threads);
+    sampleRange(0, numNpcs / threads);
+    for (std::thread &worker : workers)
+        worker.join();
+
+    // Creating entities and symbols touches the world, so it stays on this thread
+    w.entities.reserve(w.entities.size() + 5 * (size_t)numNpcs); // NPC, two hands, two fingers
+    w.npcs.reserve(w.npcs.size() + numNpcs);
+    for (int npc = 0; npc < numNpcs; npc++) {
+        const MerlinNpcSpec &spec = specs[npc];
+        const uint32_t *pick = &picks[stride * npc];
+        MerlinObb bounds = {};
+        std::copy(spec.pos.floats, spec.pos.floats + 3, bounds.floats);
+        bounds.floats[3] = 0.3f, bounds.floats[4] = 1.0f, bounds.floats[5] = 1.75f;
+        bounds.floats[9] = 1.0f;
+        uint64_t symbol = MakeEntity("human_npc", "human", bounds, 0);
+        for (const char *hand : {"leftHand", "rightHand"}) {
+            MerlinObb handBounds = {};
+            handBounds.floats[1] = hand[0] == 'l' ? -0.04f : 0.04f;
+            handBounds.floats[3] = handBounds.floats[4] = handBounds.floats[5] = 0.1f;
+            handBounds.floats[9] = 1.0f;
+            uint64_t handSymbol = MakeEntity("hand", hand, handBounds, symbol);
+            MerlinObb fingerBounds = handBounds;
+            fingerBounds.floats[0] += 1.0f;
+            fingerBounds.floats[1] *= 0.4f;
+            fingerBounds.floats[3] = 5.0f, fingerBounds.floats[4] = fingerBounds.floats[5] = 1.0f;
+            setSymbolAttr(handSymbol, "ringFinger",
+                          MakeEntity("finger", "ringFinger", fingerBounds, handSymbol));
+            setSymbolAttr(symbol, hand, handSymbol);
+        }
+        std::string gender = spec.gender ? spec.gender : "male";
+        setSymbolAttr(symbol, "gender", Hstr(gender));
+        uint64_t nationalitySymbol = tables[0].symbols[pick[0]];
+        setSymbolAttr(symbol, "nationality", nationalitySymbol);
+        pick += 1;
+        for (int i = 0; i < traitTable->size; i++) {
+            const AliasTable &table = tables[i + 1];
+            if (traitTable->counts[i] > 1) {
+                std::vector<uint64_t> values;
+                for (int k = 0; k < table.count; k++)
+                    values.push_back(table.symbols[pick[k]]);
+                setSymbolAttr(symbol, traitTable->attrNames[i], MakeList(std::move(values)));
+            } else {
+                setSymbolAttr(symbol, traitTable->attrNames[i], table.symbols[pick[0]]);
+            }
+            pick += table.count;
+        }
+        setSymbolAttr(symbol, "extroversion", floatSymbol(floats[2 * npc]));
+        setSymbolAttr(symbol, "intelligence", floatSymbol(floats[2 * npc + 1]));
+        // As assembleRandomFullName, with the kinds generateRootNpcNameSymbol composes
+        std::string nationalityStr = SymbolString(nationalitySymbol);
+        bool upper = spec.socialClass && std::strcmp(spec.socialClass, "upper") == 0;
+        setSymbolAttr(symbol, "name",
+                      Hstr(gender + nationalityStr + "Name" + std::to_string(pick[0]) + " " +
+                           (upper ? "upperClass" : "common") + nationalityStr + "Surname" +
+                           std::to_string(pick[1])));
+        if (spec.modelPath && spec.modelPath[0])
+            setSymbolAttr(symbol, "modelPath", Hstr(spec.modelPath));
+        // {@self role rootNpc}, then the rules (import is a no-op here)
+        w.sentences++;
+        (void)rules;
+        if (outNpcs)
+            outNpcs[npc] = symbol;
+    }
+    return numNpcs;
+}
+
+// ---------------------------------------------------------------------------
+// Sectors and introspection
+// ---------------------------------------------------------------------------
+
+MERLIN_STUB_API MerlinSectorArray worldSectors() {
+    World &w = W();
+    return {w.sectorMins.data(), w.sectorMaxs.data(), (int)w.sectorMins.size()};
+}
+MERLIN_STUB_API MerlinSectorArray visibleSectors() { return {}; }
+
+MERLIN_STUB_API MerlinSymbolArray firingRuleNames(uint64_t rawSubject) {
+    const Entity *npc = EntityOf(rawSubject);
+    return npc ? ToArray(npc->firingRules) : MerlinSymbolArray{};
+}
+MERLIN_STUB_API MerlinSymbolArray ongoingSelfStates(uint64_t) { return {}; }
+MERLIN_STUB_API MerlinSymbolArray currentGoals(uint64_t) { return {}; }
+namespace {
+
+// An NPC's acts in one MERLIN_ACTS_* list: go-to-waypoint proposes "go" (outcompeting "idle"),
+// which runs as a "walk" action
+struct StubAct {
+    uint64_t act;
+    uint64_t outcompetedBy;
+    float util;
+    uint64_t cause; // 0 = none
+};
+
+int NpcActs(uint64_t subject, uint32_t kind, StubAct (&acts)[2]) {
+    const Entity *npc = EntityOf(subject);
+    if (!npc || !npc->npc)
+        return 0;
+    World &w = W();
+    switch (kind) {
+    case MERLIN_ACTS_PROPOSED_TASKS:
+        acts[0] = {w.goTask, 0, 0.8f, w.goToWaypointRule};
+        acts[1] = {w.idleTask, w.goTask, 0.1f, 0};
+        return 2;
+    case MERLIN_ACTS_RUNNING_TASKS:
+        acts[0] = {w.goTask, 0, 0.8f, w.goToWaypointRule};
+        return 1;
+    case MERLIN_ACTS_PROPOSED_ACTIONS:
+    case MERLIN_ACTS_RUNNING_ACTIONS:
+        acts[0] = {w.walkAction, 0, 0.8f, w.goTask};
+        return 1;
+    }
+    return 0;
+}
+
+// By value, like Merlin: the whole array (causes block included) is built and returned
+MerlinActArray ActArray(uint64_t subject, uint32_t kind) {
+    MerlinActArray array = {};
+    StubAct acts[2];
+    array.size = NpcActs(subject, kind, acts);
+    for (int i = 0; i < array.size; i++) {
+        array.acts[i] = acts[i].act;
+        array.outcompetedBy[i] = acts[i].outcompetedBy;
+        array.util[i] = acts[i].util;
+        array.numCauses[i] = acts[i].cause ? 1 : 0;
+        array.causes[i][0] = acts[i].cause;
+    }
+    return array;
+}
+
+} // namespace
+
+MERLIN_STUB_API MerlinActArray proposedTasks(uint64_t rawSubject) {
+    return ActArray(rawSubject, MERLIN_ACTS_PROPOSED_TASKS);
+}
+MERLIN_STUB_API MerlinActArray runningTasks(uint64_t rawSubject) {
+    return ActArray(rawSubject, MERLIN_ACTS_RUNNING_TASKS);
+}
+MERLIN_STUB_API MerlinActArray proposedActions(uint64_t rawSubject) {
+    return ActArray(rawSubject, MERLIN_ACTS_PROPOSED_ACTIONS);
+}
+MERLIN_STUB_API MerlinActArray runningActions(uint64_t rawSubject) {
+    return ActArray(rawSubject, MERLIN_ACTS_RUNNING_ACTIONS);
+}
+
+MERLIN_STUB_API int queryActs(uint64_t rawSubject, const MerlinActFilter *filter, int32_t *cursor,
+                              MerlinActRow *rows, int maxRows, uint64_t *causes, int maxCauses) {
+    if (!filter || !cursor || *cursor < 0) {
+        if (cursor)
+            *cursor = -1;
+        return 0;
+    }
+    int matched = 0; // matching acts seen so far, the cursor's unit
+    int copied = 0;
+    int usedCauses = 0;
+    for (uint32_t kind = MERLIN_ACTS_PROPOSED_TASKS; kind <= MERLIN_ACTS_RUNNING_ACTIONS;
+         kind <<= 1) {
+        if (!(filter->kinds & kind))
+            continue;
+        StubAct acts[2];
+        int count = NpcActs(rawSubject, kind, acts);
+        for (int i = 0; i < count; i++) {
+            if (acts[i].util < filter->minUtil)
+                continue;
+            int index = matched++;
+            if (maxRows == 0 || index < *cursor)
+                continue;
+            int numCauses = acts[i].cause && filter->maxCausesPerAct > 0 ? 1 : 0;
+            if (copied == maxRows || (copied > 0 && usedCauses + numCauses > maxCauses)) {
+                *cursor += copied; // page full: resume at this act
+                return copied;
+            }
+            numCauses = std::min(numCauses, maxCauses - usedCauses); // a lone act always fits
+            MerlinActRow &row = rows[copied++];
+            row = {acts[i].act, acts[i].outcompetedBy, acts[i].util, (uint16_t)kind,
+                   (uint16_t)numCauses, usedCauses};
+            if (numCauses)
+                causes[usedCauses++] = acts[i].cause;
+        }
+    }
+    if (maxRows == 0)
+        return matched;
+    *cursor = -1;
+    return copied;
+}
+
+// ---------------------------------------------------------------------------
+// Native entry points used by MerlinLua
+// ---------------------------------------------------------------------------
+
+MERLIN_STUB_API void registerForeignActionCommandBuffer(uint64_t merlinId,
+                                                        ForeignActionCommandBuffer *buffer) {
+    W().actionBuffers[merlinId] = buffer;
+}
+
+MERLIN_STUB_API void unregisterForeignActionCommandBuffer(uint64_t merlinId) {
+    W().actionBuffers.erase(merlinId);
+}